@@ -1,15 +1,34 @@
 #include "analyzeDir.h"
+#include "archive.h"
+#include "cpuTopology.h"
+#include "decompress.h"
+#include "externalProbe.h"
+#include "fileStore.h"
+#include "hyperLogLog.h"
+#include "imageBatcher.h"
+#include "imageHeader.h"
+#include "imageStats.h"
+#include "lineStats.h"
+#include "memoryGovernor.h"
+#include "minHash.h"
+#include "ngramCounter.h"
+#include "pathTable.h"
+#include "scopedArena.h"
+#include "spaceSaving.h"
+#include "termCounter.h"
+#include "textClassifier.h"
+#include "wordTokenizer.h"
+#include "workerPool.h"
 
 // OS-Specific Includes for error-handling
 #ifdef __linux__
-    #include <error.h>
+    #include <string.h>
 #elif defined(__APPLE__) || defined(__MACH__)
     #include <errno.h>
-    #include <cstdio>
-    #include <cstdlib>
+    #include <string.h>
 #elif defined(_WIN32) || defined(_WIN64)
     #include <windows.h>
-    #include <iostream>
+    #include <string.h>
 #endif
 
 // C Standard Libraries
@@ -24,6 +43,14 @@
 #include <algorithm>
 #include <sstream>  
 #include <optional>
+#include <map>
+#include <cmath>
+#include <climits>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <cstring>
+#include <ctime>
 
 // define strings as a C string so that we don't need to invoke .c_str when passing it into
 // a C system call
@@ -33,51 +60,28 @@ constexpr char PATH_SEPARATOR = '/';
 constexpr char NO_PATH[] = "";
 
 constexpr int SYSCALL_SUCCESS = 0;
-constexpr int SYSCALL_FAILED = -1;
+constexpr int NO_ERROR = 0;
+
+// the first retry of a transient failure waits this long, and every further retry doubles it
+constexpr useconds_t RETRY_BACKOFF_US = 1000;
 
 constexpr int DEFAULT_LARGEST_SIZE = -1;
-constexpr int MIN_WORD_SIZE = 5;
+constexpr char IDENTIFY_PROGRAM[] = "identify";
 
-// FILE HELPERS
-// ===================================================================================================================
+constexpr long BYTES_PER_MB = 1024 * 1024;
+// counters kept for the most common words once the word table has been summarized to save memory
+constexpr size_t WORD_SUMMARY_SIZE = 16384;
+// what a word table entry costs besides the word itself: its node, bucket pointer and malloc header, roughly
+constexpr size_t WORD_ENTRY_OVERHEAD = 48;
+// the word counts of a Space-Saving summary are kept in a heap of counters plus a table of positions
+constexpr size_t WORD_COUNTER_SIZE = 96;
+constexpr long STALE_FILE_SECONDS = 365L * 24 * 60 * 60;
+constexpr const char *FILE_KIND_NAMES[N_FILE_KINDS] = { "other", "text", "compressed", "archive" };
 
-/**
- * @brief Prints an error message and exits the program.
- * @param message The error message to display.
- */
-void print_error(const std::string &message) {
-  #ifdef __linux__
-      error(SYSCALL_FAILED, errno, "%s", message.c_str());
-  #elif defined(__APPLE__) || defined(__MACH__)
-      perror(message.c_str());
-      exit(EXIT_FAILURE);
-  #elif defined(_WIN32) || defined(_WIN64)
-      std::cerr << message << ": Error code " << GetLastError() << std::endl;
-      exit(EXIT_FAILURE);
-  #endif
-}
-
-/**
- * @brief Opens a directory for reading.
- * @param dir_name The path of the directory.
- * @return Pointer to the opened directory (DIR*).
- */
-DIR *open_directory(const std::string &dir_name) {
-  DIR *dir = opendir(dir_name.c_str());
-  if (!dir) print_error("could not opendir " + dir_name);
-  return dir;
-}
-
-/**
- * @brief Opens a file for reading.
- * @param file_name The path of the file.
- * @return Pointer to the opened directory (FILE*).
- */
-FILE *open_file(const std::string &file_name) {
-  FILE *file = fopen(file_name.c_str(), "r");
-  if (!file) print_error("could not open file " + file_name);
-  return file;
-}
+// files inside an archive are reported as "path/to/archive.tar!/path/inside/archive"
+constexpr char ARCHIVE_MEMBER_SEPARATOR[] = "!/";
+// appended to an archive's name to make the path component its members hang from
+constexpr char ARCHIVE_MEMBER_ROOT_SUFFIX = '!';
 
 // STRING PARSERS
 // ===================================================================================================================
@@ -105,21 +109,6 @@ static bool is_file(const std::string & path)
     return S_ISREG(buff.st_mode);
 }
 
-/**
- * @brief Checks if a string ends with a suffix.
- * @param str The string to check.
- * @param suffix The suffix to compare.
- * @return True if the string ends with the suffix, false otherwise.
- */
-static bool ends_with(const std::string & str, const std::string & suffix)
-{
-    if (str.size() < suffix.size()) {
-        return false;
-    } else {
-        return 0 == str.compare(str.size() - suffix.size(), suffix.size(), suffix);
-    }
-}
-
 /**
  * @brief Removes a leading ./ from a path.
  * @param path The file/directory path.
@@ -132,36 +121,223 @@ static std::string clean_path(const std::string &path) {
   return path;
 }
 
+// GLOBALS
+// ===================================================================================================================
+// options for the current analysis, set once when analyzeDir() is called
+AnalyzeOptions analyze_options;
+// failures that were skipped over, keyed by errno so that they come out sorted
+std::map<int, ScanErrorInfo> scan_errors_map;
+// files identify was killed on for running past the timeout, added to by the image probe workers
+std::vector<std::string> timed_out_images;
+std::mutex timed_out_images_mutex;
+// where identify was found when the scan started, or empty if it isn't installed (or not used)
+std::string identify_path;
+// decides which files go through the word tokenizer, built from the options
+TextClassifier text_classifier;
+// words the tokenizer drops, built from the options
+StopWordFilter stop_word_filter;
+
+// FILE HELPERS
+// ===================================================================================================================
+
 /**
- * @brief Converts a string to lowercase.
- * @param str The input string.
- * @return The lowercase version of the string.
+ * @brief Records a failed operation on a path, using the current value of errno.
+ * @param path The path that could not be read.
  */
-static std::string lowercase(const std::string &str) {
-  std::string lower_str = str;
-  std::transform(lower_str.begin(), lower_str.end(), lower_str.begin(), ::tolower);
-  return lower_str;
+static void record_error(const std::string &path) {
+  ScanErrorInfo &error_info = scan_errors_map[errno];
+  error_info.error_code = errno;
+  error_info.count++;
+  if (static_cast<int>(error_info.sample_paths.size()) < analyze_options.max_error_samples) {
+    error_info.sample_paths.push_back(clean_path(path));
+  }
 }
 
-// GLOBALS
-// maps each directory to its parent directory. Helps with determining which directories are vacant.
+/**
+ * @brief Describes the error code of a scan failure.
+ * @param error_code The errno of the failure (see ScanErrorInfo::error_code).
+ * @return The platform's message for it.
+ */
+std::string describe_scan_error(int error_code) {
+  char message[256];
+  #ifdef __linux__
+      // the GNU strerror_r may return a static string instead of filling the buffer
+      return strerror_r(error_code, message, sizeof(message));
+  #elif defined(__APPLE__) || defined(__MACH__)
+      if (strerror_r(error_code, message, sizeof(message)) != 0) return "Unknown error: " + std::to_string(error_code);
+      return message;
+  #elif defined(_WIN32) || defined(_WIN64)
+      if (strerror_s(message, sizeof(message), error_code) != 0) return "Unknown error: " + std::to_string(error_code);
+      return message;
+  #else
+      (void)message;
+      return strerror(error_code);
+  #endif
+}
+
+/**
+ * @brief Checks whether a failure might go away if the operation is simply attempted again.
+ * @param error_code The errno of the failure.
+ * @return True if the failure is worth retrying, false otherwise.
+ */
+static bool is_transient_error(int error_code) {
+  switch (error_code) {
+    case EINTR:
+    case EAGAIN:
+    case EBUSY:
+    case ENFILE:
+    case ESTALE:
+    case ETIMEDOUT:
+      return true;
+    default:
+      return false;
+  }
+}
+
+/**
+ * @brief Runs an operation that returns a null pointer on failure, retrying transient failures
+ *        (with exponential backoff) as many times as the options allow.
+ * @param operation The operation to run.
+ * @return The result of the last attempt.
+ */
+template <typename Operation>
+static auto retry_transient(Operation operation) {
+  auto result = operation();
+  for (int attempt = 0; !result && attempt < analyze_options.transient_retries && is_transient_error(errno); attempt++) {
+    usleep(RETRY_BACKOFF_US << attempt);
+    result = operation();
+  }
+  return result;
+}
+
+/**
+ * @brief Opens a directory for reading.
+ * @param dir_name The path of the directory.
+ * @return Pointer to the opened directory (DIR*), or null if it could not be opened (the failure is recorded).
+ */
+static DIR *open_directory(const std::string &dir_name) {
+  DIR *dir = retry_transient([&] { return opendir(dir_name.c_str()); });
+  if (!dir) record_error(dir_name);
+  return dir;
+}
+
+/**
+ * @brief Opens a file for reading.
+ * @param file_name The path of the file.
+ * @return Pointer to the opened file (FILE*), or null if it could not be opened (the failure is recorded).
+ */
+static FILE *open_file(const std::string &file_name) {
+  FILE *file = retry_transient([&] { return fopen(file_name.c_str(), "r"); });
+  if (!file) record_error(file_name);
+  return file;
+}
+
+// TRAVERSAL GLOBALS
+// maps each directory to its number of files. Helps with determining which directories are vacant.
 // ALGO: Check if n_files of current directory == 0 and n_files of parent directory != 0.
 // ===================================================================================================================
+// every directory, and every file that might be reported, as a chain of interned names. Paths are
+// only turned back into strings for the results, and the table knows each directory's parent.
+PathTable path_table;
 // These hashtables are populated when doing the tree traversal.
-std::unordered_map<std::string, std::string> parent_map;
-std::unordered_map<std::string, int> n_files_map;
-std::unordered_map<std::string, int> most_common_words_map;
+std::unordered_map<PathId, int> n_files_map;
+// the words are copied into word_arena once, when first seen, and live until exit
+std::pmr::monotonic_buffer_resource word_arena;
+std::pmr::unordered_map<std::string_view, int> most_common_words_map(&word_arena);
+size_t stored_word_bytes = 0;
+// replaces the word table when the memory governor asks for it, with approximate counts from then on
+std::optional<SpaceSavingSummary> summarized_words;
+std::vector<std::pair<std::string, int>> summarized_top_words;
+// keeps the scan within AnalyzeOptions::max_memory_mb, if set
+MemoryGovernor memory_governor;
+// word bigrams and trigrams, only fed when the options ask for them
+NGramCounter ngram_counter;
+// when per-directory words are on, the summary of the directory whose files are being tokenized
+SpaceSavingSummary *current_word_summary = nullptr;
+// the word summaries of the directories at the reported depth, keyed by their path
+std::vector<std::pair<std::string, SpaceSavingSummary>> reported_word_summaries;
+// distinct words and file extensions of the whole scan, only fed when the options ask for them
+HyperLogLog distinct_words_sketch;
+HyperLogLog distinct_extensions_sketch;
+// when per-directory distinct counts are on, the word sketch of the directory whose files are being tokenized
+HyperLogLog *current_word_sketch = nullptr;
+// distinct counts of the directories at the reported depth
+std::vector<DirDistinct> reported_distinct_counts;
+// MinHash signature of the text file being tokenized, and those of all the text files so far
+MinHasher min_hasher;
+NearDuplicateFinder near_duplicate_finder;
+// occurrences of the terms the options ask for, found in the same blocks the tokenizer reads
+TermCounter term_counter;
+// line statistics of the text file being read, of all text files so far, and each file's line count
+LineCounter line_counter;
+LineStats text_line_totals;
+std::string longest_line_path;
+long n_crlf_files = 0;
+std::vector<std::pair<std::string, long>> text_file_lines;
+// reads image headers in batches through io_uring when the options ask for it, and the images it found
+std::unique_ptr<ImageBatcher> image_batcher;
+std::pmr::vector<struct ImageEntry> batched_images;
+// measures images on worker threads when the options ask for it (and io_uring doesn't)
+std::unique_ptr<WorkerPool> image_pool;
+// counts, sizes and the smallest of all the images found, only fed when the options ask for them
+ImageStats image_stats;
+// the names of the image formats found so far, which images refer to by index
+std::vector<std::string> image_format_names;
+// one record per file on disk, only kept when the file statistics are asked for
+FileStore file_store;
 
 // STRUCTS & COMPARATORS
 // ===================================================================================================================
+// an image found during the scan. Its path is only built if it makes it into the results.
+struct ImageEntry {
+  PathId path;
+  long width, height;
+  uint32_t format; // index in image_format_names
+};
+
+// the dimensions and format of an image, as read from its header or reported by identify
+struct MeasuredImage {
+  long width, height;
+  std::string format;
+};
+
+// an image measured by the image pool, recorded on the scanning thread once the pool is done
+struct PooledImage {
+  PathId path;
+  long file_size;
+  MeasuredImage image;
+};
+// the images measured by the workers of one NUMA node (of all the workers, unless they are pinned)
+struct NodeImages {
+  std::mutex mutex;
+  std::vector<PooledImage> images;
+};
+std::vector<std::unique_ptr<NodeImages>> pooled_images;
+// the index in pooled_images of each image pool worker's node
+std::vector<size_t> image_worker_nodes;
+
+// lives in the arena of the directory's scan, along with its images and sketches
 struct DirStats {
-  std::string largest_file_path = NO_PATH;
+  explicit DirStats(std::pmr::memory_resource *arena)
+    : largest_images(arena), word_sketch(arena), extension_sketch(arena) {}
+
+  PathId largest_file = NO_PATH_ID;
   long largest_file_size = DEFAULT_LARGEST_SIZE;
   long n_files = 0;
   // set to 1 to count the current directory itself
   long n_dirs = 1;
   long all_files_size = 0;
-  std::vector<ImageInfo> largest_images;
+  std::pmr::vector<ImageEntry> largest_images;
+  // files found inside archives, whether or not they are also counted in the totals above
+  long n_archive_members = 0;
+  long archive_members_size = 0;
+  // approximate counts of the most common words in this subtree, only kept when per-directory
+  // words are on and the directory is at or below the reported depth. It stays on the heap, since
+  // every merge replaces its counters, which would pile up in an arena.
+  SpaceSavingSummary word_summary;
+  // distinct words and extensions in this subtree, only kept at or below the reported depth
+  HyperLogLog word_sketch;
+  HyperLogLog extension_sketch;
 };
 
 /**
@@ -169,8 +345,8 @@ struct DirStats {
  */
 struct ImageInfoComparator {
   inline bool operator() (const ImageInfo &image1, const ImageInfo& image2) {
-    long pixels1 = image1.width * image1.height;
-    long pixels2 = image2.width * image2.height;
+    uint64_t pixels1 = pixel_count(image1.width, image1.height);
+    uint64_t pixels2 = pixel_count(image2.width, image2.height);
 
     // first sort by greater pixel count; if equal, sort alphabetically
     if (pixels1 != pixels2) {
@@ -185,8 +361,8 @@ struct ImageInfoComparator {
  */
 struct WordFrequencyComparator {
   inline bool operator() (
-    const std::pair<std::string, int> &word1, 
-    const std::pair<std::string, int> &word2) 
+    const std::pair<std::string_view, int> &word1, 
+    const std::pair<std::string_view, int> &word2) 
     {
       // first sort by greater word count; if equal, sort alphabetically
       if (word1.second != word2.second) {
@@ -199,186 +375,974 @@ struct WordFrequencyComparator {
 // HELPERS
 // ===================================================================================================================
 /**
- * @brief Obtains image info from a file (if the file is an image).
- * @param file_path The path to the potential image.
- * @return ImageInfo containing the image's width and height, or null if the file is not an image.
+ * @brief Reads the dimensions of an image from the start of its file, without running identify.
+ *        Files that can't be opened are left to identify, which skips them silently as well.
+ * @param file_path The path to the file.
+ * @return The image's dimensions if the file is an image in a format parse_image_header() knows.
+ */
+static std::optional<MeasuredImage> get_native_image_info(const std::string &file_path) {
+  auto image_header = read_image_header(file_path);
+  if (!image_header) return std::nullopt;
+  return MeasuredImage{image_header->width, image_header->height, image_header->format};
+}
+
+/**
+ * @brief Runs identify on a file to get its dimensions.
+ * @param file_path The path to the file.
+ * @return The image's dimensions if identify recognized the file as an image.
  */
-static std::optional<ImageInfo> get_image_info(const std::string &file_path) {
-  // 2> /dev/null redirects errors to /dev/null, effectively ignoring them
-  std::string command = "identify -format '%w %h' " + file_path + " 2> /dev/null";
-  FILE *pipe = popen(command.c_str(), "r");
-  if (!pipe) print_error("could not call identify via popen on %s" + file_path);
+static std::optional<MeasuredImage> get_identified_image_info(const std::string &file_path) {
+  if (identify_path.empty()) return std::nullopt;
+  // identify runs without a shell, with its errors discarded, and is killed if it runs too long
+  ProbeLimits limits;
+  limits.timeout_seconds = analyze_options.identify_timeout_seconds;
+  limits.cpu_seconds = std::ceil(analyze_options.identify_timeout_seconds);
+  limits.memory_bytes = analyze_options.identify_memory_mb * BYTES_PER_MB;
+  std::string output;
+  // only the first frame of a multi-frame image is read, as each frame gets its own line
+  ProbeStatus status = run_probe({identify_path, "-format", "%w %h %m\\n", file_path}, limits, output, PATH_MAX);
+  if (status == ProbeStatus::TIMED_OUT) {
+    std::lock_guard<std::mutex> lock(timed_out_images_mutex);
+    timed_out_images.push_back(clean_path(file_path));
+    return std::nullopt;
+  }
 
-  char buffer[PATH_MAX];
   long width = 0;
   long height = 0;
+  std::string format;
+  std::istringstream iss(output);
+  iss >> width >> height >> format;
+  if (status == ProbeStatus::DONE && width > 0 && height > 0) {
+    return MeasuredImage{width, height, format};
+  }
+
+  return std::nullopt;
+}
 
-  if (fgets(buffer, sizeof(buffer), pipe) != NULL) {
-    std::istringstream iss(buffer);
-    iss >> width >> height;
+/**
+ * @brief Obtains image info from a file (if the file is an image).
+ * @param file_path The path to the potential image.
+ * @return The image's width, height and format, or null if the file is not an image.
+ */
+static std::optional<MeasuredImage> get_image_info(const std::string &file_path) {
+  if (analyze_options.native_images) {
+    auto image_info = get_native_image_info(file_path);
+    if (image_info || !analyze_options.use_identify) return image_info;
+  }
+
+  return get_identified_image_info(file_path);
+}
+
+/**
+ * @brief Records an image found during the scan.
+ * @param path The ID of its path.
+ * @param image The image's dimensions and format.
+ * @param file_size The size of its file.
+ * @param images The list to add it to.
+ */
+static void record_image(PathId path, const MeasuredImage &image, long file_size, std::pmr::vector<ImageEntry> &images) {
+  if (analyze_options.image_stats) {
+    image_stats.add(path, image.format, image.width, image.height, file_size);
   }
+  // there are only a handful of formats, so a linear search is as quick as a hash table
+  auto format = std::find(image_format_names.begin(), image_format_names.end(), image.format);
+  if (format == image_format_names.end()) format = image_format_names.insert(format, image.format);
+  images.push_back(ImageEntry{path, image.width, image.height, static_cast<uint32_t>(format - image_format_names.begin())});
+}
 
-  int status = pclose(pipe);
-  if (status == SYSCALL_SUCCESS && width > 0 && height > 0) {
-    return ImageInfo{clean_path(file_path), width, height};
+/**
+ * @brief Records an image whose header was read in a batch, running identify on the files whose
+ *        format isn't known natively (if the options allow it).
+ * @param file_path The path to the file.
+ * @param path_id The ID of the path.
+ * @param file_size The size of the file.
+ * @param header The format and dimensions read from the header, or null if it wasn't recognized.
+ */
+static void record_batched_image(const std::string &file_path, PathId path_id, long file_size, std::optional<ImageHeader> header) {
+  std::optional<MeasuredImage> image;
+  if (header) {
+    image = MeasuredImage{header->width, header->height, header->format};
+  } else if (analyze_options.use_identify) {
+    image = get_identified_image_info(file_path);
   }
+  if (image) record_image(path_id, *image, file_size, batched_images);
+}
 
-  return std::nullopt;
+/**
+ * @brief Records one occurrence of a word found by the tokenizer.
+ * @param word The word.
+ */
+static void record_word(const std::string &word) {
+  memory_governor.tick();
+  auto word_count = summarized_words ? most_common_words_map.end() : most_common_words_map.find(word);
+  if (summarized_words) {
+    summarized_words->add(word);
+  } else if (word_count != most_common_words_map.end()) {
+    word_count->second++;
+  } else {
+    char *stored_word = static_cast<char *>(word_arena.allocate(word.size(), alignof(char)));
+    memcpy(stored_word, word.data(), word.size());
+    most_common_words_map.emplace(std::string_view(stored_word, word.size()), 1);
+    stored_word_bytes += word.size();
+  }
+  if (analyze_options.max_ngram_size >= 2) ngram_counter.add_word(word);
+  if (current_word_summary) current_word_summary->add(word);
+  if (analyze_options.count_distinct) {
+    uint64_t hash = hll_hash(word);
+    distinct_words_sketch.add(hash);
+    if (current_word_sketch) current_word_sketch->add(hash);
+  }
+  if (analyze_options.find_near_duplicates) min_hasher.add_word(word);
+}
+
+/**
+ * @brief Ends a text file once its last word has been recorded, so that n-grams don't span files.
+ * @param tokenizer The tokenizer that read the file.
+ * @param file_path The path reported for the file.
+ */
+static void finish_text(WordTokenizer &tokenizer, const std::string &file_path) {
+  tokenizer.finish();
+  ngram_counter.end_document();
+  MinHashSignature signature;
+  if (analyze_options.find_near_duplicates && min_hasher.end_document(signature)) {
+    near_duplicate_finder.add_document(file_path, signature);
+  }
+  if (!term_counter.empty()) term_counter.end_file(file_path);
+  if (analyze_options.line_stats) {
+    LineStats file_lines = line_counter.finish();
+    if (file_lines.longest_line > text_line_totals.longest_line) {
+      text_line_totals.longest_line = file_lines.longest_line;
+      longest_line_path = file_path;
+    }
+    text_line_totals.n_lines += file_lines.n_lines;
+    text_line_totals.n_bytes += file_lines.n_bytes;
+    text_line_totals.n_non_ascii_bytes += file_lines.n_non_ascii_bytes;
+    text_line_totals.n_crlf_lines += file_lines.n_crlf_lines;
+    if (file_lines.n_crlf_lines > 0) n_crlf_files++;
+    text_file_lines.emplace_back(file_path, file_lines.n_lines);
+  }
+}
+
+/**
+ * @brief Passes the next block of a text file to the tokenizer, the term counter and the line counter.
+ * @param tokenizer The tokenizer reading the file.
+ * @param data The block.
+ * @param size The size of the block.
+ */
+static void feed_text(WordTokenizer &tokenizer, const unsigned char *data, size_t size) {
+  tokenizer.feed(data, size);
+  if (!term_counter.empty()) term_counter.feed(data, size);
+  if (analyze_options.line_stats) line_counter.feed(data, size);
+}
+
+/**
+ * @brief Creates a tokenizer that records the words it finds.
+ * @return A tokenizer in the mode chosen by the options.
+ */
+static WordTokenizer make_tokenizer() {
+  return WordTokenizer(analyze_options.unicode_words, record_word, stop_word_filter.empty() ? nullptr : &stop_word_filter);
 }
 
 /**
  * @brief Records the occurrences of words in the provided file.
  * @param file_path The path to the file.
+ * @param compression How the file is compressed; it is decompressed on the fly.
+ * @param sniff Whether to first check that the file looks like text, skipping it if it doesn't.
  */
-static void count_words_in_file(const std::string &file_path) {
+static void count_words_in_file(const std::string &file_path, Compression compression, bool sniff) {
   FILE *file = open_file(file_path);
-  std::string next_word;
-  
-  while (true) {
-    int c = fgetc(file);
-    if (c == EOF) break;
-    c = tolower(c);
-    
-    if (isalpha(c)) {
-      next_word.push_back(c);
+  if (!file) return;
+
+  WordTokenizer tokenizer = make_tokenizer();
+  bool is_text = true;
+  // the first block doubles as the sniffed prefix, so sniffing costs no extra reads
+  bool sniffed = ! sniff;
+  bool ok = stream_blocks(file, compression, [&](const unsigned char *data, size_t size) {
+    if (! sniffed) {
+      sniffed = true;
+      is_text = TextClassifier::looks_like_text(data, size);
+      if (! is_text) return false;
     }
-    // there's a space, or some sort of non-character. At this point the word stops and we'll "reset" it, 
-    // but we still need to do an additional check to ensure it's the appropriate length
-    else {
-      if (next_word.length() >= MIN_WORD_SIZE) {
-        most_common_words_map[next_word]++;
+    feed_text(tokenizer, data, size);
+    return true;
+  });
+
+  if (!ok) record_error(file_path);
+  if (is_text) finish_text(tokenizer, clean_path(file_path));
+  fclose(file);
+}
+
+/**
+ * @brief Decides whether a file goes through the word tokenizer, and tokenizes it if so. Compressed
+ *        files are classified by the name they would have once decompressed.
+ * @param file_path The path to the file.
+ * @param file_name The name of the file (the last component of the path).
+ */
+static void count_words_if_text(const std::string &file_path, const std::string &file_name) {
+  Compression compression = compression_from_name(file_name);
+  if (! compression_supported(compression)) return;
+
+  bool known_text = text_classifier.has_text_extension(strip_compression_extension(file_name, compression));
+  if (known_text || text_classifier.should_sniff()) {
+    count_words_in_file(file_path, compression, ! known_text);
+  }
+}
+
+/**
+ * @brief Classifies a file by its name.
+ * @param file_name The name of the file.
+ * @return ARCHIVE for the archive formats (compressed or not), TEXT for text extensions (compressed
+ *         or not), COMPRESSED for other compressed files and OTHER for the rest.
+ */
+static FileKind file_kind(const std::string &file_name) {
+  Compression compression;
+  if (archive_format_from_name(file_name, compression) != ArchiveFormat::NONE) return FileKind::ARCHIVE;
+  compression = compression_from_name(file_name);
+  if (text_classifier.has_text_extension(strip_compression_extension(file_name, compression))) return FileKind::TEXT;
+  return compression == Compression::NONE ? FileKind::OTHER : FileKind::COMPRESSED;
+}
+
+/**
+ * @brief Analyzes the files inside an archive as if they were files on disk: they are counted,
+ *        tokenized if they are text and probed if they are images. Everything found is attributed
+ *        to "archive!/member/path".
+ */
+class ArchiveAnalyzer : public ArchiveVisitor {
+public:
+  ArchiveAnalyzer(const std::string &archive_path, PathId dir_id, const std::string &archive_name, DirStats &dir_stats)
+    : archive_prefix(clean_path(archive_path) + ARCHIVE_MEMBER_SEPARATOR), dir_id(dir_id),
+      archive_name(archive_name), dir_stats(dir_stats) {}
+
+  bool begin_member(const std::string &name, uint64_t size) override {
+    member_name = name;
+    member_path = archive_prefix + name;
+    member_id = NO_PATH_ID;
+    member_size = size;
+    dir_stats.n_archive_members++;
+    dir_stats.archive_members_size += size;
+    if (analyze_options.count_archive_members) {
+      dir_stats.n_files++;
+      dir_stats.all_files_size += size;
+      if (static_cast<long>(size) > dir_stats.largest_file_size) {
+        dir_stats.largest_file = member_path_id();
+        dir_stats.largest_file_size = size;
       }
-      next_word.clear();
     }
+
+    // nested compressed files are not unpacked, so they are neither text nor images here
+    bool known_text = text_classifier.has_text_extension(name);
+    text_state = known_text ? TextState::TEXT : text_classifier.should_sniff() ? TextState::SNIFFING : TextState::NOT_TEXT;
+    tokenizer = make_tokenizer();
+    image_prefix.clear();
+    sniff_prefix.clear();
+    probing_image = true;
+    return true;
+  }
+
+  bool member_data(const unsigned char *data, size_t size) override {
+    // members arrive in pieces of any size, so the image header and the sniffed prefix are gathered first
+    if (probing_image) {
+      image_prefix.insert(image_prefix.end(), data, data + std::min(size, IMAGE_HEADER_SIZE - image_prefix.size()));
+      if (image_prefix.size() == IMAGE_HEADER_SIZE) probe_image();
+    }
+    if (text_state == TextState::SNIFFING) {
+      size_t n_sniffed = std::min(size, TEXT_SNIFF_SIZE - sniff_prefix.size());
+      sniff_prefix.insert(sniff_prefix.end(), data, data + n_sniffed);
+      if (sniff_prefix.size() < TEXT_SNIFF_SIZE) return true;
+      sniff_text();
+      data += n_sniffed;
+      size -= n_sniffed;
+    }
+    if (text_state == TextState::TEXT) feed_text(tokenizer, data, size);
+    return probing_image || text_state == TextState::TEXT;
+  }
+
+  void end_member() override {
+    if (probing_image) probe_image();
+    if (text_state == TextState::SNIFFING) sniff_text();
+    if (text_state == TextState::TEXT) finish_text(tokenizer, member_path);
+  }
+
+private:
+  enum class TextState { NOT_TEXT, SNIFFING, TEXT };
+
+  void probe_image() {
+    probing_image = false;
+    auto header = parse_image_header(image_prefix.data(), image_prefix.size());
+    if (header.has_value()) {
+      record_image(member_path_id(), MeasuredImage{header->width, header->height, header->format}, member_size, dir_stats.largest_images);
+    }
+  }
+
+  // members are only added to the path table once something about them is kept, with the
+  // directories inside the archive shared between members like directories on disk
+  PathId member_path_id() {
+    if (member_id == NO_PATH_ID) member_id = add_member_path(member_name);
+    return member_id;
+  }
+
+  PathId add_member_path(const std::string &path) {
+    size_t slash = path.rfind(PATH_SEPARATOR);
+    PathId parent = slash == std::string::npos ? archive_root() : member_dir(path.substr(0, slash));
+    return path_table.add(parent, std::string_view(path).substr(slash + 1));
   }
 
-  // edge case: last word in file (file might not end in a non-alphabetic character)
-  if (next_word.length() >= MIN_WORD_SIZE) {
-    most_common_words_map[next_word]++;
-  }  
+  PathId member_dir(const std::string &dir) {
+    auto it = member_dirs.find(dir);
+    if (it != member_dirs.end()) return it->second;
+    PathId id = add_member_path(dir);
+    member_dirs.emplace(dir, id);
+    return id;
+  }
+
+  PathId archive_root() {
+    if (archive_root_id == NO_PATH_ID) archive_root_id = path_table.add(dir_id, archive_name + ARCHIVE_MEMBER_ROOT_SUFFIX);
+    return archive_root_id;
+  }
+
+  void sniff_text() {
+    text_state = TextClassifier::looks_like_text(sniff_prefix.data(), sniff_prefix.size()) ? TextState::TEXT : TextState::NOT_TEXT;
+    if (text_state == TextState::TEXT) feed_text(tokenizer, sniff_prefix.data(), sniff_prefix.size());
+  }
 
+  std::string archive_prefix;
+  PathId dir_id;
+  std::string archive_name;
+  PathId archive_root_id = NO_PATH_ID;
+  std::unordered_map<std::string, PathId> member_dirs;
+  DirStats &dir_stats;
+  std::string member_name;
+  std::string member_path;
+  PathId member_id = NO_PATH_ID;
+  long member_size = 0;
+  TextState text_state = TextState::NOT_TEXT;
+  WordTokenizer tokenizer;
+  std::vector<unsigned char> image_prefix;
+  std::vector<unsigned char> sniff_prefix;
+  bool probing_image = false;
+};
+
+/**
+ * @brief Analyzes the files inside an archive, adding what it finds to the stats of the directory
+ *        holding the archive.
+ * @param file_path The path to the archive.
+ * @param dir_id The ID of the directory holding the archive.
+ * @param file_name The name of the archive.
+ * @param format The format of the archive.
+ * @param compression How the archive itself is compressed.
+ * @param dir_stats The stats of the directory holding the archive.
+ */
+static void analyze_archive(const std::string &file_path, PathId dir_id, const std::string &file_name, ArchiveFormat format,
+                            Compression compression, DirStats &dir_stats) {
+  FILE *file = open_file(file_path);
+  if (!file) return;
+  ArchiveAnalyzer analyzer(file_path, dir_id, file_name, dir_stats);
+  if (! stream_archive(file, format, compression, analyzer)) record_error(file_path);
   fclose(file);
 }
 
 /**
  * @brief Scans directories and their parents to determine which are top-level vacant.
  * @param
- * @return A vector containing all top level vacant directories.
+ * @return A vector containing all top level vacant directories, in no particular order.
  */
-static std::vector<std::string> get_top_level_vacant_dirs() {
-  std::vector<std::string> top_level_vacant_dirs; 
+static std::vector<PathId> get_top_level_vacant_dirs() {
+  std::vector<PathId> top_level_vacant_dirs; 
   // ensures the highest level can be identified as top-level, by making its parent have a file count > 0.
   // its parent might not actually have a file count = 1, but this is just for the purposes of the algorithm.
-  n_files_map[NO_PATH] = 1;
+  n_files_map[NO_PATH_ID] = 1;
 
-  for (const auto& [dir_path, n_files] : n_files_map) {
-    if (n_files == 0 && n_files_map[parent_map[dir_path]] > 0) {
-      top_level_vacant_dirs.push_back(clean_path(dir_path));
+  for (const auto& [dir_id, n_files] : n_files_map) {
+    if (n_files == 0 && n_files_map[path_table.parent(dir_id)] > 0) {
+      top_level_vacant_dirs.push_back(dir_id);
     }
   }
-
-  // sort it in alphabetical order to make it easier to compare outputs with the Python file
-  std::sort(top_level_vacant_dirs.begin(), top_level_vacant_dirs.end());
   return top_level_vacant_dirs;
 }
 
+/**
+ * @brief Picks the candidates for the largest images, so that only their paths have to be built.
+ * @param images The images found by the scan (reordered).
+ * @param n The number of images to return.
+ * @return The n largest images plus any others tied with the n-th, since ties are broken by path.
+ */
+static std::vector<ImageEntry> get_largest_image_candidates(std::pmr::vector<ImageEntry> &images, int n) {
+  std::vector<ImageEntry> candidates;
+  if (n <= 0 || images.empty()) return candidates;
+
+  auto larger = [](const ImageEntry &image1, const ImageEntry &image2) {
+    return pixel_count(image1.width, image1.height) > pixel_count(image2.width, image2.height);
+  };
+  size_t n_largest = std::min(images.size(), static_cast<size_t>(n));
+  std::nth_element(images.begin(), images.begin() + n_largest - 1, images.end(), larger);
+  uint64_t min_pixels = pixel_count(images[n_largest - 1].width, images[n_largest - 1].height);
+  for (const ImageEntry &image : images) {
+    if (pixel_count(image.width, image.height) >= min_pixels) candidates.push_back(image);
+  }
+  return candidates;
+}
+
+/**
+ * @brief Picks the most common words.
+ * @param n The number of words to return.
+ * @return Views of the n most common words (in the word table, or in summarized_top_words once the
+ *         table has been summarized), sorted by WordFrequencyComparator.
+ */
+static std::vector<std::pair<std::string_view, int>> get_most_common_words(int n) {
+  if (summarized_words) {
+    summarized_top_words = summarized_words->top(std::max(n, 0));
+    return std::vector<std::pair<std::string_view, int>>(summarized_top_words.begin(), summarized_top_words.end());
+  }
+  std::vector<std::pair<std::string_view, int>> words(most_common_words_map.begin(), most_common_words_map.end());
+  size_t n_words = std::min(words.size(), static_cast<size_t>(std::max(n, 0)));
+  std::partial_sort(words.begin(), words.begin() + n_words, words.end(), WordFrequencyComparator());
+  words.resize(n_words);
+  return words;
+}
+
+/**
+ * @brief Builds a path into a reused buffer, without the leading "./" that clean_path() removes.
+ * @param path The ID of the path.
+ * @param buffer The buffer, overwritten.
+ * @return A view of the path in the buffer, valid until the buffer changes.
+ */
+static std::string_view relative_path(PathId path, std::string &buffer) {
+  buffer.clear();
+  path_table.append_path(path, buffer);
+  std::string_view view(buffer);
+  if (view.rfind(std::string(CURRENT_DIRECTORY) + PATH_SEPARATOR, 0) == 0) view.remove_prefix(2);
+  return view;
+}
+
+// MEMORY BUDGET
+// ===================================================================================================================
+/**
+ * @brief Estimates the memory held by the word table (or by its summary).
+ * @return The estimate, in bytes.
+ */
+static size_t word_table_usage() {
+  if (summarized_words) return summarized_words->size() * WORD_COUNTER_SIZE;
+  return most_common_words_map.size() * WORD_ENTRY_OVERHEAD + stored_word_bytes;
+}
+
+/**
+ * @brief Replaces the word table with a Space-Saving summary of its most common words, releasing
+ *        the table and the words' arena. Counts are approximate from then on.
+ * @return True if the table was summarized, false if it already had been.
+ */
+static bool summarize_word_table() {
+  if (summarized_words) return false;
+  // feeding the summary the most common words first keeps their counts exact
+  std::vector<std::pair<std::string_view, int>> words(most_common_words_map.begin(), most_common_words_map.end());
+  size_t n_kept = std::min(words.size(), WORD_SUMMARY_SIZE);
+  std::partial_sort(words.begin(), words.begin() + n_kept, words.end(), WordFrequencyComparator());
+  summarized_words.emplace(WORD_SUMMARY_SIZE);
+  for (size_t i = 0; i < n_kept; i++) summarized_words->add(std::string(words[i].first), words[i].second);
+
+  words.clear();
+  std::pmr::unordered_map<std::string_view, int>(&word_arena).swap(most_common_words_map);
+  word_arena.release();
+  stored_word_bytes = 0;
+  return true;
+}
+
+/**
+ * @brief Registers the analyzers the options turned on with the memory governor.
+ * @param options The options of the scan.
+ */
+static void govern_memory(const AnalyzeOptions &options) {
+  memory_governor = MemoryGovernor(options.max_memory_mb * BYTES_PER_MB);
+  memory_governor.add_analyzer("word counts (approximate from then on)", word_table_usage, summarize_word_table);
+  if (options.max_ngram_size >= 2) {
+    // each round drops the n-grams below twice the previous threshold
+    memory_governor.add_analyzer("n-gram counts (rare n-grams dropped)", [] { return ngram_counter.memory_usage(); },
+                                 [min_count = 1]() mutable { min_count *= 2; return ngram_counter.prune(min_count) > 0; });
+  }
+  if (options.file_stats) memory_governor.add_analyzer("file records", [] { return file_store.memory_usage(); });
+}
+
 // DIRECTORY TRAVERSAL
 // ===================================================================================================================
 /**
  * @brief Records rudimentary statistics about the provided directory.
  * @param dir_path The path to the current directory.
- * @param parent_dir_path The path to the parent directory.
+ * @param dir_id The ID of the current directory in the path table, which also knows its parent.
+ * @param depth How far below the analyzed directory this directory is (0 for the analyzed directory itself).
+ * @param arena Where the returned stats allocate from, which must outlive them.
  * @return A DirStats struct containing rudimentary statistics.
  */
-static DirStats get_dir_stats(const std::string &dir_path, const std::string &parent_dir_path) {
-  DirStats dir_stats;
+static DirStats get_dir_stats(const std::string &dir_path, PathId dir_id, int depth, std::pmr::memory_resource *arena) {
+  DirStats dir_stats(arena);
   DIR *dir = open_directory(dir_path);
-  parent_map[dir_path] = parent_dir_path;
-  n_files_map[dir_path] = 0;
+  // an unreadable directory still counts as a directory, but we can't tell whether it is vacant
+  if (!dir) return dir_stats;
+  // directories above the reported depth don't need a summary, since nothing reports it
+  bool summarize_words = analyze_options.dir_words_depth >= 0 && depth >= analyze_options.dir_words_depth;
+  if (summarize_words) dir_stats.word_summary = SpaceSavingSummary(analyze_options.dir_words_summary_size);
+  bool sketch_subtree = analyze_options.distinct_depth >= 0 && depth >= analyze_options.distinct_depth;
+  n_files_map[dir_id] = 0;
   
-  for (dirent *directory_entry = readdir(dir); directory_entry != nullptr; directory_entry = readdir(dir)) {
-    std::string entry_name = directory_entry->d_name;
+  // readdir() only reports failures through errno, so it has to be cleared before each call
+  errno = NO_ERROR;
+  // reused for every entry, so that they only allocate when a name or path is the longest yet
+  std::string entry_name;
+  std::string file_or_subdir_path;
+  for (dirent *directory_entry = readdir(dir); directory_entry != nullptr; errno = NO_ERROR, directory_entry = readdir(dir)) {
+    entry_name = directory_entry->d_name;
     if (entry_name == CURRENT_DIRECTORY || entry_name == PREVIOUS_DIRECTORY) continue;
-    std::string file_or_subdir_path = dir_path + PATH_SEPARATOR + entry_name;
+    file_or_subdir_path.assign(dir_path).append(1, PATH_SEPARATOR).append(entry_name);
     
     if (is_file(file_or_subdir_path)) {
       dir_stats.n_files++;
       // not related to stats, but we do this here so that we don't have to traverse the whole
       // tree again. For efficiency (ie. we're already traversing, might as well update the hashtables).
-      n_files_map[dir_path]++;
+      n_files_map[dir_id]++;
 
       struct stat file_stat;
+      long file_size = 0;
+      // only files that might be reported (the largest so far, images) go into the path table
+      PathId file_id = NO_PATH_ID;
+      auto get_file_id = [&]() {
+        if (file_id == NO_PATH_ID) file_id = path_table.add(dir_id, entry_name);
+        return file_id;
+      };
       
-      if (SYSCALL_SUCCESS == stat(file_or_subdir_path.c_str(), &file_stat)) {        
+      bool file_size_known = SYSCALL_SUCCESS == stat(file_or_subdir_path.c_str(), &file_stat);
+      if (file_size_known) {
+        file_size = file_stat.st_size;
         if (file_stat.st_size > dir_stats.largest_file_size) {
-          dir_stats.largest_file_path = clean_path(file_or_subdir_path);
+          dir_stats.largest_file = get_file_id();
           dir_stats.largest_file_size = file_stat.st_size;
         } 
 
         dir_stats.all_files_size += file_stat.st_size;
       }
+      memory_governor.tick();
+      if (analyze_options.file_stats) {
+        // a file that can't be stat'ed is never counted as stale
+        long mtime = file_size_known ? file_stat.st_mtime : LONG_MAX;
+        file_store.add(dir_id, entry_name, file_extension(entry_name), file_size, mtime, file_kind(entry_name));
+      }
+
+      if (analyze_options.count_distinct) {
+        uint64_t extension_hash = hll_hash(file_extension(entry_name));
+        distinct_extensions_sketch.add(extension_hash);
+        if (sketch_subtree) dir_stats.extension_sketch.add(extension_hash);
+      }
+
+      current_word_summary = summarize_words ? &dir_stats.word_summary : nullptr;
+      current_word_sketch = sketch_subtree ? &dir_stats.word_sketch : nullptr;
+      count_words_if_text(file_or_subdir_path, entry_name);
 
-      if (ends_with(lowercase(file_or_subdir_path), ".txt")) {
-        count_words_in_file(file_or_subdir_path);
+      if (analyze_options.scan_archives) {
+        Compression archive_compression;
+        ArchiveFormat archive_format = archive_format_from_name(entry_name, archive_compression);
+        if (archive_format != ArchiveFormat::NONE) {
+          analyze_archive(file_or_subdir_path, dir_id, entry_name, archive_format, archive_compression, dir_stats);
+        }
       }
 
-      auto image_info = get_image_info(file_or_subdir_path);
-      if (image_info.has_value()) {
-        dir_stats.largest_images.push_back(image_info.value());
+      // batched and pooled images are only collected at the end of the scan, into batched_images
+      if (image_batcher) {
+        image_batcher->add(file_or_subdir_path, get_file_id(), file_size);
+      } else if (image_pool) {
+        image_pool->submit([file_path = file_or_subdir_path, path_id = get_file_id(), file_size] {
+          auto image = get_image_info(file_path);
+          if (!image) return;
+          // a task the pool had no room for runs on the scanning thread
+          int worker = WorkerPool::this_worker();
+          NodeImages &node = *pooled_images[worker < 0 ? 0 : image_worker_nodes[worker]];
+          std::lock_guard<std::mutex> lock(node.mutex);
+          node.images.push_back(PooledImage{path_id, file_size, std::move(*image)});
+        });
+      } else {
+        auto image = get_image_info(file_or_subdir_path);
+        if (image.has_value()) {
+          record_image(get_file_id(), image.value(), file_size, dir_stats.largest_images);
+        }
       }
     }
     else if (is_dir(file_or_subdir_path)) {
       // we don't increment n_dirs since the recursive call will take care of that for us
       // (because we initialize n_dirs = 1, so each recursive call already counts its own dir)
-      DirStats subdir_stats = get_dir_stats(file_or_subdir_path, dir_path);
+      // the subtree's stats live in their own arena, released in one go once they are merged in
+      ScopedArena subdir_arena;
+      DirStats subdir_stats = get_dir_stats(file_or_subdir_path, path_table.add(dir_id, entry_name), depth + 1, subdir_arena.resource());
 
       if (subdir_stats.largest_file_size > dir_stats.largest_file_size) {
-        dir_stats.largest_file_path = clean_path(subdir_stats.largest_file_path);
+        dir_stats.largest_file = subdir_stats.largest_file;
         dir_stats.largest_file_size = subdir_stats.largest_file_size;
       }
 
       dir_stats.n_files += subdir_stats.n_files;
       // not related to stats, but we do this here so that we don't have to traverse the whole
       // tree again. For efficiency (ie. we're already traversing, might as well update the hashtables).
-      n_files_map[dir_path] += subdir_stats.n_files;
+      n_files_map[dir_id] += subdir_stats.n_files;
       dir_stats.n_dirs += subdir_stats.n_dirs;
       dir_stats.all_files_size += subdir_stats.all_files_size;
       dir_stats.largest_images.insert(dir_stats.largest_images.end(), subdir_stats.largest_images.begin(), subdir_stats.largest_images.end());
+      dir_stats.n_archive_members += subdir_stats.n_archive_members;
+      dir_stats.archive_members_size += subdir_stats.archive_members_size;
+      if (summarize_words) dir_stats.word_summary.merge(subdir_stats.word_summary);
+      if (sketch_subtree) {
+        dir_stats.word_sketch.merge(subdir_stats.word_sketch);
+        dir_stats.extension_sketch.merge(subdir_stats.extension_sketch);
+      }
     }
   }
+  if (errno != NO_ERROR) record_error(dir_path);
   closedir(dir);
+
+  if (summarize_words && depth == analyze_options.dir_words_depth) {
+    reported_word_summaries.emplace_back(clean_path(dir_path), std::move(dir_stats.word_summary));
+  }
+  if (sketch_subtree && depth == analyze_options.distinct_depth) {
+    reported_distinct_counts.push_back(DirDistinct{clean_path(dir_path), dir_stats.word_sketch.estimate(),
+                                                   dir_stats.extension_sketch.estimate()});
+  }
   return dir_stats;
 }
 
+/**
+ * @brief Starts the image pool, pinning its workers to CPUs spread over the NUMA nodes if the options
+ *        ask for it, with one list of measured images per node.
+ * @param options Options that change how the directory is analyzed.
+ */
+static void start_image_pool(const AnalyzeOptions & options)
+{
+    image_worker_nodes.assign(options.image_threads, 0);
+    size_t n_nodes = 1;
+    WorkerPool::Setup setup;
+    if (options.pin_threads) {
+        CpuTopology topology = CpuTopology::detect();
+        std::vector<WorkerPlacement> placements = spread_workers(topology, options.image_threads);
+        n_nodes = topology.nodes.size();
+        for (size_t i = 0; i < placements.size(); i++) {
+            auto node = std::find(topology.nodes.begin(), topology.nodes.end(), placements[i].node);
+            image_worker_nodes[i] = node - topology.nodes.begin();
+        }
+        // a worker's thread-local buffers and arena blocks are first touched by the worker itself, once
+        // pinned, so they land on its node even without binding its memory there
+        setup = [placements, bind_memory = options.numa_bind](int worker) {
+            pin_current_thread(placements[worker].cpu);
+            if (bind_memory) bind_current_thread_memory(placements[worker].node);
+        };
+    }
+    pooled_images.clear();
+    for (size_t node = 0; node < n_nodes; node++) pooled_images.push_back(std::make_unique<NodeImages>());
+    image_pool = std::make_unique<WorkerPool>(options.image_threads, setup);
+}
+
+/**
+ * @brief Records the images measured by the image pool, node by node. Unless the image statistics
+ *        need every image, each node's list is first cut down to its own n largest (and the images
+ *        tied with them), since no other image can make it into the global top n.
+ * @param n The number of largest images to return.
+ * @param images The list to add them to.
+ */
+static void collect_pooled_images(int n, std::pmr::vector<ImageEntry> &images)
+{
+    auto pixels = [](const PooledImage &pooled) { return pixel_count(pooled.image.width, pooled.image.height); };
+    for (auto &node : pooled_images) {
+        std::vector<PooledImage> &node_images = node->images;
+        if (!analyze_options.image_stats && n > 0 && node_images.size() > static_cast<size_t>(n)) {
+            auto larger = [&](const PooledImage &image1, const PooledImage &image2) { return pixels(image1) > pixels(image2); };
+            std::nth_element(node_images.begin(), node_images.begin() + n - 1, node_images.end(), larger);
+            uint64_t min_pixels = pixels(node_images[n - 1]);
+            auto smaller = [&](const PooledImage &pooled) { return pixels(pooled) < min_pixels; };
+            node_images.erase(std::remove_if(node_images.begin(), node_images.end(), smaller), node_images.end());
+        }
+        for (const PooledImage &pooled : node_images) record_image(pooled.path, pooled.image, pooled.file_size, images);
+    }
+    pooled_images.clear();
+}
+
+/**
+ * @brief Clears what a previous scan left behind, so that a process embedding the library can scan
+ *        again (and again) with fresh totals.
+ */
+static void reset_scan_state()
+{
+    scan_errors_map.clear();
+    timed_out_images.clear();
+    path_table.clear();
+    n_files_map.clear();
+    // the table's buckets are in the arena too, so it is replaced by an empty one before the arena goes
+    most_common_words_map = std::pmr::unordered_map<std::string_view, int>(&word_arena);
+    word_arena.release();
+    stored_word_bytes = 0;
+    summarized_words.reset();
+    summarized_top_words.clear();
+    reported_word_summaries.clear();
+    distinct_words_sketch = HyperLogLog();
+    distinct_extensions_sketch = HyperLogLog();
+    reported_distinct_counts.clear();
+    min_hasher = MinHasher();
+    near_duplicate_finder = NearDuplicateFinder();
+    line_counter = LineCounter();
+    text_line_totals = LineStats();
+    longest_line_path.clear();
+    n_crlf_files = 0;
+    text_file_lines.clear();
+    image_batcher.reset();
+    batched_images.clear();
+    image_format_names.clear();
+    file_store = FileStore();
+}
+
+/**
+ * @brief Sets up what the options ask for and scans the current directory.
+ * @param n The number of most common words and largest images to return.
+ * @param options Options that change how the directory is analyzed.
+ * @param arena Where the stats of the whole tree are allocated from.
+ * @return The stats of the whole tree, including the images read in batches.
+ */
+static DirStats scan_current_directory(int n, const AnalyzeOptions & options, std::pmr::memory_resource *arena)
+{
+    reset_scan_state();
+    analyze_options = options;
+    // found once: run_probe() runs the path it is given, without searching PATH for every file
+    identify_path = options.use_identify ? find_program(IDENTIFY_PROGRAM) : "";
+    text_classifier = TextClassifier(options.text_extensions, options.sniff_text);
+    ngram_counter = NGramCounter(options.max_ngram_size);
+    stop_word_filter = StopWordFilter(options.builtin_stop_words, options.stop_words);
+    term_counter = TermCounter(options.count_terms, static_cast<size_t>(std::max(n, 0)));
+    image_stats = ImageStats(n);
+    govern_memory(options);
+    if (options.io_uring_images) {
+        // without io_uring, the batcher reads the headers synchronously, a batch at a time
+        image_batcher = std::make_unique<ImageBatcher>(record_batched_image);
+        image_batcher->start();
+    } else if (options.image_threads > 1) {
+        start_image_pool(options);
+    }
+    // we want the stats for our current working directory, and it has no parent (we consider it to
+    // be the highest level)
+    DirStats dir_stats = get_dir_stats(CURRENT_DIRECTORY, path_table.add(NO_PATH_ID, CURRENT_DIRECTORY), 0, arena);
+    if (image_batcher) {
+        image_batcher->flush();
+        dir_stats.largest_images.insert(dir_stats.largest_images.end(), batched_images.begin(), batched_images.end());
+    }
+    if (image_pool) {
+        // waits for the last probes before stopping the workers
+        image_pool.reset();
+        collect_pooled_images(n, dir_stats.largest_images);
+    }
+    return dir_stats;
+}
+
 /**
  * @brief Analyzes a directory and returns statistics about its contents.
  * @param n The number of most common words and largest images to return.
+ * @param options Options that change how the directory is analyzed.
  * @return A `Results` struct containing directory analysis data.
  */
-Results analyzeDir(int n)
+Results analyzeDir(int n, const AnalyzeOptions & options)
 {
     Results results;
-    // we want the stats for our current working directory, and it has no parent (we consider it to
-    // be the highest level)
-    DirStats dir_stats = get_dir_stats(CURRENT_DIRECTORY, NO_PATH);
+    time_t scan_start = time(nullptr);
+    ScopedArena root_arena;
+    DirStats dir_stats = scan_current_directory(n, options, root_arena.resource());
     
     // simple stats
-    results.largest_file_path = dir_stats.largest_file_path;
+    results.largest_file_path = dir_stats.largest_file == NO_PATH_ID ? NO_PATH : clean_path(path_table.path(dir_stats.largest_file));
     results.largest_file_size = dir_stats.largest_file_size;
     results.n_files = dir_stats.n_files;
     results.n_dirs = dir_stats.n_dirs;
     results.all_files_size = dir_stats.all_files_size;
+    results.n_archive_members = dir_stats.n_archive_members;
+    results.archive_members_size = dir_stats.archive_members_size;
     
-    std::vector<std::pair<std::string, int>> most_common_words(most_common_words_map.begin(), most_common_words_map.end());
-    std::sort(most_common_words.begin(), most_common_words.end(), WordFrequencyComparator());
-    most_common_words.resize(std::min(static_cast<int>(most_common_words.size()), n));
-    results.most_common_words = most_common_words;
+    for (auto & [word, count] : get_most_common_words(n)) {
+        results.most_common_words.emplace_back(word, count);
+    }
+    if (options.max_ngram_size >= 2) results.most_common_bigrams = ngram_counter.most_common(2, n);
+    if (options.max_ngram_size >= 3) results.most_common_trigrams = ngram_counter.most_common(3, n);
     
-    std::sort(dir_stats.largest_images.begin(), dir_stats.largest_images.end(), ImageInfoComparator());
-    dir_stats.largest_images.resize(std::min(static_cast<int>(dir_stats.largest_images.size()), n));
-    results.largest_images = dir_stats.largest_images;
+    for (const ImageEntry & image : get_largest_image_candidates(dir_stats.largest_images, n)) {
+        results.largest_images.push_back(ImageInfo{clean_path(path_table.path(image.path)), image.width, image.height, image_format_names[image.format]});
+    }
+    std::sort(results.largest_images.begin(), results.largest_images.end(), ImageInfoComparator());
+    results.largest_images.resize(std::min(results.largest_images.size(), static_cast<size_t>(std::max(n, 0))));
+
+    for (PathId dir : get_top_level_vacant_dirs()) {
+        results.vacant_dirs.push_back(clean_path(path_table.path(dir)));
+    }
+    // sort it in alphabetical order to make it easier to compare outputs with the Python file
+    std::sort(results.vacant_dirs.begin(), results.vacant_dirs.end());
+
+    for (auto & [dir_path, word_summary] : reported_word_summaries) {
+        results.dir_top_words.push_back(DirWords{dir_path, word_summary.top(n)});
+    }
+    std::sort(results.dir_top_words.begin(), results.dir_top_words.end(), [](const DirWords & dir1, const DirWords & dir2) {
+        return dir1.path < dir2.path;
+    });
+
+    if (options.count_distinct) {
+        results.n_distinct_words = distinct_words_sketch.estimate();
+        results.n_distinct_extensions = distinct_extensions_sketch.estimate();
+    }
+    results.dir_distinct_counts = std::move(reported_distinct_counts);
+    std::sort(results.dir_distinct_counts.begin(), results.dir_distinct_counts.end(), [](const DirDistinct & dir1, const DirDistinct & dir2) {
+        return dir1.path < dir2.path;
+    });
+
+    results.term_counts = term_counter.results();
+    if (options.line_stats) {
+        results.text_lines = text_line_totals;
+        results.longest_line_path = longest_line_path;
+        results.n_crlf_files = n_crlf_files;
+        size_t n_most_lines = std::min(text_file_lines.size(), static_cast<size_t>(n));
+        std::partial_sort(text_file_lines.begin(), text_file_lines.begin() + n_most_lines, text_file_lines.end(), [](const auto & file1, const auto & file2) {
+            if (file1.second != file2.second) return file1.second > file2.second;
+            return file1.first < file2.first;
+        });
+        results.most_lines_files.assign(text_file_lines.begin(), text_file_lines.begin() + n_most_lines);
+    }
+    if (options.find_near_duplicates) {
+        results.near_duplicates = near_duplicate_finder.clusters(options.near_duplicate_similarity);
+    }
 
-    results.vacant_dirs = get_top_level_vacant_dirs();
+    if (options.image_stats) {
+        for (auto & [format, format_stats] : image_stats.formats()) {
+            results.image_formats.push_back(ImageFormatCount{format, format_stats.count, format_stats.bytes, format_stats.megapixels});
+        }
+        std::stable_sort(results.image_formats.begin(), results.image_formats.end(), [](const ImageFormatCount & format1, const ImageFormatCount & format2) {
+            return format1.count > format2.count;
+        });
+        results.image_megapixels = image_stats.megapixels();
+        const ImageSizeHistogram & histogram = image_stats.size_histogram();
+        for (int w = 0; w < IMAGE_SIZE_BUCKETS; w++) {
+            for (int h = 0; h < IMAGE_SIZE_BUCKETS; h++) {
+                if (histogram[w][h] > 0) results.image_size_histogram.push_back(ImageSizeBucket{w, h, histogram[w][h]});
+            }
+        }
+        for (auto & image : image_stats.smallest()) {
+            results.smallest_images.push_back(ImageInfo{clean_path(path_table.path(image.path)), image.width, image.height, image.format});
+        }
+        // by pixel count (ascending) and then alphabetically by path
+        std::sort(results.smallest_images.begin(), results.smallest_images.end(), [](const ImageInfo & image1, const ImageInfo & image2) {
+            uint64_t pixels1 = pixel_count(image1.width, image1.height);
+            uint64_t pixels2 = pixel_count(image2.width, image2.height);
+            if (pixels1 != pixels2) return pixels1 < pixels2;
+            return image1.path < image2.path;
+        });
+        results.smallest_images.resize(std::min(results.smallest_images.size(), static_cast<size_t>(std::max(n, 0))));
+    }
+
+    if (options.file_stats) {
+        std::vector<FileTotals> extension_totals = file_store.extension_totals();
+        for (ExtensionId id = 0; id < extension_totals.size(); id++) {
+            results.extension_counts.push_back(FileCount{file_store.extension(id), extension_totals[id].count, extension_totals[id].bytes});
+        }
+        size_t n_extensions = std::min(results.extension_counts.size(), static_cast<size_t>(n));
+        std::partial_sort(results.extension_counts.begin(), results.extension_counts.begin() + n_extensions, results.extension_counts.end(), [](const FileCount & extension1, const FileCount & extension2) {
+            if (extension1.bytes != extension2.bytes) return extension1.bytes > extension2.bytes;
+            return extension1.name < extension2.name;
+        });
+        results.extension_counts.resize(n_extensions);
+
+        auto kind_totals = file_store.kind_totals();
+        for (int kind = 0; kind < N_FILE_KINDS; kind++) {
+            results.file_kind_counts.push_back(FileCount{FILE_KIND_NAMES[kind], kind_totals[kind].count, kind_totals[kind].bytes});
+        }
+        FileSizeHistogram histogram = file_store.size_histogram();
+        results.file_size_histogram.assign(histogram.begin(), histogram.end());
+        FileTotals stale_files = file_store.modified_before(scan_start - STALE_FILE_SECONDS);
+        results.n_stale_files = stale_files.count;
+        results.stale_files_size = stale_files.bytes;
+
+        // only the candidates get their paths built, to break ties
+        for (size_t file : file_store.largest(n)) {
+            std::string path = path_table.path(file_store.parent(file)) + PATH_SEPARATOR + std::string(file_store.name(file));
+            results.largest_files.push_back(FileInfo{clean_path(path), file_store.file_size(file)});
+        }
+        std::sort(results.largest_files.begin(), results.largest_files.end(), [](const FileInfo & file1, const FileInfo & file2) {
+            if (file1.size != file2.size) return file1.size > file2.size;
+            return file1.path < file2.path;
+        });
+        results.largest_files.resize(std::min(results.largest_files.size(), static_cast<size_t>(n)));
+    }
+
+    results.degraded_analyzers = memory_governor.degraded();
+    results.timed_out_images = std::move(timed_out_images);
+    std::sort(results.timed_out_images.begin(), results.timed_out_images.end());
+
+    for (auto & [error_code, error_info] : scan_errors_map) {
+        results.scan_errors.push_back(error_info);
+    }
     
     return results;
 }
+
+CompactResults::CompactResults()
+    : arena(std::make_unique<std::pmr::monotonic_buffer_resource>()), most_common_words(arena.get()),
+      largest_images(arena.get()), vacant_dirs(arena.get())
+{
+}
+
+/**
+ * @brief Copies a string into the results' arena.
+ * @param text The string.
+ * @return A view of the copy, valid for the life of the results.
+ */
+std::string_view CompactResults::store(std::string_view text)
+{
+    char *copy = static_cast<char *>(arena->allocate(text.size(), alignof(char)));
+    memcpy(copy, text.data(), text.size());
+    return std::string_view(copy, text.size());
+}
+
+/**
+ * @brief Analyzes a directory like analyzeDir(), but only returns the plain analysis, as views
+ *        into one arena instead of a string per path and word.
+ * @param n The number of most common words and largest images to return.
+ * @param options Options that change how the directory is analyzed.
+ * @return The results, which can be moved but not copied.
+ */
+CompactResults analyzeDirCompact(int n, const AnalyzeOptions & options)
+{
+    CompactResults results;
+    ScopedArena root_arena;
+    DirStats dir_stats = scan_current_directory(n, options, root_arena.resource());
+    // every path is built into this one buffer and then copied into the results' arena
+    std::string path_buffer;
+
+    if (dir_stats.largest_file != NO_PATH_ID) {
+        results.largest_file_path = results.store(relative_path(dir_stats.largest_file, path_buffer));
+    }
+    results.largest_file_size = dir_stats.largest_file_size;
+    results.n_files = dir_stats.n_files;
+    results.n_dirs = dir_stats.n_dirs;
+    results.all_files_size = dir_stats.all_files_size;
+    results.n_archive_members = dir_stats.n_archive_members;
+    results.archive_members_size = dir_stats.archive_members_size;
+
+    auto most_common_words = get_most_common_words(n);
+    results.most_common_words.reserve(most_common_words.size());
+    for (auto & [word, count] : most_common_words) {
+        results.most_common_words.push_back(WordCountView{results.store(word), count});
+    }
+
+    auto candidates = get_largest_image_candidates(dir_stats.largest_images, n);
+    results.largest_images.reserve(candidates.size());
+    for (const ImageEntry & image : candidates) {
+        results.largest_images.push_back(ImageView{results.store(relative_path(image.path, path_buffer)), image.width, image.height});
+    }
+    std::sort(results.largest_images.begin(), results.largest_images.end(), [](const ImageView & image1, const ImageView & image2) {
+        uint64_t pixels1 = pixel_count(image1.width, image1.height);
+        uint64_t pixels2 = pixel_count(image2.width, image2.height);
+        if (pixels1 != pixels2) return pixels1 > pixels2;
+        return image1.path < image2.path;
+    });
+    results.largest_images.resize(std::min(results.largest_images.size(), static_cast<size_t>(std::max(n, 0))));
+
+    auto vacant_dirs = get_top_level_vacant_dirs();
+    results.vacant_dirs.reserve(vacant_dirs.size());
+    for (PathId dir : vacant_dirs) {
+        results.vacant_dirs.push_back(results.store(relative_path(dir, path_buffer)));
+    }
+    std::sort(results.vacant_dirs.begin(), results.vacant_dirs.end());
+
+    return results;
+}
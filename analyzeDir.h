@@ -1,12 +1,141 @@
 #pragma once
 
+#include "lineStats.h"
+#include "minHash.h"
+#include "termCounter.h"
+
+#include <memory>
+#include <memory_resource>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
 struct ImageInfo {
     std::string path;
     long width, height;
+    std::string format; // as ImageMagick names it, e.g. "PNG"
+};
+
+// the images of one format (see AnalyzeOptions::image_stats)
+struct ImageFormatCount {
+    std::string format;
+    long count;
+    long bytes;
+    double megapixels;
+};
+
+// the number of images with a width in [2^log2_width, 2^(log2_width + 1)) and a height in
+// [2^log2_height, 2^(log2_height + 1)); the last bucket on each side is open-ended
+struct ImageSizeBucket {
+    int log2_width, log2_height;
+    long count;
+};
+
+// failures that were skipped over during the scan, grouped by their errno
+struct ScanErrorInfo {
+    int error_code;                        // errno shared by every failure in this group
+    long count;                            // number of failures with this errno
+    std::vector<std::string> sample_paths; // the first few paths that failed with this errno
+};
+
+// the most common words of one directory's subtree
+struct DirWords {
+    std::string path;
+    // estimated counts, which may overshoot the true counts (see AnalyzeOptions::dir_words_summary_size)
+    std::vector<std::pair<std::string, int>> words;
+};
+
+// the files of one extension or kind (see AnalyzeOptions::file_stats)
+struct FileCount {
+    std::string name;
+    long count;
+    long bytes;
+};
+
+struct FileInfo {
+    std::string path;
+    long size;
+};
+
+// approximate numbers of distinct words and file extensions in one directory's subtree
+struct DirDistinct {
+    std::string path;
+    long n_distinct_words;
+    long n_distinct_extensions;
+};
+
+// knobs that change how the directory is analyzed; the defaults reproduce the plain analysis
+struct AnalyzeOptions {
+    // number of times an operation that fails with a transient errno (EINTR, EAGAIN, ESTALE, ...)
+    // is retried before it is recorded as a scan error
+    int transient_retries = 0;
+    // number of failing paths remembered per errno
+    int max_error_samples = 5;
+
+    // files with these extensions (case-insensitive, leading dot optional) are treated as text
+    std::vector<std::string> text_extensions = { ".txt" };
+    // also treat a file with any other extension (or none) as text if its first 4 KB look like text
+    bool sniff_text = false;
+    // decode text as UTF-8, so that words may contain letters of any script (case folded);
+    // by default only A-Z and a-z are letters
+    bool unicode_words = false;
+    // longest word n-gram to count: 1 counts words only, 2 adds bigrams, 3 adds trigrams
+    int max_ngram_size = 1;
+    // drop common English words ("there", "which", "would", ...) before they are counted
+    bool builtin_stop_words = false;
+    // more words to drop before they are counted (case-insensitive)
+    std::vector<std::string> stop_words;
+    // report the most common words of every directory this far below the analyzed directory
+    // (0 = the analyzed directory, 1 = its subdirectories, ...); -1 turns this off
+    int dir_words_depth = -1;
+    // number of counters in each directory's word summary: more counters give closer estimates
+    size_t dir_words_summary_size = 256;
+    // estimate the number of distinct words and file extensions (within about 1%)
+    bool count_distinct = false;
+    // also estimate them for every directory this far below the analyzed directory; -1 turns this off
+    int distinct_depth = -1;
+    // report clusters of text files whose words are nearly the same (by MinHash signatures)
+    bool find_near_duplicates = false;
+    // estimated Jaccard similarity of their word shingles from which two files are near duplicates
+    double near_duplicate_similarity = 0.8;
+    // count the exact (case-sensitive) occurrences of these terms in text files
+    std::vector<std::string> count_terms;
+    // gather line counts, line lengths, line endings and non-ASCII bytes of text files
+    bool line_stats = false;
+    // keep a record of every file for extension, kind, size and age statistics and the largest files
+    bool file_stats = false;
+    // read image dimensions from the file headers first, for the formats parse_image_header() knows
+    bool native_images = false;
+    // run identify on the files whose format isn't known natively (or on every file, without native_images)
+    bool use_identify = true;
+    // read the headers of image candidates in batches through io_uring (implies native_images)
+    bool io_uring_images = false;
+    // measure images on this many threads, so that identify runs (or header reads) overlap; 1 = on
+    // the scanning thread. Not used with io_uring_images
+    int image_threads = 1;
+    // pin the image_threads workers to CPUs, spread over the NUMA nodes
+    bool pin_threads = false;
+    // also take each pinned worker's memory from its own NUMA node only (instead of first touch)
+    bool numa_bind = false;
+    // gather per-format counts, megapixels, a dimension histogram and the smallest images
+    bool image_stats = false;
+    // wall-clock (and CPU) seconds identify may take on one file before it is killed; 0 = no limit
+    double identify_timeout_seconds = 10;
+    // address space identify may use, in MB; 0 = no limit. It counts what is reserved, not just
+    // what is used: each of ImageMagick's OpenMP threads reserves a stack and a malloc arena, so
+    // with many cores a tight limit makes identify fail (setting MAGICK_THREAD_LIMIT=1 avoids that)
+    long identify_memory_mb = 8192;
+
+    // memory the scan should stay within, in MB: past it, the analyzers holding the most memory
+    // are asked to trade accuracy for space (see Results::degraded_analyzers); 0 = no limit
+    long max_memory_mb = 0;
+
+    // analyze the files inside .tar (optionally .gz/.zst compressed) and .zip archives without
+    // extracting them; they are reported as "archive.tar!/path/inside"
+    bool scan_archives = false;
+    // also count archive members in n_files, all_files_size and the largest file
+    bool count_archive_members = false;
 };
 
 struct Results {
@@ -15,11 +144,17 @@ struct Results {
     long n_files;                                              // total number of files in the directory (recursive)
     long n_dirs;                                               // total number of directories in the directory (recursive)
     long all_files_size;                                       // cumulative size (in bytes) of all files
+    long n_archive_members;                                    // files found inside archives (if scanned)
+    long archive_members_size;                                 // cumulative size (in bytes) of those files
     
-    // most common words found in .txt files
+    // most common words found in text files (.txt by default, see AnalyzeOptions)
     // word = sequence of 5 or more alphabetic characters, converted to lower case
     // sorted by frequency, reported with their counts
     std::vector<std::pair<std::string, int>> most_common_words;
+    // most common runs of 2 and 3 consecutive words (as defined above) within a file, joined by
+    // spaces; only filled in if AnalyzeOptions::max_ngram_size asks for them
+    std::vector<std::pair<std::string, int>> most_common_bigrams;
+    std::vector<std::pair<std::string, int>> most_common_trigrams;
     // largest (in pixels) images found in the directory,
     // sorted by their size (in pixels), reported with their width and height
     std::vector<ImageInfo> largest_images;
@@ -29,6 +164,98 @@ struct Results {
     // (resursive) if a directory is reported vacant, none of its subdirectories should be reported
     // here
     std::vector<std::string> vacant_dirs;
+
+    // files and directories that could not be read, sorted by errno. The scan skips over them
+    // instead of aborting, so every other statistic excludes whatever they contained
+    std::vector<ScanErrorInfo> scan_errors;
+
+    // image population statistics (see AnalyzeOptions::image_stats)
+    std::vector<ImageFormatCount> image_formats; // sorted by count (descending), then by format
+    double image_megapixels = 0;
+    std::vector<ImageSizeBucket> image_size_histogram; // the non-empty buckets, by width then height
+    std::vector<ImageInfo> smallest_images;            // the N smallest, by pixel count then path
+    // analyzers that had to give up accuracy to keep the scan within AnalyzeOptions::max_memory_mb
+    std::vector<std::string> degraded_analyzers;
+    // files identify was killed on for running past AnalyzeOptions::identify_timeout_seconds, sorted
+    std::vector<std::string> timed_out_images;
+
+    // most common words of each directory at AnalyzeOptions::dir_words_depth, sorted by path
+    std::vector<DirWords> dir_top_words;
+
+    // approximate distinct counts (see AnalyzeOptions::count_distinct); files without an extension
+    // count as one more extension
+    long n_distinct_words = 0;
+    long n_distinct_extensions = 0;
+    // approximate distinct counts of each directory at AnalyzeOptions::distinct_depth, sorted by path
+    std::vector<DirDistinct> dir_distinct_counts;
+
+    // clusters of near-duplicate text files (see AnalyzeOptions::find_near_duplicates)
+    std::vector<NearDuplicateCluster> near_duplicates;
+
+    // occurrences of each of AnalyzeOptions::count_terms, in the order given, with their top N files
+    std::vector<TermCount> term_counts;
+
+    // line statistics of all text files together (see AnalyzeOptions::line_stats)
+    LineStats text_lines;
+    std::string longest_line_path; // the file holding the longest line
+    long n_crlf_files = 0;         // text files with at least one "\r\n" line ending
+    // the top N text files by number of lines, sorted by lines (descending) and then by path
+    std::vector<std::pair<std::string, long>> most_lines_files;
+
+    // file population statistics (see AnalyzeOptions::file_stats)
+    std::vector<FileCount> extension_counts; // the top N extensions by bytes, then by name ("" = none)
+    std::vector<FileCount> file_kind_counts; // text, compressed, archive and other files
+    std::vector<long> file_size_histogram;   // files per size: empty, then 1, 2-3, 4-7, ... bytes
+    long n_stale_files = 0;                  // files not modified for a year
+    long stale_files_size = 0;
+    std::vector<FileInfo> largest_files;     // the top N by size (descending), then by path
+};
+
+struct WordCountView {
+    std::string_view word;
+    int count;
+};
+
+struct ImageView {
+    std::string_view path;
+    long width, height;
+};
+
+/**
+ * @brief The plain analysis of Results (totals, words, images and vacant directories) without a
+ *        string per entry: every path and word is copied once into an arena owned by the results,
+ *        and the lists, which live in the same arena, hold views into it. Moving the results moves
+ *        the arena along, so the views stay valid; copying is not allowed.
+ *
+ * The statistics of the other options are only in Results.
+ */
+class CompactResults {
+    // declared first, since the lists below are constructed on it
+    std::unique_ptr<std::pmr::monotonic_buffer_resource> arena;
+
+public:
+    CompactResults();
+    CompactResults(CompactResults &&) = default;
+    // assigning would have to keep the lists' old arena alive, so results can only be moved into place
+    CompactResults & operator=(CompactResults &&) = delete;
+    CompactResults(const CompactResults &) = delete;
+    CompactResults & operator=(const CompactResults &) = delete;
+
+    std::string_view store(std::string_view text);
+
+    std::string_view largest_file_path;
+    long largest_file_size = 0;
+    long n_files = 0;
+    long n_dirs = 0;
+    long all_files_size = 0;
+    long n_archive_members = 0;
+    long archive_members_size = 0;
+    // ordered like their counterparts in Results
+    std::pmr::vector<WordCountView> most_common_words;
+    std::pmr::vector<ImageView> largest_images;
+    std::pmr::vector<std::string_view> vacant_dirs;
 };
 
-Results analyzeDir(int n);
+Results analyzeDir(int n, const AnalyzeOptions & options = AnalyzeOptions());
+CompactResults analyzeDirCompact(int n, const AnalyzeOptions & options = AnalyzeOptions());
+std::string describe_scan_error(int error_code);
@@ -0,0 +1,389 @@
+#include "analyzeDir.h"
+#include "testing.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <dlfcn.h>
+#include <fstream>
+#include <map>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+constexpr int SCAN_TOP_N = 5;
+
+// a failure injected into opendir() for one directory (matched by name)
+struct InjectedFailure {
+    int error_code;
+    int n_failures; // the calls that fail; the ones after succeed
+    int n_calls = 0;
+};
+
+static std::map<std::string, InjectedFailure> injected_failures;
+
+/**
+ * @brief Stands in for the C library's opendir(), which the scan calls to read every directory, so
+ *        that a directory can be made to fail with any errno (running as root, permissions can't).
+ */
+extern "C" DIR * opendir(const char * name)
+{
+    using OpenDirectory = DIR * (*)(const char *);
+    static OpenDirectory real_opendir = reinterpret_cast<OpenDirectory>(dlsym(RTLD_NEXT, "opendir"));
+    const char * slash = strrchr(name, '/');
+    auto injected = injected_failures.find(slash ? slash + 1 : name);
+    if (injected != injected_failures.end() && injected->second.n_calls++ < injected->second.n_failures) {
+        errno = injected->second.error_code;
+        return nullptr;
+    }
+    return real_opendir(name);
+}
+
+/**
+ * @brief Makes a temporary directory holding one text file and the given subdirectories, each with
+ *        one text file of its own.
+ * @return The path of the temporary directory.
+ */
+static std::string make_scan_directory(const std::vector<std::string> & subdirectories)
+{
+    char directory[] = "/tmp/analyzeDirTestXXXXXX";
+    CHECK(mkdtemp(directory) != nullptr);
+    std::ofstream(std::string(directory) + "/top.txt") << "readable words\n";
+    for (const std::string & subdirectory : subdirectories) {
+        std::string path = std::string(directory) + "/" + subdirectory;
+        CHECK(mkdir(path.c_str(), 0755) == 0);
+        std::ofstream(path + "/inside.txt") << "hidden words\n";
+    }
+    return directory;
+}
+
+static void remove_scan_directory(const std::string & directory, const std::vector<std::string> & subdirectories)
+{
+    for (const std::string & subdirectory : subdirectories) {
+        unlink((directory + "/" + subdirectory + "/inside.txt").c_str());
+        rmdir((directory + "/" + subdirectory).c_str());
+    }
+    unlink((directory + "/top.txt").c_str());
+    rmdir(directory.c_str());
+}
+
+/**
+ * @brief Scans a directory in a child process (see run_in_child_process()) and checks the results there.
+ */
+template <typename Checks>
+static void scan_in_child(const std::string & directory, const AnalyzeOptions & options, Checks checks)
+{
+    run_in_child_process([&] {
+        CHECK(chdir(directory.c_str()) == 0);
+        checks(analyzeDir(SCAN_TOP_N, options));
+    });
+}
+
+TEST_CASE(scan_errors_retry_transient_failures)
+{
+    std::vector<std::string> subdirectories = { "flaky" };
+    std::string directory = make_scan_directory(subdirectories);
+    AnalyzeOptions options;
+
+    // two stale file handles in a row, then the directory reads fine
+    injected_failures = { { "flaky", { ESTALE, 2 } } };
+    options.transient_retries = 2;
+    scan_in_child(directory, options, [](const Results & results) {
+        CHECK(results.scan_errors.empty());
+        CHECK(results.n_files == 2);
+        CHECK(injected_failures.at("flaky").n_calls == 3);
+    });
+
+    // one retry isn't enough, so the directory is skipped and reported
+    options.transient_retries = 1;
+    scan_in_child(directory, options, [](const Results & results) {
+        CHECK(results.scan_errors.size() == 1);
+        if (results.scan_errors.size() == 1) {
+            CHECK(results.scan_errors[0].error_code == ESTALE);
+            CHECK(results.scan_errors[0].count == 1);
+            CHECK(results.scan_errors[0].sample_paths == std::vector<std::string>{ "flaky" });
+        }
+        CHECK(results.n_files == 1);
+    });
+
+    // a permanent failure is never retried
+    injected_failures = { { "flaky", { EACCES, 1 } } };
+    options.transient_retries = 3;
+    scan_in_child(directory, options, [](const Results & results) {
+        CHECK(results.scan_errors.size() == 1 && results.scan_errors[0].error_code == EACCES);
+        CHECK(injected_failures.at("flaky").n_calls == 1);
+    });
+    injected_failures.clear();
+    remove_scan_directory(directory, subdirectories);
+}
+
+TEST_CASE(scan_errors_grouped_by_errno_and_sampled)
+{
+    std::vector<std::string> denied = { "denied0", "denied1", "denied2", "denied3", "denied4" };
+    std::vector<std::string> broken = { "broken0", "broken1" };
+    std::vector<std::string> subdirectories = denied;
+    subdirectories.insert(subdirectories.end(), broken.begin(), broken.end());
+    subdirectories.push_back("fine");
+    std::string directory = make_scan_directory(subdirectories);
+
+    for (const std::string & name : denied) { injected_failures[name] = { EACCES, 1 }; }
+    for (const std::string & name : broken) { injected_failures[name] = { EIO, 1 }; }
+    AnalyzeOptions options;
+    options.max_error_samples = 3;
+    scan_in_child(directory, options, [&](const Results & results) {
+        // one group per errno, in errno order, each sampling the first few paths that failed
+        CHECK(results.scan_errors.size() == 2);
+        if (results.scan_errors.size() == 2) {
+            const ScanErrorInfo & io_errors = results.scan_errors[0];
+            const ScanErrorInfo & access_errors = results.scan_errors[1];
+            CHECK(io_errors.error_code == EIO && io_errors.count == 2);
+            CHECK(access_errors.error_code == EACCES && access_errors.count == 5);
+            auto sampled_from = [](const ScanErrorInfo & errors, const std::vector<std::string> & paths, size_t n_samples) {
+                std::vector<std::string> samples = errors.sample_paths;
+                std::sort(samples.begin(), samples.end());
+                return samples.size() == n_samples && std::adjacent_find(samples.begin(), samples.end()) == samples.end()
+                    && std::all_of(samples.begin(), samples.end(), [&](const std::string & sample) {
+                           return std::find(paths.begin(), paths.end(), sample) != paths.end();
+                       });
+            };
+            CHECK(sampled_from(io_errors, broken, 2));
+            CHECK(sampled_from(access_errors, denied, 3));
+        }
+        // the readable files are all counted: the top one and the one in "fine"
+        CHECK(results.n_files == 2);
+    });
+    injected_failures.clear();
+    remove_scan_directory(directory, subdirectories);
+}
+
+// FIXTURES
+// ===================================================================================================================
+constexpr char FIXTURE_DIRECTORY[] = "tests/";
+constexpr int FIXTURE_TOP_N = 5;
+
+// what the command reports for one of the fixtures in tests/
+struct FixtureTotals {
+    const char * name;
+    const char * largest_file_path;
+    long largest_file_size;
+    long n_files;
+    long n_dirs;
+    long all_files_size;
+    const char * top_word;
+    int top_word_count;
+};
+
+const FixtureTotals FIXTURES[] = {
+    { "test1.c", "empty.txt", 127, 1, 1, 127, "github", 1 },
+    { "test2", "scanf.txt", 130, 2, 1, 259, "github", 2 },
+    { "test3", "happy.jpg", 130, 4, 3, 517, "github", 1 },
+    { "test4", "signal.txt", 130, 3, 1, 259, "github", 2 },
+    { "test5", ".words.txt", 127, 3, 1, 381, "cdefb", 3 },
+    { "test6", "sub/images/noisy.png", 131, 1342, 243, 172998, "github", 206 },
+    { "test7", "test6.txt", 132, 1, 1, 132, "github", 1 },
+    { "test8", "1.txt", 127, 4, 2, 506, "github", 3 },
+    { "test9", "sub/images/noisy.png", 131, 72, 34, 9004, "github", 6 },
+    { "test11", "rando.txt", 134, 2, 1, 266, "github", 2 },
+};
+
+/**
+ * @brief Returns the options the fixtures are scanned with. The fixtures hold no real images, and
+ *        identify is left out so that the checks don't depend on ImageMagick being installed.
+ */
+static AnalyzeOptions fixture_options()
+{
+    AnalyzeOptions options;
+    options.native_images = true;
+    options.use_identify = false;
+    return options;
+}
+
+/**
+ * @brief Runs a scan with the fixture as the current directory, as the command does.
+ */
+template <typename Scan>
+static auto in_fixture(const char * name, Scan scan)
+{
+    char original_directory[PATH_MAX];
+    bool saved = getcwd(original_directory, sizeof(original_directory)) != nullptr;
+    bool entered = chdir((std::string(FIXTURE_DIRECTORY) + name).c_str()) == 0;
+    CHECK(entered);
+    auto results = scan();
+    if (saved && chdir(original_directory) != 0) { CHECK(! "could not return to the original directory"); }
+    return results;
+}
+
+static bool same_results(const Results & results1, const Results & results2)
+{
+    auto same_images = [](const std::vector<ImageInfo> & images1, const std::vector<ImageInfo> & images2) {
+        if (images1.size() != images2.size()) { return false; }
+        for (size_t i = 0; i < images1.size(); i++) {
+            if (images1[i].path != images2[i].path || images1[i].width != images2[i].width
+                || images1[i].height != images2[i].height || images1[i].format != images2[i].format) {
+                return false;
+            }
+        }
+        return true;
+    };
+    return results1.largest_file_path == results2.largest_file_path && results1.largest_file_size == results2.largest_file_size
+        && results1.n_files == results2.n_files && results1.n_dirs == results2.n_dirs
+        && results1.all_files_size == results2.all_files_size && results1.most_common_words == results2.most_common_words
+        && results1.most_common_bigrams == results2.most_common_bigrams && same_images(results1.largest_images, results2.largest_images)
+        && results1.vacant_dirs == results2.vacant_dirs && results1.scan_errors.size() == results2.scan_errors.size()
+        && results1.n_distinct_words == results2.n_distinct_words && results1.n_distinct_extensions == results2.n_distinct_extensions
+        && results1.text_lines.n_lines == results2.text_lines.n_lines && results1.most_lines_files == results2.most_lines_files
+        && results1.file_size_histogram == results2.file_size_histogram && results1.n_stale_files == results2.n_stale_files;
+}
+
+TEST_CASE(analyze_dir_fixtures)
+{
+    for (const FixtureTotals & fixture : FIXTURES) {
+        Results results = in_fixture(fixture.name, [] { return analyzeDir(FIXTURE_TOP_N, fixture_options()); });
+        CHECK(results.largest_file_path == fixture.largest_file_path);
+        CHECK(results.largest_file_size == fixture.largest_file_size);
+        CHECK(results.n_files == fixture.n_files);
+        CHECK(results.n_dirs == fixture.n_dirs);
+        CHECK(results.all_files_size == fixture.all_files_size);
+        CHECK(! results.most_common_words.empty());
+        if (! results.most_common_words.empty()) {
+            CHECK(results.most_common_words[0].first == fixture.top_word);
+            CHECK(results.most_common_words[0].second == fixture.top_word_count);
+        }
+        CHECK(results.most_common_words.size() <= static_cast<size_t>(FIXTURE_TOP_N));
+        CHECK(results.vacant_dirs.empty());
+        CHECK(results.scan_errors.empty());
+    }
+}
+
+TEST_CASE(analyze_dir_compact_matches_results)
+{
+    for (const FixtureTotals & fixture : FIXTURES) {
+        Results results = in_fixture(fixture.name, [] { return analyzeDir(FIXTURE_TOP_N, fixture_options()); });
+        CompactResults compact = in_fixture(fixture.name, [] { return analyzeDirCompact(FIXTURE_TOP_N, fixture_options()); });
+        CHECK(compact.largest_file_path == results.largest_file_path);
+        CHECK(compact.largest_file_size == results.largest_file_size);
+        CHECK(compact.n_files == results.n_files);
+        CHECK(compact.n_dirs == results.n_dirs);
+        CHECK(compact.all_files_size == results.all_files_size);
+        CHECK(compact.most_common_words.size() == results.most_common_words.size());
+        for (size_t i = 0; i < std::min(compact.most_common_words.size(), results.most_common_words.size()); i++) {
+            CHECK(compact.most_common_words[i].word == results.most_common_words[i].first);
+            CHECK(compact.most_common_words[i].count == results.most_common_words[i].second);
+        }
+        CHECK(compact.vacant_dirs.size() == results.vacant_dirs.size());
+    }
+}
+
+TEST_CASE(analyze_dir_repeated_calls_start_fresh)
+{
+    AnalyzeOptions options = fixture_options();
+    options.max_ngram_size = 2;
+    options.count_distinct = true;
+    options.line_stats = true;
+    options.file_stats = true;
+    options.image_stats = true;
+    for (const char * fixture : { "test6", "test9" }) {
+        Results first = in_fixture(fixture, [&] { return analyzeDir(FIXTURE_TOP_N, options); });
+        Results second = in_fixture(fixture, [&] { return analyzeDir(FIXTURE_TOP_N, options); });
+        CHECK(same_results(first, second));
+    }
+
+    // a scan of another directory in between must not leak into the next one
+    Results alone = in_fixture("test2", [] { return analyzeDir(FIXTURE_TOP_N, fixture_options()); });
+    in_fixture("test6", [] { return analyzeDir(FIXTURE_TOP_N, fixture_options()); });
+    Results after_other = in_fixture("test2", [] { return analyzeDir(FIXTURE_TOP_N, fixture_options()); });
+    CHECK(same_results(alone, after_other));
+}
+
+/**
+ * @brief Writes the start of a PNG file (the signature and the IHDR chunk), which is all the native
+ *        header reader looks at.
+ */
+static void write_png_header(const std::string & path, uint32_t width, uint32_t height)
+{
+    std::string header("\x89PNG\r\n\x1a\n\0\0\0\x0dIHDR", 16);
+    for (uint32_t value : { width, height }) {
+        for (int shift = 24; shift >= 0; shift -= 8) { header += static_cast<char>((value >> shift) & 0xFF); }
+    }
+    header += std::string("\x08\x06\0\0\0", 5);
+    std::ofstream(path, std::ios::binary) << header;
+}
+
+static void write_gif_header(const std::string & path, uint16_t width, uint16_t height)
+{
+    std::string header = "GIF89a";
+    for (uint16_t value : { width, height }) { header += { static_cast<char>(value & 0xFF), static_cast<char>(value >> 8) }; }
+    header += std::string("\0\0\0", 3);
+    std::ofstream(path, std::ios::binary) << header;
+}
+
+TEST_CASE(analyze_dir_reports_image_formats)
+{
+    char directory[] = "/tmp/analyzeDirTestXXXXXX";
+    CHECK(mkdtemp(directory) != nullptr);
+    std::string base = directory;
+    write_png_header(base + "/wide.png", 40, 30);
+    write_gif_header(base + "/square.gif", 10, 10);
+    write_png_header(base + "/tiny.png", 5, 5);
+
+    AnalyzeOptions options = fixture_options();
+    options.image_stats = true;
+    char original_directory[PATH_MAX];
+    bool saved = getcwd(original_directory, sizeof(original_directory)) != nullptr;
+    CHECK(chdir(directory) == 0);
+    Results results = analyzeDir(FIXTURE_TOP_N, options);
+    if (saved && chdir(original_directory) != 0) { CHECK(! "could not return to the original directory"); }
+    for (const char * name : { "/wide.png", "/square.gif", "/tiny.png" }) { unlink((base + name).c_str()); }
+    rmdir(directory);
+
+    auto same_image = [](const ImageInfo & image, const char * path, long width, long height, const char * format) {
+        return image.path == path && image.width == width && image.height == height && image.format == format;
+    };
+    CHECK(results.largest_images.size() == 3);
+    CHECK(results.smallest_images.size() == 3);
+    if (results.largest_images.size() == 3 && results.smallest_images.size() == 3) {
+        CHECK(same_image(results.largest_images[0], "wide.png", 40, 30, "PNG"));
+        CHECK(same_image(results.largest_images[1], "square.gif", 10, 10, "GIF"));
+        CHECK(same_image(results.largest_images[2], "tiny.png", 5, 5, "PNG"));
+        CHECK(same_image(results.smallest_images[0], "tiny.png", 5, 5, "PNG"));
+        CHECK(same_image(results.smallest_images[1], "square.gif", 10, 10, "GIF"));
+        CHECK(same_image(results.smallest_images[2], "wide.png", 40, 30, "PNG"));
+    }
+}
+
+TEST_CASE(analyze_dir_smallest_images_break_ties_by_path)
+{
+    // more tied images than are reported, so the candidates have to be cut down by path
+    char directory[] = "/tmp/analyzeDirTestXXXXXX";
+    CHECK(mkdtemp(directory) != nullptr);
+    std::vector<std::string> paths;
+    for (int i = 0; i < 3 * FIXTURE_TOP_N; i++) {
+        paths.push_back(std::string(directory) + "/tied" + std::to_string(100 - i) + ".png");
+        write_png_header(paths.back(), 4, 4);
+    }
+    for (int i = 0; i < 3 * FIXTURE_TOP_N; i++) {
+        paths.push_back(std::string(directory) + "/large" + std::to_string(i) + ".gif");
+        write_gif_header(paths.back(), 100 + i, 100);
+    }
+    paths.push_back(std::string(directory) + "/smallest.gif");
+    write_gif_header(paths.back(), 1, 1);
+
+    AnalyzeOptions options = fixture_options();
+    options.image_stats = true;
+    char original_directory[PATH_MAX];
+    bool saved = getcwd(original_directory, sizeof(original_directory)) != nullptr;
+    CHECK(chdir(directory) == 0);
+    Results results = analyzeDir(FIXTURE_TOP_N, options);
+    if (saved && chdir(original_directory) != 0) { CHECK(! "could not return to the original directory"); }
+    for (const std::string & path : paths) { unlink(path.c_str()); }
+    rmdir(directory);
+
+    std::vector<std::string> smallest;
+    for (const ImageInfo & image : results.smallest_images) { smallest.push_back(image.path); }
+    CHECK((smallest == std::vector<std::string>{ "smallest.gif", "tied100.png", "tied86.png", "tied87.png", "tied88.png" }));
+    CHECK(results.image_formats.size() == 2);
+}
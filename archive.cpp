@@ -0,0 +1,558 @@
+#include "archive.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#ifdef HAVE_ZLIB
+    #include <zlib.h>
+#endif
+
+constexpr std::string_view TAR_EXTENSION = ".tar";
+constexpr std::string_view TGZ_EXTENSION = ".tgz";
+constexpr std::string_view TZST_EXTENSION = ".tzst";
+constexpr std::string_view ZIP_EXTENSION = ".zip";
+
+// TAR
+// ===================================================================================================================
+constexpr size_t TAR_BLOCK_SIZE = 512;
+constexpr size_t TAR_NAME_OFFSET = 0;
+constexpr size_t TAR_NAME_SIZE = 100;
+constexpr size_t TAR_SIZE_OFFSET = 124;
+constexpr size_t TAR_SIZE_SIZE = 12;
+constexpr size_t TAR_CHECKSUM_OFFSET = 148;
+constexpr size_t TAR_CHECKSUM_SIZE = 8;
+constexpr size_t TAR_TYPE_OFFSET = 156;
+constexpr size_t TAR_MAGIC_OFFSET = 257;
+constexpr size_t TAR_PREFIX_OFFSET = 345;
+constexpr size_t TAR_PREFIX_SIZE = 155;
+constexpr char TAR_USTAR_MAGIC[] = "ustar";
+// the archive ends with (at least) two blocks of zeros
+constexpr int TAR_END_ZERO_BLOCKS = 2;
+// set in the first byte of a numeric field that is stored in base 256 rather than octal
+constexpr unsigned char TAR_BASE256_FLAG = 0x80;
+
+constexpr char TAR_TYPE_REGULAR = '0';
+constexpr char TAR_TYPE_REGULAR_OLD = '\0';
+constexpr char TAR_TYPE_CONTIGUOUS = '7';
+constexpr char TAR_TYPE_GNU_LONG_NAME = 'L';
+constexpr char TAR_TYPE_PAX = 'x';
+// a long name or pax header bigger than this is treated as corruption rather than buffered
+constexpr size_t TAR_MAX_EXTENDED_HEADER_SIZE = 1 << 20;
+constexpr char PAX_PATH_KEY[] = "path";
+
+/**
+ * @brief Parses a NUL- or space-terminated octal field, or a base-256 field (used for sizes of 8 GB
+ *        and more).
+ */
+static uint64_t parse_tar_number(const unsigned char * field, size_t size)
+{
+    uint64_t value = 0;
+    if (field[0] & TAR_BASE256_FLAG) {
+        value = field[0] & ~TAR_BASE256_FLAG;
+        for (size_t i = 1; i < size; i++) { value = (value << 8) | field[i]; }
+        return value;
+    }
+    size_t i = 0;
+    while (i < size && field[i] == ' ') { i++; }
+    for (; i < size && field[i] >= '0' && field[i] <= '7'; i++) { value = (value << 3) | (field[i] - '0'); }
+    return value;
+}
+
+/**
+ * @brief Copies a fixed-size string field, which is only NUL-terminated if it is shorter than the field.
+ */
+static std::string tar_string(const unsigned char * field, size_t size)
+{
+    const char * start = reinterpret_cast<const char *>(field);
+    return std::string(start, strnlen(start, size));
+}
+
+/**
+ * @brief Drops the "./" and "/" that archivers put in front of member names.
+ */
+static std::string normalize_member_name(std::string name)
+{
+    size_t start = 0;
+    while (true) {
+        if (name.compare(start, 2, "./") == 0) {
+            start += 2;
+        } else if (name.compare(start, 1, "/") == 0) {
+            start += 1;
+        } else {
+            break;
+        }
+    }
+    return name.substr(start);
+}
+
+/**
+ * @brief Parses a tar stream pushed to it block by block, in whatever sizes the blocks come in.
+ *        Understands ustar prefixes, GNU long names and pax path records.
+ */
+class TarParser {
+public:
+    explicit TarParser(ArchiveVisitor & visitor) : visitor(visitor) {}
+
+    bool feed(const unsigned char * data, size_t size);
+    bool close();
+
+private:
+    enum class MemberKind { SKIPPED, REGULAR, LONG_NAME, PAX };
+
+    bool parse_header();
+    void end_member();
+    std::string pax_path() const;
+
+    ArchiveVisitor & visitor;
+    unsigned char header[TAR_BLOCK_SIZE];
+    size_t header_fill = 0;
+    uint64_t member_remaining = 0;
+    uint64_t padding_remaining = 0;
+    MemberKind member_kind = MemberKind::SKIPPED;
+    bool wants_data = false;
+    bool in_member = false;
+    std::string extended_header;
+    std::string next_name; // set by a long name or pax header, for the member that follows
+    int zero_blocks = 0;
+    bool ended = false;
+    bool corrupt = false;
+};
+
+/**
+ * @brief Feeds the next piece of the tar stream.
+ * @return False once the end of the archive (or corruption) has been seen, so the rest can be skipped.
+ */
+bool TarParser::feed(const unsigned char * data, size_t size)
+{
+    while (size > 0 && ! ended && ! corrupt) {
+        if (member_remaining > 0) {
+            size_t n = std::min<uint64_t>(size, member_remaining);
+            if (member_kind == MemberKind::REGULAR && wants_data) {
+                wants_data = visitor.member_data(data, n);
+            } else if (member_kind == MemberKind::LONG_NAME || member_kind == MemberKind::PAX) {
+                extended_header.append(reinterpret_cast<const char *>(data), n);
+            }
+            member_remaining -= n;
+            data += n;
+            size -= n;
+            if (member_remaining == 0) { end_member(); }
+        } else if (padding_remaining > 0) {
+            size_t n = std::min<uint64_t>(size, padding_remaining);
+            padding_remaining -= n;
+            data += n;
+            size -= n;
+        } else {
+            size_t n = std::min(size, TAR_BLOCK_SIZE - header_fill);
+            memcpy(header + header_fill, data, n);
+            header_fill += n;
+            data += n;
+            size -= n;
+            if (header_fill == TAR_BLOCK_SIZE) {
+                header_fill = 0;
+                corrupt = ! parse_header();
+            }
+        }
+    }
+    return ! ended && ! corrupt;
+}
+
+/**
+ * @brief Ends the stream, closing a member that was cut short.
+ * @return True if the stream was a well-formed tar archive, false otherwise.
+ */
+bool TarParser::close()
+{
+    bool truncated = member_remaining > 0 || header_fill > 0;
+    if (in_member) { end_member(); }
+    return ! corrupt && ! truncated;
+}
+
+bool TarParser::parse_header()
+{
+    if (std::all_of(header, header + TAR_BLOCK_SIZE, [](unsigned char c) { return c == 0; })) {
+        ended = ++zero_blocks == TAR_END_ZERO_BLOCKS;
+        return true;
+    }
+    zero_blocks = 0;
+
+    // the checksum is the sum of the header bytes, counting the checksum field itself as spaces
+    uint64_t checksum = 0;
+    for (size_t i = 0; i < TAR_BLOCK_SIZE; i++) {
+        bool in_checksum = i >= TAR_CHECKSUM_OFFSET && i < TAR_CHECKSUM_OFFSET + TAR_CHECKSUM_SIZE;
+        checksum += in_checksum ? ' ' : header[i];
+    }
+    if (checksum != parse_tar_number(header + TAR_CHECKSUM_OFFSET, TAR_CHECKSUM_SIZE)) { return false; }
+
+    uint64_t size = parse_tar_number(header + TAR_SIZE_OFFSET, TAR_SIZE_SIZE);
+    char type = header[TAR_TYPE_OFFSET];
+    member_remaining = size;
+    padding_remaining = (TAR_BLOCK_SIZE - size % TAR_BLOCK_SIZE) % TAR_BLOCK_SIZE;
+    wants_data = false;
+
+    if (type == TAR_TYPE_GNU_LONG_NAME || type == TAR_TYPE_PAX) {
+        if (size > TAR_MAX_EXTENDED_HEADER_SIZE) { return false; }
+        member_kind = type == TAR_TYPE_PAX ? MemberKind::PAX : MemberKind::LONG_NAME;
+        extended_header.clear();
+    } else {
+        std::string name = next_name;
+        next_name.clear();
+        if (name.empty()) {
+            name = tar_string(header + TAR_NAME_OFFSET, TAR_NAME_SIZE);
+            if (memcmp(header + TAR_MAGIC_OFFSET, TAR_USTAR_MAGIC, sizeof(TAR_USTAR_MAGIC) - 1) == 0) {
+                std::string prefix = tar_string(header + TAR_PREFIX_OFFSET, TAR_PREFIX_SIZE);
+                if (! prefix.empty()) { name = prefix + '/' + name; }
+            }
+        }
+
+        bool regular = type == TAR_TYPE_REGULAR || type == TAR_TYPE_REGULAR_OLD || type == TAR_TYPE_CONTIGUOUS;
+        member_kind = regular ? MemberKind::REGULAR : MemberKind::SKIPPED;
+        if (regular) {
+            in_member = true;
+            wants_data = visitor.begin_member(normalize_member_name(name), size);
+        }
+    }
+
+    if (member_remaining == 0) { end_member(); }
+    return true;
+}
+
+void TarParser::end_member()
+{
+    if (member_kind == MemberKind::REGULAR) {
+        in_member = false;
+        visitor.end_member();
+    } else if (member_kind == MemberKind::LONG_NAME) {
+        next_name = extended_header.c_str();
+    } else if (member_kind == MemberKind::PAX) {
+        next_name = pax_path();
+    }
+    member_kind = MemberKind::SKIPPED;
+}
+
+/**
+ * @brief Finds the path record in a pax header, made of records like "30 path=some/long/name\n".
+ * @return The path, or an empty string if the header doesn't override it.
+ */
+std::string TarParser::pax_path() const
+{
+    size_t offset = 0;
+    while (offset < extended_header.size()) {
+        size_t space = extended_header.find(' ', offset);
+        if (space == std::string::npos) { break; }
+        size_t length = strtoul(extended_header.c_str() + offset, nullptr, 10);
+        if (length == 0 || offset + length > extended_header.size()) { break; }
+
+        std::string record = extended_header.substr(space + 1, offset + length - space - 2);
+        size_t equals = record.find('=');
+        if (equals != std::string::npos && record.compare(0, equals, PAX_PATH_KEY) == 0) {
+            return record.substr(equals + 1);
+        }
+        offset += length;
+    }
+    return "";
+}
+
+/**
+ * @brief Streams the members of a (possibly compressed) tar archive.
+ */
+static bool stream_tar(FILE * file, Compression compression, ArchiveVisitor & visitor)
+{
+    TarParser parser(visitor);
+    bool ok = stream_blocks(file, compression, [&](const unsigned char * data, size_t size) {
+        return parser.feed(data, size);
+    });
+    if (! parser.close() && ok) {
+        errno = EBADMSG;
+        ok = false;
+    }
+    return ok;
+}
+
+// ZIP
+// ===================================================================================================================
+constexpr uint32_t ZIP_LOCAL_HEADER_SIGNATURE = 0x04034b50;
+constexpr uint32_t ZIP_CENTRAL_HEADER_SIGNATURE = 0x02014b50;
+constexpr uint32_t ZIP_END_SIGNATURE = 0x06054b50;
+constexpr uint32_t ZIP64_END_SIGNATURE = 0x06064b50;
+constexpr uint32_t ZIP64_LOCATOR_SIGNATURE = 0x07064b50;
+
+constexpr size_t ZIP_END_SIZE = 22;
+constexpr size_t ZIP_MAX_COMMENT_SIZE = 0xFFFF;
+constexpr size_t ZIP64_LOCATOR_SIZE = 20;
+constexpr size_t ZIP64_END_SIZE = 56;
+constexpr size_t ZIP_LOCAL_HEADER_SIZE = 30;
+constexpr size_t ZIP_CENTRAL_HEADER_SIZE = 46;
+
+constexpr uint16_t ZIP_FLAG_ENCRYPTED = 0x0001;
+constexpr uint16_t ZIP_METHOD_STORED = 0;
+constexpr uint16_t ZIP_METHOD_DEFLATED = 8;
+constexpr uint16_t ZIP64_EXTRA_ID = 0x0001;
+// a 16- or 32-bit field holding this value has its real value in the zip64 records
+constexpr uint16_t ZIP_MAX_16 = 0xFFFF;
+constexpr uint32_t ZIP_MAX_32 = 0xFFFFFFFF;
+
+static uint16_t read_le16(const unsigned char * p) { return p[0] | (p[1] << 8); }
+static uint32_t read_le32(const unsigned char * p) { return p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t(p[3]) << 24); }
+static uint64_t read_le64(const unsigned char * p) { return read_le32(p) | (uint64_t(read_le32(p + 4)) << 32); }
+
+struct ZipEntry {
+    std::string name;
+    uint16_t flags, method;
+    uint64_t compressed_size, size, local_header_offset;
+};
+
+/**
+ * @brief Reads exactly `size` bytes at an offset.
+ * @return True on success, false with errno set (EBADMSG if the file is too short).
+ */
+static bool read_at(FILE * file, uint64_t offset, unsigned char * buffer, size_t size)
+{
+    if (fseeko(file, offset, SEEK_SET) != 0) { return false; }
+    if (fread(buffer, 1, size, file) != size) {
+        if (! ferror(file)) { errno = EBADMSG; }
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Finds the central directory through the end of central directory record (and its zip64
+ *        counterpart for archives over 4 GB or 65535 entries), and reads all of its entries.
+ */
+static bool read_zip_entries(FILE * file, std::vector<ZipEntry> & entries)
+{
+    if (fseeko(file, 0, SEEK_END) != 0) { return false; }
+    uint64_t file_size = ftello(file);
+
+    // the end record sits at the very end, possibly followed by a comment of up to 64 KB
+    size_t tail_size = std::min<uint64_t>(file_size, ZIP_END_SIZE + ZIP_MAX_COMMENT_SIZE);
+    std::vector<unsigned char> tail(tail_size);
+    if (tail_size < ZIP_END_SIZE || ! read_at(file, file_size - tail_size, tail.data(), tail_size)) {
+        errno = EBADMSG;
+        return false;
+    }
+    size_t end = tail_size - ZIP_END_SIZE + 1;
+    do {
+        end--;
+    } while (end > 0 && read_le32(&tail[end]) != ZIP_END_SIGNATURE);
+    if (read_le32(&tail[end]) != ZIP_END_SIGNATURE) {
+        errno = EBADMSG;
+        return false;
+    }
+
+    uint64_t n_entries = read_le16(&tail[end + 10]);
+    uint64_t directory_size = read_le32(&tail[end + 12]);
+    uint64_t directory_offset = read_le32(&tail[end + 16]);
+    uint64_t end_offset = file_size - tail_size + end;
+    if ((n_entries == ZIP_MAX_16 || directory_size == ZIP_MAX_32 || directory_offset == ZIP_MAX_32) &&
+        end_offset >= ZIP64_LOCATOR_SIZE) {
+        unsigned char locator[ZIP64_LOCATOR_SIZE];
+        unsigned char zip64_end[ZIP64_END_SIZE];
+        if (read_at(file, end_offset - ZIP64_LOCATOR_SIZE, locator, sizeof(locator)) &&
+            read_le32(locator) == ZIP64_LOCATOR_SIGNATURE &&
+            read_at(file, read_le64(locator + 8), zip64_end, sizeof(zip64_end)) &&
+            read_le32(zip64_end) == ZIP64_END_SIGNATURE) {
+            n_entries = read_le64(zip64_end + 32);
+            directory_size = read_le64(zip64_end + 40);
+            directory_offset = read_le64(zip64_end + 48);
+        }
+    }
+    if (directory_offset + directory_size > file_size) {
+        errno = EBADMSG;
+        return false;
+    }
+
+    std::vector<unsigned char> directory(directory_size);
+    if (! read_at(file, directory_offset, directory.data(), directory_size)) { return false; }
+
+    size_t offset = 0;
+    for (uint64_t i = 0; i < n_entries; i++) {
+        if (offset + ZIP_CENTRAL_HEADER_SIZE > directory_size || read_le32(&directory[offset]) != ZIP_CENTRAL_HEADER_SIGNATURE) {
+            errno = EBADMSG;
+            return false;
+        }
+        const unsigned char * header = &directory[offset];
+        size_t name_size = read_le16(header + 28);
+        size_t extra_size = read_le16(header + 30);
+        size_t comment_size = read_le16(header + 32);
+        if (offset + ZIP_CENTRAL_HEADER_SIZE + name_size + extra_size > directory_size) {
+            errno = EBADMSG;
+            return false;
+        }
+
+        ZipEntry entry;
+        entry.flags = read_le16(header + 8);
+        entry.method = read_le16(header + 10);
+        entry.compressed_size = read_le32(header + 20);
+        entry.size = read_le32(header + 24);
+        entry.local_header_offset = read_le32(header + 42);
+        entry.name.assign(reinterpret_cast<const char *>(header + ZIP_CENTRAL_HEADER_SIZE), name_size);
+
+        // fields that overflowed 32 bits are listed, in this order, in the zip64 extra field
+        const unsigned char * extra = header + ZIP_CENTRAL_HEADER_SIZE + name_size;
+        for (size_t e = 0; e + 4 <= extra_size;) {
+            uint16_t id = read_le16(extra + e);
+            size_t size = read_le16(extra + e + 2);
+            if (id == ZIP64_EXTRA_ID) {
+                const unsigned char * value = extra + e + 4;
+                const unsigned char * value_end = std::min(value + size, extra + extra_size);
+                for (uint64_t * field : { &entry.size, &entry.compressed_size, &entry.local_header_offset }) {
+                    if (*field == ZIP_MAX_32 && value + 8 <= value_end) {
+                        *field = read_le64(value);
+                        value += 8;
+                    }
+                }
+            }
+            e += 4 + size;
+        }
+
+        // directories are entries whose names end in a slash
+        if (! entry.name.empty() && entry.name.back() != '/') { entries.push_back(entry); }
+        offset += ZIP_CENTRAL_HEADER_SIZE + name_size + extra_size + comment_size;
+    }
+    return true;
+}
+
+/**
+ * @brief Streams the contents of one zip member (stored or deflated) to the visitor.
+ * @return True if the member was read successfully, false with errno set otherwise.
+ */
+static bool stream_zip_member(FILE * file, const ZipEntry & entry, ArchiveVisitor & visitor)
+{
+    unsigned char local_header[ZIP_LOCAL_HEADER_SIZE];
+    if (! read_at(file, entry.local_header_offset, local_header, sizeof(local_header))) { return false; }
+    if (read_le32(local_header) != ZIP_LOCAL_HEADER_SIGNATURE) {
+        errno = EBADMSG;
+        return false;
+    }
+    // the local header repeats the name, but its extra field may differ from the central one
+    uint64_t data_offset = entry.local_header_offset + ZIP_LOCAL_HEADER_SIZE + read_le16(local_header + 26) +
+                           read_le16(local_header + 28);
+    if (fseeko(file, data_offset, SEEK_SET) != 0) { return false; }
+
+    auto in = std::make_unique<unsigned char[]>(READ_BLOCK_SIZE);
+    uint64_t remaining = entry.compressed_size;
+
+    if (entry.method == ZIP_METHOD_STORED) {
+        while (remaining > 0) {
+            size_t n_read = fread(in.get(), 1, std::min<uint64_t>(remaining, READ_BLOCK_SIZE), file);
+            if (n_read == 0) {
+                if (! ferror(file)) { errno = EBADMSG; }
+                return false;
+            }
+            remaining -= n_read;
+            if (! visitor.member_data(in.get(), n_read)) { break; }
+        }
+        return true;
+    }
+
+#ifdef HAVE_ZLIB
+    auto out = std::make_unique<unsigned char[]>(READ_BLOCK_SIZE);
+    z_stream stream = {};
+    // negative window bits: a raw deflate stream, without a zlib or gzip wrapper
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+        errno = ENOMEM;
+        return false;
+    }
+    bool ok = true;
+    for (int status = Z_OK; ok && status != Z_STREAM_END;) {
+        if (stream.avail_in == 0) {
+            stream.avail_in = fread(in.get(), 1, std::min<uint64_t>(remaining, READ_BLOCK_SIZE), file);
+            stream.next_in = in.get();
+            remaining -= stream.avail_in;
+            if (stream.avail_in == 0) {
+                if (! ferror(file)) { errno = EBADMSG; }
+                ok = false;
+                break;
+            }
+        }
+        stream.next_out = out.get();
+        stream.avail_out = READ_BLOCK_SIZE;
+        status = inflate(&stream, Z_NO_FLUSH);
+        if (status != Z_OK && status != Z_STREAM_END) {
+            errno = EBADMSG;
+            ok = false;
+        } else if (! visitor.member_data(out.get(), READ_BLOCK_SIZE - stream.avail_out)) {
+            break;
+        }
+    }
+    inflateEnd(&stream);
+    return ok;
+#else
+    return true;
+#endif
+}
+
+/**
+ * @brief Streams the members of a zip archive, using the central directory to find them.
+ */
+static bool stream_zip(FILE * file, ArchiveVisitor & visitor)
+{
+    std::vector<ZipEntry> entries;
+    if (! read_zip_entries(file, entries)) { return false; }
+
+    bool ok = true;
+    for (auto & entry : entries) {
+        bool wants_data = visitor.begin_member(normalize_member_name(entry.name), entry.size);
+        // encrypted members and unknown compression methods are counted, but their contents are skipped
+        bool readable = ! (entry.flags & ZIP_FLAG_ENCRYPTED) &&
+                        (entry.method == ZIP_METHOD_STORED || (entry.method == ZIP_METHOD_DEFLATED &&
+                                                               compression_supported(Compression::GZIP)));
+        if (wants_data && readable && ! stream_zip_member(file, entry, visitor)) { ok = false; }
+        visitor.end_member();
+        if (! ok) { break; }
+    }
+    return ok;
+}
+
+// ARCHIVES
+// ===================================================================================================================
+/**
+ * @brief Works out whether a file is an archive from its name.
+ * @param file_name The name (or path) of the file.
+ * @param compression Set to how the archive itself is compressed (e.g. GZIP for .tar.gz).
+ * @return The format of the archive, NONE if the file is not an archive this build can read.
+ */
+ArchiveFormat archive_format_from_name(std::string_view file_name, Compression & compression)
+{
+    compression = compression_from_name(file_name);
+    std::string_view inner_name = strip_compression_extension(file_name, compression);
+    ArchiveFormat format = ArchiveFormat::NONE;
+
+    if (has_extension(inner_name, TAR_EXTENSION)) {
+        format = ArchiveFormat::TAR;
+    } else if (compression == Compression::NONE && has_extension(file_name, TGZ_EXTENSION)) {
+        format = ArchiveFormat::TAR;
+        compression = Compression::GZIP;
+    } else if (compression == Compression::NONE && has_extension(file_name, TZST_EXTENSION)) {
+        format = ArchiveFormat::TAR;
+        compression = Compression::ZSTD;
+    } else if (compression == Compression::NONE && has_extension(file_name, ZIP_EXTENSION)) {
+        format = ArchiveFormat::ZIP;
+    }
+
+    if (! compression_supported(compression)) { return ArchiveFormat::NONE; }
+    return format;
+}
+
+/**
+ * @brief Streams the regular files inside an archive to a visitor, without extracting anything to
+ *        disk.
+ * @param file The archive, opened for reading.
+ * @param format The format of the archive.
+ * @param compression How the archive itself is compressed (tar only).
+ * @param visitor Receives each member and its contents.
+ * @return True if the whole archive was read, false on a read error or a corrupt archive, with errno
+ *         set (EBADMSG for corruption). Members seen before the failure have already been visited.
+ */
+bool stream_archive(FILE * file, ArchiveFormat format, Compression compression, ArchiveVisitor & visitor)
+{
+    switch (format) {
+    case ArchiveFormat::TAR: return stream_tar(file, compression, visitor);
+    case ArchiveFormat::ZIP: return stream_zip(file, visitor);
+    default: return true;
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "decompress.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+enum class ArchiveFormat { NONE, TAR, ZIP };
+
+/**
+ * @brief Receives the regular files found inside an archive, one after another. Directories, links
+ *        and other special members are never reported.
+ */
+class ArchiveVisitor {
+public:
+    virtual ~ArchiveVisitor() = default;
+    // a member starts; returning false skips its contents (end_member() is still called)
+    virtual bool begin_member(const std::string & name, uint64_t size) = 0;
+    // the next block of the member's contents; returning false skips the rest of them
+    virtual bool member_data(const unsigned char * data, size_t size) = 0;
+    virtual void end_member() = 0;
+};
+
+ArchiveFormat archive_format_from_name(std::string_view file_name, Compression & compression);
+bool stream_archive(FILE * file, ArchiveFormat format, Compression compression, ArchiveVisitor & visitor);
@@ -0,0 +1,277 @@
+#include "analyzeDir.h"
+#include "archive.h"
+#include "testing.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+#ifdef HAVE_ZLIB
+    #include <zlib.h>
+#endif
+
+constexpr size_t TAR_BLOCK = 512;
+constexpr int SCAN_TOP_N = 5;
+
+using Member = std::pair<std::string, std::string>; // name, contents
+
+/**
+ * @brief Collects the members of an archive and their contents.
+ */
+class CollectingVisitor : public ArchiveVisitor {
+public:
+    bool begin_member(const std::string & name, uint64_t size) override
+    {
+        members.emplace_back(name, "");
+        announced_sizes.push_back(size);
+        return true;
+    }
+    bool member_data(const unsigned char * data, size_t size) override
+    {
+        members.back().second.append(reinterpret_cast<const char *>(data), size);
+        return true;
+    }
+    void end_member() override { n_ended++; }
+
+    std::vector<Member> members;
+    std::vector<uint64_t> announced_sizes;
+    size_t n_ended = 0;
+};
+
+static FILE * temporary_file(const std::string & contents)
+{
+    FILE * file = tmpfile();
+    CHECK(file != nullptr);
+    fwrite(contents.data(), 1, contents.size(), file);
+    rewind(file);
+    return file;
+}
+
+static bool stream_bytes(const std::string & archive, ArchiveFormat format, CollectingVisitor & visitor)
+{
+    FILE * file = temporary_file(archive);
+    errno = 0;
+    bool ok = stream_archive(file, format, Compression::NONE, visitor);
+    int saved_errno = errno;
+    fclose(file);
+    errno = saved_errno;
+    return ok;
+}
+
+// TAR
+// ===================================================================================================================
+static void put_octal(std::string & header, size_t offset, size_t width, uint64_t value)
+{
+    snprintf(&header[offset], width + 1, "%0*llo", static_cast<int>(width - 1), static_cast<unsigned long long>(value));
+}
+
+/**
+ * @brief Makes a tar member: a ustar header (with a prefix, if given), the contents and the padding
+ *        up to the next block.
+ */
+static std::string tar_member(const std::string & name, const std::string & contents, char type = '0', const std::string & prefix = "")
+{
+    std::string header(TAR_BLOCK, '\0');
+    name.copy(&header[0], 100);
+    put_octal(header, 100, 8, 0644);
+    put_octal(header, 124, 12, contents.size());
+    put_octal(header, 136, 12, 0);
+    header[156] = type;
+    std::string("ustar\0" "00", 8).copy(&header[257], 8);
+    prefix.copy(&header[345], 155);
+    std::fill(header.begin() + 148, header.begin() + 156, ' ');
+    unsigned checksum = 0;
+    for (unsigned char c : header) { checksum += c; }
+    snprintf(&header[148], 8, "%06o", checksum);
+    std::string padding((TAR_BLOCK - contents.size() % TAR_BLOCK) % TAR_BLOCK, '\0');
+    return header + contents + padding;
+}
+
+/**
+ * @brief Makes a pax extended header giving the next member a path too long for the ustar fields.
+ */
+static std::string pax_path_member(const std::string & path)
+{
+    // each record starts with its own length, digits included
+    std::string record = " path=" + path + "\n";
+    size_t length = record.size() + 1;
+    while (std::to_string(length).size() + record.size() != length) { length++; }
+    return tar_member("PaxHeaders/long", std::to_string(length) + record, 'x');
+}
+
+static const std::string TAR_END(2 * TAR_BLOCK, '\0');
+
+TEST_CASE(archive_tar_ustar_and_pax_names)
+{
+    std::string long_directory(150, 'd');
+    std::string pax_path = "deep/" + std::string(200, 'p') + "/notes.txt";
+    std::string big_contents(3 * TAR_BLOCK + 7, 'b');
+    std::string archive = tar_member("./plain.txt", "plain words\n") + tar_member("sub/", "", '5')
+        + tar_member("split.txt", "split words\n", '0', long_directory) + pax_path_member(pax_path)
+        + tar_member("truncated-name", "pax words\n") + tar_member("link.txt", "", '2') + tar_member("big.bin", big_contents)
+        + tar_member("empty.txt", "") + TAR_END;
+
+    CollectingVisitor visitor;
+    CHECK(stream_bytes(archive, ArchiveFormat::TAR, visitor));
+    // directories and links are left out, and the leading "./" is dropped
+    std::vector<Member> expected = { { "plain.txt", "plain words\n" },
+                                     { long_directory + "/split.txt", "split words\n" },
+                                     { pax_path, "pax words\n" },
+                                     { "big.bin", big_contents },
+                                     { "empty.txt", "" } };
+    CHECK(visitor.members == expected);
+    CHECK(visitor.n_ended == expected.size());
+    CHECK((visitor.announced_sizes == std::vector<uint64_t>{ 12, 12, 10, big_contents.size(), 0 }));
+}
+
+TEST_CASE(archive_tar_truncated_or_damaged)
+{
+    std::string archive = tar_member("first.txt", "first words\n") + tar_member("second.txt", std::string(2 * TAR_BLOCK, 's')) + TAR_END;
+
+    // cut inside the second member: the first is still visited, and the second is ended
+    CollectingVisitor cut_visitor;
+    CHECK(! stream_bytes(archive.substr(0, 3 * TAR_BLOCK + 100), ArchiveFormat::TAR, cut_visitor));
+    CHECK(errno == EBADMSG);
+    CHECK(cut_visitor.members.size() == 2 && cut_visitor.members[0].first == "first.txt");
+    CHECK(cut_visitor.n_ended == 2);
+
+    std::string bad_checksum = archive;
+    bad_checksum[0] = 'F';
+    CollectingVisitor checksum_visitor;
+    CHECK(! stream_bytes(bad_checksum, ArchiveFormat::TAR, checksum_visitor));
+    CHECK(errno == EBADMSG);
+    CHECK(checksum_visitor.members.empty());
+}
+
+// ZIP
+// ===================================================================================================================
+static std::string le16(uint32_t value) { return { static_cast<char>(value & 0xFF), static_cast<char>((value >> 8) & 0xFF) }; }
+static std::string le32(uint32_t value) { return le16(value & 0xFFFF) + le16(value >> 16); }
+static std::string le64(uint64_t value) { return le32(value & 0xFFFFFFFF) + le32(value >> 32); }
+
+struct ZipMember {
+    std::string name;
+    std::string contents;
+    bool deflated;
+};
+
+#ifdef HAVE_ZLIB
+static std::string raw_deflate(const std::string & text)
+{
+    z_stream stream = {};
+    CHECK(deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+    std::string compressed(deflateBound(&stream, text.size()), '\0');
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(text.data()));
+    stream.avail_in = text.size();
+    stream.next_out = reinterpret_cast<Bytef *>(&compressed[0]);
+    stream.avail_out = compressed.size();
+    CHECK(deflate(&stream, Z_FINISH) == Z_STREAM_END);
+    compressed.resize(stream.total_out);
+    deflateEnd(&stream);
+    return compressed;
+}
+#endif
+
+/**
+ * @brief Makes a zip archive. With `zip64`, the sizes and offsets in the central directory and the
+ *        end record are all moved to zip64 records, as archivers do past 4 GB or 65535 entries.
+ *        CRCs are left at 0, since the reader doesn't check them.
+ */
+static std::string zip_archive(const std::vector<ZipMember> & members, bool zip64)
+{
+    std::string archive, directory;
+    for (const ZipMember & member : members) {
+        std::string data = member.contents;
+#ifdef HAVE_ZLIB
+        if (member.deflated) { data = raw_deflate(member.contents); }
+#endif
+        uint16_t method = member.deflated ? 8 : 0;
+        uint64_t offset = archive.size();
+        archive += le32(0x04034b50) + le16(20) + le16(0) + le16(method) + le32(0) + le32(0) + le32(data.size())
+            + le32(member.contents.size()) + le16(member.name.size()) + le16(0) + member.name + data;
+
+        std::string extra = zip64 ? le16(0x0001) + le16(24) + le64(member.contents.size()) + le64(data.size()) + le64(offset) : "";
+        uint32_t max32 = 0xFFFFFFFF;
+        directory += le32(0x02014b50) + le16(45) + le16(45) + le16(0) + le16(method) + le32(0) + le32(0)
+            + le32(zip64 ? max32 : data.size()) + le32(zip64 ? max32 : member.contents.size()) + le16(member.name.size())
+            + le16(extra.size()) + le16(0) + le16(0) + le16(0) + le32(0) + le32(zip64 ? max32 : offset) + member.name + extra;
+    }
+    uint64_t directory_offset = archive.size();
+    archive += directory;
+    if (zip64) {
+        uint64_t zip64_end_offset = archive.size();
+        archive += le32(0x06064b50) + le64(44) + le16(45) + le16(45) + le32(0) + le32(0) + le64(members.size())
+            + le64(members.size()) + le64(directory.size()) + le64(directory_offset);
+        archive += le32(0x07064b50) + le32(0) + le64(zip64_end_offset) + le32(1);
+        return archive + le32(0x06054b50) + le16(0) + le16(0) + le16(0xFFFF) + le16(0xFFFF) + le32(0xFFFFFFFF)
+            + le32(0xFFFFFFFF) + le16(0);
+    }
+    return archive + le32(0x06054b50) + le16(0) + le16(0) + le16(members.size()) + le16(members.size())
+        + le32(directory.size()) + le32(directory_offset) + le16(0);
+}
+
+TEST_CASE(archive_zip_stored_deflated_and_zip64)
+{
+    std::string long_text;
+    for (int i = 0; i < 20000; i++) { long_text += "deflated words repeat " + std::to_string(i % 97) + "\n"; }
+    std::vector<ZipMember> members = { { "stored.txt", "stored words\n", false }, { "dir/", "", false }, { "./dir/empty.txt", "", false } };
+#ifdef HAVE_ZLIB
+    members.push_back({ "dir/deflated.txt", long_text, true });
+#endif
+
+    for (bool zip64 : { false, true }) {
+        CollectingVisitor visitor;
+        CHECK(stream_bytes(zip_archive(members, zip64), ArchiveFormat::ZIP, visitor));
+        std::vector<Member> expected = { { "stored.txt", "stored words\n" }, { "dir/empty.txt", "" } };
+#ifdef HAVE_ZLIB
+        expected.emplace_back("dir/deflated.txt", long_text);
+#endif
+        CHECK(visitor.members == expected);
+        CHECK(visitor.n_ended == expected.size());
+        CHECK(visitor.announced_sizes.size() == expected.size() && visitor.announced_sizes.back() == expected.back().second.size());
+    }
+
+    // cut before the end record, nothing can be found
+    std::string archive = zip_archive(members, false);
+    CollectingVisitor cut_visitor;
+    CHECK(! stream_bytes(archive.substr(0, archive.size() - 30), ArchiveFormat::ZIP, cut_visitor));
+    CHECK(errno == EBADMSG);
+    CHECK(cut_visitor.members.empty());
+}
+
+TEST_CASE(archive_failures_are_scan_errors)
+{
+    char directory[] = "/tmp/archiveTestXXXXXX";
+    CHECK(mkdtemp(directory) != nullptr);
+    std::string base = directory;
+    std::string tar = tar_member("inside.txt", "archived archived words\n") + TAR_END;
+    std::string zip = zip_archive({ { "zipped.txt", "zipped words\n", false } }, false);
+    std::ofstream(base + "/good.tar", std::ios::binary) << tar;
+    std::ofstream(base + "/cut.tar", std::ios::binary) << tar.substr(0, TAR_BLOCK / 2);
+    std::ofstream(base + "/cut.zip", std::ios::binary) << zip.substr(0, zip.size() / 2);
+
+    run_in_child_process([&] {
+        CHECK(chdir(directory) == 0);
+        AnalyzeOptions options;
+        options.scan_archives = true;
+        Results results = analyzeDir(SCAN_TOP_N, options);
+        // the damaged archives are skipped and reported, and the good one is read
+        CHECK(results.scan_errors.size() == 1);
+        if (results.scan_errors.size() == 1) {
+            std::vector<std::string> samples = results.scan_errors[0].sample_paths;
+            std::sort(samples.begin(), samples.end());
+            CHECK(results.scan_errors[0].error_code == EBADMSG);
+            CHECK((samples == std::vector<std::string>{ "cut.tar", "cut.zip" }));
+        }
+        CHECK(results.n_archive_members == 1);
+        CHECK(! results.most_common_words.empty() && results.most_common_words[0] == std::make_pair(std::string("archived"), 2));
+    });
+    for (const char * name : { "/good.tar", "/cut.tar", "/cut.zip" }) { unlink((base + name).c_str()); }
+    rmdir(directory);
+}
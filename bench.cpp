@@ -0,0 +1,454 @@
+#include "analyzeDir.h"
+#include "cpuTopology.h"
+#include "parking.h"
+#include "workQueue.h"
+#include "workerPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ftw.h>
+#include <random>
+#include <string>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+constexpr long DEFAULT_ITERATIONS = 1000000;
+constexpr size_t BENCH_RING_CAPACITY = 1024;
+// each worker's table in the NUMA benchmark, larger than the caches so that its reads go to memory
+constexpr size_t WORKER_TABLE_SIZE = 4 * 1024 * 1024;
+// table entries each task of the NUMA benchmark reads
+constexpr size_t TABLE_READS_PER_TASK = 4096;
+
+// the synthetic trees of the scaling mode: files per thread, split into images and text files
+constexpr long DEFAULT_SCALING_FILES = 4000;
+constexpr int TEXT_FILE_EVERY = 10; // one file in this many is a text file, the others images
+constexpr int FILES_PER_DIRECTORY = 100;
+constexpr int WORDS_PER_TEXT_FILE = 500;
+constexpr int SCALING_TOP_N = 5;
+// efficiency below which scaling is reported as broken down
+constexpr double SCALING_BREAKDOWN_EFFICIENCY = 0.5;
+constexpr int MAX_OPEN_DESCRIPTORS = 64;
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @brief Prints one benchmark's time per operation.
+ * @param name The benchmark.
+ * @param start When it started.
+ * @param n_operations How many operations it did.
+ */
+static void report(const char * name, Clock::time_point start, long n_operations)
+{
+    double nanoseconds = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    printf("%-34s %10.1f ns/op\n", name, nanoseconds / n_operations);
+}
+
+/**
+ * @brief Pushes and pops a ring from one thread, so no operation is ever contended.
+ */
+static void bench_ring_uncontended(long n_iterations)
+{
+    MpmcRing<long> ring(BENCH_RING_CAPACITY);
+    Clock::time_point start = Clock::now();
+    for (long i = 0; i < n_iterations; i++) {
+        ring.try_push(i);
+        ring.try_pop();
+    }
+    report("ring push+pop, 1 thread", start, n_iterations);
+}
+
+/**
+ * @brief Moves elements through a ring from producer threads to as many consumer threads, and checks
+ *        that every element comes out exactly once.
+ */
+static void bench_ring_contended(long n_iterations, int n_pairs)
+{
+    MpmcRing<long> ring(BENCH_RING_CAPACITY);
+    std::atomic<long> sum { 0 };
+    std::atomic<long> n_consumed { 0 };
+    long per_producer = n_iterations / n_pairs;
+    long n_total = per_producer * n_pairs;
+
+    Clock::time_point start = Clock::now();
+    std::vector<std::thread> threads;
+    for (int p = 0; p < n_pairs; p++) {
+        threads.emplace_back([&ring, per_producer] {
+            for (long i = 1; i <= per_producer; i++) {
+                long value = i;
+                while (! ring.try_push(value)) { std::this_thread::yield(); }
+            }
+        });
+        threads.emplace_back([&] {
+            long local_sum = 0;
+            while (n_consumed.load(std::memory_order_relaxed) < n_total) {
+                if (auto value = ring.try_pop()) {
+                    local_sum += *value;
+                    n_consumed.fetch_add(1, std::memory_order_relaxed);
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+            sum.fetch_add(local_sum);
+        });
+    }
+    for (auto & thread : threads) { thread.join(); }
+
+    std::string name = "ring transfer, " + std::to_string(n_pairs) + "+" + std::to_string(n_pairs) + " threads";
+    report(name.c_str(), start, n_total);
+    if (sum.load() != n_pairs * (per_producer * (per_producer + 1) / 2)) { fprintf(stderr, "ring: elements lost or duplicated\n"); }
+}
+
+/**
+ * @brief Pushes and pops a deque from its owner while other threads steal from it, and checks that
+ *        every task is taken exactly once.
+ */
+static void bench_deque(long n_iterations, int n_thieves)
+{
+    ChaseLevDeque<long> deque;
+    std::atomic<bool> done { false };
+    std::atomic<long> sum { 0 };
+
+    Clock::time_point start = Clock::now();
+    std::vector<std::thread> thieves;
+    for (int t = 0; t < n_thieves; t++) {
+        thieves.emplace_back([&] {
+            long local_sum = 0;
+            while (! done.load(std::memory_order_acquire) || ! deque.empty()) {
+                if (auto value = deque.steal()) { local_sum += *value; }
+            }
+            sum.fetch_add(local_sum);
+        });
+    }
+    long owner_sum = 0;
+    for (long i = 1; i <= n_iterations; i++) {
+        deque.push(i);
+        // pops one task for every two pushed, so the deque keeps growing for the thieves
+        if (i % 2 == 0) {
+            if (auto value = deque.pop()) { owner_sum += *value; }
+        }
+    }
+    while (auto value = deque.pop()) { owner_sum += *value; }
+    done.store(true, std::memory_order_release);
+    for (auto & thief : thieves) { thief.join(); }
+
+    std::string name = "deque push/pop, " + std::to_string(n_thieves) + " thieves";
+    report(name.c_str(), start, n_iterations);
+    if (owner_sum + sum.load() != n_iterations * (n_iterations + 1) / 2) { fprintf(stderr, "deque: tasks lost or duplicated\n"); }
+}
+
+/**
+ * @brief Bounces a token between two threads that park whenever it isn't their turn, so that each
+ *        round trip is two wakeups.
+ */
+static void bench_park(long n_iterations)
+{
+    IdleWorkers idle;
+    std::atomic<long> turn { 0 };
+    auto play = [&](long parity) {
+        for (long i = parity; i < 2 * n_iterations; i += 2) {
+            while (turn.load(std::memory_order_acquire) != i) {
+                uint32_t key = idle.prepare_wait();
+                if (turn.load(std::memory_order_acquire) == i) {
+                    idle.cancel_wait();
+                    break;
+                }
+                idle.wait(key);
+            }
+            turn.store(i + 1, std::memory_order_release);
+            idle.notify_all();
+        }
+    };
+
+    Clock::time_point start = Clock::now();
+    std::thread other(play, 1);
+    play(0);
+    other.join();
+    report("park/unpark round trip", start, n_iterations);
+}
+
+/**
+ * @brief Runs tiny tasks through a worker pool, half of them submitted by other tasks.
+ */
+static void bench_pool(long n_iterations, int n_threads)
+{
+    std::atomic<long> n_run { 0 };
+    Clock::time_point start = Clock::now();
+    {
+        WorkerPool pool(n_threads);
+        for (long i = 0; i < n_iterations / 2; i++) {
+            pool.submit([&pool, &n_run] {
+                n_run.fetch_add(1, std::memory_order_relaxed);
+                pool.submit([&n_run] { n_run.fetch_add(1, std::memory_order_relaxed); });
+            });
+        }
+        pool.wait();
+    }
+    std::string name = "pool task, " + std::to_string(n_threads) + " workers";
+    report(name.c_str(), start, n_iterations);
+    if (n_run.load() != n_iterations / 2 * 2) { fprintf(stderr, "pool: tasks lost or duplicated\n"); }
+}
+
+/**
+ * @brief Runs memory-bound tasks on pinned workers using the CPUs of the first 1, 2, ... NUMA nodes,
+ *        each worker reading its own table allocated on its node, and reports how well the
+ *        throughput scales with the number of nodes (1.00 = perfectly, per CPU added).
+ */
+static void bench_numa_scaling(long n_iterations)
+{
+    CpuTopology topology = CpuTopology::detect();
+    long n_tasks = std::max(1L, n_iterations / 100);
+    double base_throughput_per_cpu = 0;
+
+    for (size_t n_nodes = 1; n_nodes <= topology.nodes.size(); n_nodes++) {
+        CpuTopology used;
+        used.nodes.assign(topology.nodes.begin(), topology.nodes.begin() + n_nodes);
+        used.node_cpus.assign(topology.node_cpus.begin(), topology.node_cpus.begin() + n_nodes);
+        int n_workers = used.n_cpus();
+        std::vector<WorkerPlacement> placements = spread_workers(used, n_workers);
+        std::vector<std::vector<long>> tables(n_workers);
+        std::atomic<long> checksum { 0 };
+        std::atomic<int> n_ready { 0 };
+
+        Clock::time_point start;
+        {
+            WorkerPool pool(n_workers, [&](int worker) {
+                pin_current_thread(placements[worker].cpu);
+                bind_current_thread_memory(placements[worker].node);
+                // first touched by the pinned worker, so it lands on the worker's node
+                tables[worker].assign(WORKER_TABLE_SIZE / sizeof(long), worker);
+                n_ready.fetch_add(1, std::memory_order_release);
+            });
+            while (n_ready.load(std::memory_order_acquire) < n_workers) { std::this_thread::yield(); }
+            start = Clock::now();
+            for (long task = 0; task < n_tasks; task++) {
+                pool.submit([&tables, &checksum, task] {
+                    // wait() may run a task on the main thread, which then borrows the first table
+                    const std::vector<long> & table = tables[std::max(WorkerPool::this_worker(), 0)];
+                    long sum = 0;
+                    size_t index = task * TABLE_READS_PER_TASK;
+                    for (size_t i = 0; i < TABLE_READS_PER_TASK; i++) {
+                        // strides over cache lines, so each read is a miss
+                        index = (index + CACHE_LINE_SIZE / sizeof(long) * 97) % table.size();
+                        sum += table[index];
+                    }
+                    checksum.fetch_add(sum, std::memory_order_relaxed);
+                });
+            }
+            pool.wait();
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        double throughput_per_cpu = n_tasks / seconds / n_workers;
+        if (n_nodes == 1) { base_throughput_per_cpu = throughput_per_cpu; }
+        printf("numa: %zu node(s), %3d workers %10.0f tasks/s  efficiency %.2f\n", n_nodes, n_workers,
+               n_tasks / seconds, throughput_per_cpu / base_throughput_per_cpu);
+    }
+}
+
+// the time one scan of a synthetic tree took, and the CPU time its threads used
+struct ScanTiming {
+    double wall_seconds;
+    double cpu_seconds;         // of the whole process
+    double scan_thread_seconds; // of the thread running the traversal, tokenization and merges
+};
+
+/**
+ * @brief Writes a file with the header of a PNG image.
+ */
+static void write_png(const std::string & path, uint32_t width, uint32_t height)
+{
+    unsigned char header[24] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n', 0, 0, 0, 13, 'I', 'H', 'D', 'R' };
+    for (int i = 0; i < 4; i++) {
+        header[16 + i] = width >> (24 - 8 * i);
+        header[20 + i] = height >> (24 - 8 * i);
+    }
+    FILE * file = fopen(path.c_str(), "wb");
+    if (! file) { return; }
+    fwrite(header, 1, sizeof(header), file);
+    fclose(file);
+}
+
+/**
+ * @brief Creates a synthetic tree of images and text files, FILES_PER_DIRECTORY to a directory.
+ * @param root The directory to create it in (which must not exist).
+ * @param n_files The number of files.
+ */
+static void make_tree(const std::string & root, long n_files)
+{
+    static const char * const WORDS[] = { "directory", "analyzer", "benchmark", "scaling", "thread", "worker",
+                                          "image", "header", "stealing", "futex", "memory", "socket" };
+    std::mt19937 random(n_files);
+    mkdir(root.c_str(), 0755);
+    std::string dir;
+    for (long i = 0; i < n_files; i++) {
+        if (i % FILES_PER_DIRECTORY == 0) {
+            dir = root + "/dir" + std::to_string(i / FILES_PER_DIRECTORY);
+            mkdir(dir.c_str(), 0755);
+        }
+        std::string path = dir + "/file" + std::to_string(i);
+        if (i % TEXT_FILE_EVERY == 0) {
+            FILE * file = fopen((path + ".txt").c_str(), "w");
+            if (! file) { continue; }
+            for (int w = 0; w < WORDS_PER_TEXT_FILE; w++) { fprintf(file, "%s ", WORDS[random() % (sizeof(WORDS) / sizeof(*WORDS))]); }
+            fclose(file);
+        } else {
+            write_png(path + ".png", 1 + random() % 4000, 1 + random() % 4000);
+        }
+    }
+}
+
+static int remove_entry(const char * path, const struct stat *, int, struct FTW *)
+{
+    return remove(path);
+}
+
+static double seconds_of(const timeval & time)
+{
+    return time.tv_sec + time.tv_usec / 1e6;
+}
+
+/**
+ * @brief Scans a tree in a child process, so that every scan starts from fresh analyzer state.
+ * @param tree The tree.
+ * @param n_threads The number of image threads (1 = measure images on the scanning thread).
+ * @return The timing, or all zeros if the child failed.
+ */
+static ScanTiming time_scan(const std::string & tree, int n_threads)
+{
+    int pipe_fds[2];
+    if (pipe(pipe_fds) != 0) { return ScanTiming{}; }
+    Clock::time_point start = Clock::now();
+    pid_t child = fork();
+    if (child == 0) {
+        close(pipe_fds[0]);
+        if (chdir(tree.c_str()) != 0) { _exit(EXIT_FAILURE); }
+        AnalyzeOptions options;
+        options.native_images = true;
+        options.use_identify = false;
+        options.image_threads = n_threads;
+        analyzeDir(SCALING_TOP_N, options);
+        rusage usage;
+        getrusage(RUSAGE_THREAD, &usage);
+        double scan_thread_seconds = seconds_of(usage.ru_utime) + seconds_of(usage.ru_stime);
+        _exit(write(pipe_fds[1], &scan_thread_seconds, sizeof(scan_thread_seconds)) == sizeof(scan_thread_seconds) ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+    close(pipe_fds[1]);
+    ScanTiming timing {};
+    if (child > 0 && read(pipe_fds[0], &timing.scan_thread_seconds, sizeof(timing.scan_thread_seconds)) == sizeof(timing.scan_thread_seconds)) {
+        int status;
+        rusage usage;
+        wait4(child, &status, 0, &usage);
+        timing.wall_seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        timing.cpu_seconds = seconds_of(usage.ru_utime) + seconds_of(usage.ru_stime);
+    } else if (child > 0) {
+        waitpid(child, nullptr, 0);
+    }
+    close(pipe_fds[0]);
+    return timing;
+}
+
+/**
+ * @brief Scans synthetic trees with 1, 2, 4, ... image threads, up to max_threads, and reports the
+ *        speedup, the efficiency, the utilization of the scanning thread (traversal, tokenization and
+ *        merges) and of the image workers, and the thread count from which the efficiency falls
+ *        below SCALING_BREAKDOWN_EFFICIENCY.
+ * @param weak Whether the tree grows with the threads (weak scaling: files_per_thread files per
+ *        thread) instead of staying at files_per_thread * max_threads files (strong scaling).
+ */
+static void bench_scan_scaling(const std::string & work_dir, long files_per_thread, int max_threads, bool weak)
+{
+    printf("%s scaling, %ld files%s\n", weak ? "weak" : "strong", weak ? files_per_thread : files_per_thread * max_threads,
+           weak ? " per thread" : "");
+    printf("%8s %9s %8s %11s %12s %14s\n", "threads", "wall (s)", "speedup", "efficiency", "scan thread", "image workers");
+
+    double base_seconds = 0;
+    int breakdown_threads = 0;
+    std::vector<int> thread_counts;
+    for (int n_threads = 1; n_threads < max_threads; n_threads *= 2) { thread_counts.push_back(n_threads); }
+    thread_counts.push_back(max_threads);
+
+    for (int n_threads : thread_counts) {
+        std::string tree = work_dir + "/" + (weak ? "weak" : "strong") + std::to_string(weak ? n_threads : max_threads);
+        if (weak || n_threads == 1) { make_tree(tree, weak ? files_per_thread * n_threads : files_per_thread * max_threads); }
+        ScanTiming timing = time_scan(tree, n_threads);
+        if (weak || n_threads == max_threads) { nftw(tree.c_str(), remove_entry, MAX_OPEN_DESCRIPTORS, FTW_DEPTH | FTW_PHYS); }
+        if (timing.wall_seconds <= 0) {
+            fprintf(stderr, "scan with %d threads failed\n", n_threads);
+            continue;
+        }
+
+        if (n_threads == 1) { base_seconds = timing.wall_seconds; }
+        // for weak scaling the work grows with the threads, so the speedup is the scaled speedup
+        double efficiency = weak ? base_seconds / timing.wall_seconds : base_seconds / timing.wall_seconds / n_threads;
+        double speedup = weak ? efficiency * n_threads : base_seconds / timing.wall_seconds;
+        double scan_thread_utilization = timing.scan_thread_seconds / timing.wall_seconds;
+        printf("%8d %9.3f %8.2f %11.2f %11.0f%%", n_threads, timing.wall_seconds, speedup, efficiency, 100 * scan_thread_utilization);
+        if (n_threads > 1) {
+            double worker_seconds = std::max(0.0, timing.cpu_seconds - timing.scan_thread_seconds);
+            printf(" %13.0f%%", 100 * worker_seconds / (timing.wall_seconds * n_threads));
+        } else {
+            printf(" %14s", "-");
+        }
+        printf("\n");
+        if (! breakdown_threads && efficiency < SCALING_BREAKDOWN_EFFICIENCY) { breakdown_threads = n_threads; }
+    }
+
+    if (breakdown_threads) {
+        printf("scaling breaks down at %d threads (efficiency below %.2f)\n\n", breakdown_threads, SCALING_BREAKDOWN_EFFICIENCY);
+    } else {
+        printf("no breakdown up to %d threads\n\n", max_threads);
+    }
+}
+
+/**
+ * @brief Runs the thread-scaling report on synthetic trees created in a temporary directory.
+ */
+static int run_scaling(long files_per_thread, int max_threads)
+{
+    char work_dir[] = "/tmp/analyzeDir-bench-XXXXXX";
+    if (! mkdtemp(work_dir)) {
+        perror("mkdtemp");
+        return EXIT_FAILURE;
+    }
+    bench_scan_scaling(work_dir, files_per_thread, max_threads, false);
+    bench_scan_scaling(work_dir, files_per_thread, max_threads, true);
+    rmdir(work_dir);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Runs the microbenchmarks of the concurrency primitives, or with --scaling, the thread-scaling
+ *        report of the scan.
+ *
+ * Usage: bench [iterations]
+ *        bench --scaling [files per thread] [max threads]
+ */
+int main(int argc, char * argv[])
+{
+    if (argc > 1 && strcmp(argv[1], "--scaling") == 0) {
+        long files_per_thread = argc > 2 ? std::atol(argv[2]) : DEFAULT_SCALING_FILES;
+        int max_threads = argc > 3 ? std::atoi(argv[3]) : static_cast<int>(std::thread::hardware_concurrency());
+        return run_scaling(std::max(1L, files_per_thread), std::max(1, max_threads));
+    }
+
+    long n_iterations = argc > 1 ? std::atol(argv[1]) : DEFAULT_ITERATIONS;
+    if (n_iterations < 2) { n_iterations = DEFAULT_ITERATIONS; }
+    int n_cores = std::max(2u, std::thread::hardware_concurrency());
+
+    bench_ring_uncontended(n_iterations);
+    bench_ring_contended(n_iterations, 1);
+    bench_ring_contended(n_iterations, n_cores / 2);
+    bench_deque(n_iterations, 0);
+    bench_deque(n_iterations, n_cores - 1);
+    bench_park(n_iterations / 10);
+    bench_pool(n_iterations, n_cores);
+    bench_numa_scaling(n_iterations);
+    return 0;
+}
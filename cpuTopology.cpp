@@ -0,0 +1,168 @@
+#include "cpuTopology.h"
+
+#include <algorithm>
+#include <cctype>
+#include <dirent.h>
+#include <fstream>
+#ifdef __linux__
+    #include <linux/mempolicy.h>
+    #include <pthread.h>
+    #include <sched.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#else
+    #include <thread>
+#endif
+
+constexpr char NODE_DIRECTORY[] = "/sys/devices/system/node";
+constexpr char NODE_PREFIX[] = "node";
+constexpr int BITS_PER_MASK_WORD = 8 * sizeof(unsigned long);
+
+/**
+ * @brief Parses a list of CPUs in the kernel's format, e.g. "0-3,8,10-11".
+ * @param list The list.
+ * @return The CPUs, in the order listed.
+ */
+std::vector<int> parse_cpu_list(const std::string & list)
+{
+    std::vector<int> cpus;
+    size_t start = 0;
+    while (start < list.size()) {
+        size_t end = list.find(',', start);
+        if (end == std::string::npos) { end = list.size(); }
+        std::string range = list.substr(start, end - start);
+        size_t dash = range.find('-');
+        try {
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int cpu = first; cpu <= last; cpu++) { cpus.push_back(cpu); }
+        } catch (const std::exception &) {
+            // a trailing newline or an empty list
+        }
+        start = end + 1;
+    }
+    return cpus;
+}
+
+/**
+ * @brief Reads the NUMA nodes and the CPUs the process is allowed to run on. Elsewhere than on Linux,
+ *        every CPU is put on node 0.
+ */
+CpuTopology CpuTopology::detect()
+{
+#ifndef __linux__
+    CpuTopology topology;
+    std::vector<int> cpus(std::max(1U, std::thread::hardware_concurrency()));
+    for (size_t cpu = 0; cpu < cpus.size(); cpu++) { cpus[cpu] = cpu; }
+    topology.nodes.push_back(0);
+    topology.node_cpus.push_back(std::move(cpus));
+    return topology;
+#else
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) { CPU_SET(cpu, &allowed); }
+    }
+
+    CpuTopology topology;
+    if (DIR * dir = opendir(NODE_DIRECTORY)) {
+        std::vector<int> node_ids;
+        while (dirent * entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            if (name.rfind(NODE_PREFIX, 0) != 0 || name.size() == sizeof(NODE_PREFIX) - 1) { continue; }
+            if (! std::all_of(name.begin() + sizeof(NODE_PREFIX) - 1, name.end(), ::isdigit)) { continue; }
+            node_ids.push_back(std::stoi(name.substr(sizeof(NODE_PREFIX) - 1)));
+        }
+        closedir(dir);
+        std::sort(node_ids.begin(), node_ids.end());
+
+        for (int node : node_ids) {
+            std::ifstream cpulist(std::string(NODE_DIRECTORY) + "/" + NODE_PREFIX + std::to_string(node) + "/cpulist");
+            std::string list;
+            std::getline(cpulist, list);
+            std::vector<int> cpus;
+            for (int cpu : parse_cpu_list(list)) {
+                if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) { cpus.push_back(cpu); }
+            }
+            if (cpus.empty()) { continue; }
+            topology.nodes.push_back(node);
+            topology.node_cpus.push_back(std::move(cpus));
+        }
+    }
+
+    if (topology.nodes.empty()) {
+        std::vector<int> cpus;
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &allowed)) { cpus.push_back(cpu); }
+        }
+        topology.nodes.push_back(0);
+        topology.node_cpus.push_back(std::move(cpus));
+    }
+    return topology;
+#endif
+}
+
+int CpuTopology::n_cpus() const
+{
+    int n = 0;
+    for (const auto & cpus : node_cpus) { n += static_cast<int>(cpus.size()); }
+    return n;
+}
+
+/**
+ * @brief Spreads workers over the NUMA nodes: worker i goes to node i mod (number of nodes), on the
+ *        next CPU of that node not taken yet, so that every node gets its share of the workers (and
+ *        of the memory bandwidth). With more workers than CPUs, they wrap around.
+ * @param topology The nodes and their CPUs.
+ * @param n_workers The number of workers.
+ * @return Where each worker goes.
+ */
+std::vector<WorkerPlacement> spread_workers(const CpuTopology & topology, int n_workers)
+{
+    std::vector<WorkerPlacement> placements;
+    size_t n_nodes = topology.nodes.size();
+    for (int i = 0; i < n_workers; i++) {
+        size_t node_index = i % n_nodes;
+        const std::vector<int> & cpus = topology.node_cpus[node_index];
+        placements.push_back(WorkerPlacement{ cpus[(i / n_nodes) % cpus.size()], topology.nodes[node_index] });
+    }
+    return placements;
+}
+
+/**
+ * @brief Keeps the calling thread on one CPU.
+ * @param cpu The CPU.
+ * @return False if the kernel refused (e.g. the CPU is outside the process's cpuset), or elsewhere
+ *         than on Linux, where threads are left wherever the scheduler puts them.
+ */
+bool pin_current_thread(int cpu)
+{
+#ifdef __linux__
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+/**
+ * @brief Makes the pages the calling thread touches from now on come from one NUMA node only, instead
+ *        of whichever node the thread happens to run on when it first touches them.
+ * @param node The node.
+ * @return False if the kernel refused (e.g. no NUMA support), or elsewhere than on Linux.
+ */
+bool bind_current_thread_memory(int node)
+{
+#ifdef __linux__
+    std::vector<unsigned long> mask(node / BITS_PER_MASK_WORD + 1, 0);
+    mask[node / BITS_PER_MASK_WORD] |= 1UL << (node % BITS_PER_MASK_WORD);
+    // the policy is per thread; the raw system call avoids depending on libnuma
+    return syscall(SYS_set_mempolicy, MPOL_BIND, mask.data(), mask.size() * BITS_PER_MASK_WORD + 1) == 0;
+#else
+    (void)node;
+    return false;
+#endif
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// where a worker thread runs, and the NUMA node its memory should come from
+struct WorkerPlacement {
+    int cpu;
+    int node;
+};
+
+/**
+ * @brief The CPUs the process may run on, grouped by NUMA node, as read from sysfs.
+ *
+ * Nodes without any usable CPU are left out. Without NUMA information (e.g. a kernel built without
+ * it), all the CPUs are put on a single node 0.
+ */
+struct CpuTopology {
+    std::vector<int> nodes;                  // node IDs, ascending
+    std::vector<std::vector<int>> node_cpus; // the CPUs of each node above, ascending
+
+    static CpuTopology detect();
+    int n_cpus() const;
+};
+
+std::vector<int> parse_cpu_list(const std::string & list);
+std::vector<WorkerPlacement> spread_workers(const CpuTopology & topology, int n_workers);
+bool pin_current_thread(int cpu);
+bool bind_current_thread_memory(int node);
@@ -0,0 +1,219 @@
+#include "decompress.h"
+
+#include <cctype>
+#include <cerrno>
+#include <memory>
+
+#ifdef HAVE_ZLIB
+    #include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+    #include <zstd.h>
+#endif
+
+constexpr std::string_view GZIP_EXTENSION = ".gz";
+constexpr std::string_view ZSTD_EXTENSION = ".zst";
+
+#ifdef HAVE_ZLIB
+// tells inflateInit2() to expect a gzip header rather than a raw zlib stream
+constexpr int GZIP_WINDOW_BITS = 16 + MAX_WBITS;
+#endif
+
+/**
+ * @brief Checks whether a file name ends with an extension, ignoring case.
+ * @param file_name The file name.
+ * @param extension The lowercase extension, including the dot.
+ * @return True if the name ends with the extension, false otherwise.
+ */
+bool has_extension(std::string_view file_name, std::string_view extension)
+{
+    if (file_name.size() < extension.size()) { return false; }
+    std::string_view suffix = file_name.substr(file_name.size() - extension.size());
+    for (size_t i = 0; i < suffix.size(); i++) {
+        if (tolower(static_cast<unsigned char>(suffix[i])) != extension[i]) { return false; }
+    }
+    return true;
+}
+
+/**
+ * @brief Works out how a file is compressed from its name.
+ * @param file_name The name (or path) of the file.
+ * @return The compression of the file, NONE if it doesn't end in .gz or .zst.
+ */
+Compression compression_from_name(std::string_view file_name)
+{
+    if (has_extension(file_name, GZIP_EXTENSION)) { return Compression::GZIP; }
+    if (has_extension(file_name, ZSTD_EXTENSION)) { return Compression::ZSTD; }
+    return Compression::NONE;
+}
+
+/**
+ * @brief Drops the compression extension, so that "notes.txt.gz" can be classified as "notes.txt".
+ * @param file_name The name (or path) of the file.
+ * @param compression The compression found by compression_from_name().
+ * @return The name without its compression extension.
+ */
+std::string_view strip_compression_extension(std::string_view file_name, Compression compression)
+{
+    switch (compression) {
+    case Compression::GZIP: return file_name.substr(0, file_name.size() - GZIP_EXTENSION.size());
+    case Compression::ZSTD: return file_name.substr(0, file_name.size() - ZSTD_EXTENSION.size());
+    default: return file_name;
+    }
+}
+
+/**
+ * @brief Checks whether this build can decompress a given format.
+ * @param compression The compression format.
+ * @return True if stream_blocks() can read files compressed this way, false otherwise.
+ */
+bool compression_supported(Compression compression)
+{
+    switch (compression) {
+    case Compression::NONE: return true;
+#ifdef HAVE_ZLIB
+    case Compression::GZIP: return true;
+#endif
+#ifdef HAVE_ZSTD
+    case Compression::ZSTD: return true;
+#endif
+    default: return false;
+    }
+}
+
+/**
+ * @brief Streams an uncompressed file.
+ */
+static bool stream_plain(FILE * file, const BlockConsumer & consume)
+{
+    unsigned char buffer[READ_BLOCK_SIZE];
+    for (size_t n_read; (n_read = fread(buffer, 1, sizeof(buffer), file)) > 0;) {
+        if (! consume(buffer, n_read)) { return true; }
+    }
+    return ! ferror(file);
+}
+
+#ifdef HAVE_ZLIB
+/**
+ * @brief Streams a gzip file, including files made of several concatenated gzip members.
+ */
+static bool stream_gzip(FILE * file, const BlockConsumer & consume)
+{
+    auto in = std::make_unique<unsigned char[]>(READ_BLOCK_SIZE);
+    auto out = std::make_unique<unsigned char[]>(READ_BLOCK_SIZE);
+    z_stream stream = {};
+    if (inflateInit2(&stream, GZIP_WINDOW_BITS) != Z_OK) {
+        errno = ENOMEM;
+        return false;
+    }
+
+    bool ok = true;
+    bool stopped = false;
+    int status = Z_OK;
+    stream.next_out = out.get();
+    stream.avail_out = READ_BLOCK_SIZE;
+    while (ok && ! stopped) {
+        if (stream.avail_in == 0) {
+            stream.avail_in = fread(in.get(), 1, READ_BLOCK_SIZE, file);
+            stream.next_in = in.get();
+            if (stream.avail_in == 0) {
+                // a clean end of file is only fine if it falls between gzip members
+                ok = ! ferror(file) && status == Z_STREAM_END;
+                if (! ferror(file) && status != Z_STREAM_END) { errno = EBADMSG; }
+                break;
+            }
+        }
+
+        status = inflate(&stream, Z_NO_FLUSH);
+        if (status == Z_STREAM_END) {
+            inflateReset(&stream);
+        } else if (status != Z_OK && status != Z_BUF_ERROR) {
+            errno = EBADMSG;
+            ok = false;
+        }
+
+        // hand over full blocks only, so that the first block is a proper prefix for sniffing
+        if (stream.avail_out == 0) {
+            stopped = ! consume(out.get(), READ_BLOCK_SIZE);
+            stream.next_out = out.get();
+            stream.avail_out = READ_BLOCK_SIZE;
+        }
+    }
+
+    size_t pending = READ_BLOCK_SIZE - stream.avail_out;
+    if (ok && ! stopped && pending > 0) { consume(out.get(), pending); }
+    inflateEnd(&stream);
+    return ok;
+}
+#endif
+
+#ifdef HAVE_ZSTD
+/**
+ * @brief Streams a zstd file, including files made of several concatenated frames.
+ */
+static bool stream_zstd(FILE * file, const BlockConsumer & consume)
+{
+    auto in = std::make_unique<unsigned char[]>(READ_BLOCK_SIZE);
+    auto out = std::make_unique<unsigned char[]>(READ_BLOCK_SIZE);
+    std::unique_ptr<ZSTD_DStream, decltype(&ZSTD_freeDStream)> stream(ZSTD_createDStream(), ZSTD_freeDStream);
+    if (! stream) {
+        errno = ENOMEM;
+        return false;
+    }
+    ZSTD_initDStream(stream.get());
+
+    ZSTD_inBuffer input = { in.get(), 0, 0 };
+    ZSTD_outBuffer output = { out.get(), READ_BLOCK_SIZE, 0 };
+    // 0 once a frame has been fully decoded, which is the only place the file may end
+    size_t frame_remaining = 0;
+    bool ok = true;
+    bool stopped = false;
+    while (ok && ! stopped) {
+        if (input.pos == input.size) {
+            input.size = fread(in.get(), 1, READ_BLOCK_SIZE, file);
+            input.pos = 0;
+            if (input.size == 0) {
+                ok = ! ferror(file) && frame_remaining == 0;
+                if (! ferror(file) && frame_remaining != 0) { errno = EBADMSG; }
+                break;
+            }
+        }
+
+        frame_remaining = ZSTD_decompressStream(stream.get(), &output, &input);
+        if (ZSTD_isError(frame_remaining)) {
+            errno = EBADMSG;
+            ok = false;
+        }
+
+        if (output.pos == output.size) {
+            stopped = ! consume(out.get(), output.pos);
+            output.pos = 0;
+        }
+    }
+
+    if (ok && ! stopped && output.pos > 0) { consume(out.get(), output.pos); }
+    return ok;
+}
+#endif
+
+/**
+ * @brief Reads a file block by block, decompressing it on the fly. Nothing is written to disk and
+ *        at most one block of compressed and one block of decompressed data are held at a time.
+ * @param file The file, opened for reading.
+ * @param compression How the file is compressed; must be supported by this build.
+ * @param consume Called with each block of decompressed data, in order.
+ * @return True if the file was read to the end (or the consumer stopped early), false on a read
+ *         error or corrupt data, with errno set (EBADMSG for corrupt data).
+ */
+bool stream_blocks(FILE * file, Compression compression, const BlockConsumer & consume)
+{
+    switch (compression) {
+#ifdef HAVE_ZLIB
+    case Compression::GZIP: return stream_gzip(file, consume);
+#endif
+#ifdef HAVE_ZSTD
+    case Compression::ZSTD: return stream_zstd(file, consume);
+#endif
+    default: return stream_plain(file, consume);
+    }
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <functional>
+#include <string_view>
+
+// text files (compressed or not) are handed to the tokenizer in blocks of this many bytes
+constexpr size_t READ_BLOCK_SIZE = 64 * 1024;
+
+enum class Compression { NONE, GZIP, ZSTD };
+
+// receives one block of (decompressed) file contents; returning false stops the stream early
+using BlockConsumer = std::function<bool(const unsigned char * data, size_t size)>;
+
+bool has_extension(std::string_view file_name, std::string_view extension);
+Compression compression_from_name(std::string_view file_name);
+std::string_view strip_compression_extension(std::string_view file_name, Compression compression);
+bool compression_supported(Compression compression);
+bool stream_blocks(FILE * file, Compression compression, const BlockConsumer & consume);
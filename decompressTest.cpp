@@ -0,0 +1,176 @@
+#include "decompress.h"
+#include "testing.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifdef HAVE_ZLIB
+    #include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+    #include <zstd.h>
+#endif
+
+// several blocks' worth, so that members and frames end in the middle of a block
+constexpr size_t MEMBER_TEXT_SIZE = 3 * READ_BLOCK_SIZE / 2;
+
+/**
+ * @brief Makes text that compresses, but not down to nothing: words drawn at random.
+ */
+static std::string random_text(unsigned seed, size_t size)
+{
+    const char * words[] = { "alpha ", "bravo ", "charlie ", "delta ", "echo\n", "foxtrot ", "golf ", "hotel\n" };
+    std::mt19937 generator(seed);
+    std::string text;
+    while (text.size() < size) { text += words[generator() % 8]; }
+    text.resize(size);
+    return text;
+}
+
+/**
+ * @brief Writes bytes to an anonymous temporary file and rewinds it.
+ */
+static FILE * temporary_file(const std::string & contents)
+{
+    FILE * file = tmpfile();
+    CHECK(file != nullptr);
+    fwrite(contents.data(), 1, contents.size(), file);
+    rewind(file);
+    return file;
+}
+
+/**
+ * @brief Streams a file, collecting its decompressed contents and the size of each block.
+ * @return Whether stream_blocks() succeeded; errno is left as it set it.
+ */
+static bool stream_all(const std::string & contents, Compression compression, std::string & output, std::vector<size_t> * block_sizes = nullptr)
+{
+    FILE * file = temporary_file(contents);
+    errno = 0;
+    bool ok = stream_blocks(file, compression, [&](const unsigned char * data, size_t size) {
+        output.append(reinterpret_cast<const char *>(data), size);
+        if (block_sizes) { block_sizes->push_back(size); }
+        return true;
+    });
+    int saved_errno = errno;
+    fclose(file);
+    errno = saved_errno;
+    return ok;
+}
+
+TEST_CASE(decompress_names)
+{
+    CHECK(compression_from_name("notes.txt.GZ") == Compression::GZIP);
+    CHECK(compression_from_name("logs/app.log.zst") == Compression::ZSTD);
+    CHECK(compression_from_name("archive.gzip") == Compression::NONE);
+    CHECK(strip_compression_extension("notes.txt.gz", Compression::GZIP) == "notes.txt");
+    CHECK(strip_compression_extension("app.log.zst", Compression::ZSTD) == "app.log");
+    CHECK(strip_compression_extension("plain.txt", Compression::NONE) == "plain.txt");
+    CHECK(compression_supported(Compression::NONE));
+}
+
+TEST_CASE(decompress_plain_in_blocks)
+{
+    std::string text = random_text(1, MEMBER_TEXT_SIZE);
+    std::string output;
+    std::vector<size_t> block_sizes;
+    CHECK(stream_all(text, Compression::NONE, output, &block_sizes));
+    CHECK(output == text);
+    CHECK((block_sizes == std::vector<size_t>{ READ_BLOCK_SIZE, MEMBER_TEXT_SIZE - READ_BLOCK_SIZE }));
+}
+
+#ifdef HAVE_ZLIB
+/**
+ * @brief Compresses text into one gzip member.
+ */
+static std::string gzip_member(const std::string & text)
+{
+    z_stream stream = {};
+    CHECK(deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+    std::string compressed(deflateBound(&stream, text.size()), '\0');
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(text.data()));
+    stream.avail_in = text.size();
+    stream.next_out = reinterpret_cast<Bytef *>(&compressed[0]);
+    stream.avail_out = compressed.size();
+    CHECK(deflate(&stream, Z_FINISH) == Z_STREAM_END);
+    compressed.resize(stream.total_out);
+    deflateEnd(&stream);
+    return compressed;
+}
+
+TEST_CASE(decompress_gzip_members)
+{
+    CHECK(compression_supported(Compression::GZIP));
+    std::string text1 = random_text(2, MEMBER_TEXT_SIZE);
+    std::string text2 = random_text(3, MEMBER_TEXT_SIZE);
+    std::string output;
+    std::vector<size_t> block_sizes;
+    // concatenated members, as `cat a.gz b.gz` makes, are one stream
+    CHECK(stream_all(gzip_member(text1) + gzip_member(text2), Compression::GZIP, output, &block_sizes));
+    CHECK(output == text1 + text2);
+    // every block but the last is full, so that the first one is a proper prefix for sniffing
+    for (size_t i = 0; i + 1 < block_sizes.size(); i++) { CHECK(block_sizes[i] == READ_BLOCK_SIZE); }
+
+    std::string empty_output;
+    CHECK(stream_all(gzip_member(""), Compression::GZIP, empty_output));
+    CHECK(empty_output.empty());
+}
+
+TEST_CASE(decompress_gzip_corruption_is_ebadmsg)
+{
+    std::string compressed = gzip_member(random_text(4, MEMBER_TEXT_SIZE));
+    std::string output;
+
+    std::string truncated = compressed.substr(0, compressed.size() / 2);
+    CHECK(! stream_all(truncated, Compression::GZIP, output));
+    CHECK(errno == EBADMSG);
+
+    // a damaged trailer fails the CRC check, after the data itself decoded fine
+    std::string bad_checksum = compressed;
+    bad_checksum[bad_checksum.size() - 6] ^= 0xFF;
+    CHECK(! stream_all(bad_checksum, Compression::GZIP, output));
+    CHECK(errno == EBADMSG);
+
+    CHECK(! stream_all("this is not gzip at all", Compression::GZIP, output));
+    CHECK(errno == EBADMSG);
+}
+#endif
+
+#ifdef HAVE_ZSTD
+static std::string zstd_frame(const std::string & text)
+{
+    std::string compressed(ZSTD_compressBound(text.size()), '\0');
+    size_t size = ZSTD_compress(&compressed[0], compressed.size(), text.data(), text.size(), 3);
+    CHECK(! ZSTD_isError(size));
+    compressed.resize(size);
+    return compressed;
+}
+
+TEST_CASE(decompress_zstd_frames)
+{
+    CHECK(compression_supported(Compression::ZSTD));
+    std::string text1 = random_text(5, MEMBER_TEXT_SIZE);
+    std::string text2 = random_text(6, READ_BLOCK_SIZE / 3);
+    std::string text3 = random_text(7, MEMBER_TEXT_SIZE);
+    std::string output;
+    CHECK(stream_all(zstd_frame(text1) + zstd_frame(text2) + zstd_frame(text3), Compression::ZSTD, output));
+    CHECK(output == text1 + text2 + text3);
+}
+
+TEST_CASE(decompress_zstd_corruption_is_ebadmsg)
+{
+    std::string compressed = zstd_frame(random_text(8, MEMBER_TEXT_SIZE));
+    std::string output;
+
+    // cut inside the second frame: the first one decoded, but the file ends mid-frame
+    std::string truncated = compressed + compressed.substr(0, compressed.size() / 2);
+    CHECK(! stream_all(truncated, Compression::ZSTD, output));
+    CHECK(errno == EBADMSG);
+
+    CHECK(! stream_all("this is not zstd at all", Compression::ZSTD, output));
+    CHECK(errno == EBADMSG);
+}
+#endif
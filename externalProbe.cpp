@@ -0,0 +1,180 @@
+#include "externalProbe.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char ** environ;
+
+constexpr int EXEC_FAILED = 127;
+constexpr int NO_TIMEOUT = -1;
+constexpr int MS_PER_SECOND = 1000;
+constexpr int NS_PER_MS = 1000000;
+constexpr useconds_t EXIT_POLL_US = 1000;
+// searched when PATH isn't set, like execvp() does
+constexpr char DEFAULT_SEARCH_PATH[] = "/bin:/usr/bin";
+
+static long now_ms()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * MS_PER_SECOND + now.tv_nsec / NS_PER_MS;
+}
+
+static void set_limit(int resource, long value)
+{
+    if (value <= 0) { return; }
+    rlimit limit = { static_cast<rlim_t>(value), static_cast<rlim_t>(value) };
+    setrlimit(resource, &limit);
+}
+
+/**
+ * @brief Finds a program the way execvp() would: a name containing a slash is taken as a path,
+ *        anything else is searched for in the directories of PATH.
+ * @param name The name of the program (e.g. "identify").
+ * @return The path to the program, or an empty string if there is no such executable.
+ */
+std::string find_program(const std::string & name)
+{
+    auto is_executable = [](const std::string & path) {
+        struct stat status;
+        return stat(path.c_str(), &status) == 0 && S_ISREG(status.st_mode) && access(path.c_str(), X_OK) == 0;
+    };
+    if (name.empty()) { return ""; }
+    if (name.find('/') != std::string::npos) { return is_executable(name) ? name : ""; }
+
+    const char * search_path = getenv("PATH");
+    std::string directories = search_path ? search_path : DEFAULT_SEARCH_PATH;
+    size_t start = 0;
+    while (start <= directories.size()) {
+        size_t end = std::min(directories.find(':', start), directories.size());
+        // an empty entry stands for the current directory
+        std::string directory = end == start ? "." : directories.substr(start, end - start);
+        std::string path = directory + "/" + name;
+        if (is_executable(path)) { return path; }
+        start = end + 1;
+    }
+    return "";
+}
+
+/**
+ * @brief Opens a pipe whose ends are closed on exec, so that other probes running at the same time
+ *        (on other threads) don't inherit them and keep the pipe open.
+ * @return False if the pipe couldn't be opened.
+ */
+static bool open_probe_pipe(int pipe_fds[2])
+{
+#ifdef __linux__
+    return pipe2(pipe_fds, O_CLOEXEC) == 0;
+#else
+    // without pipe2, another thread's fork() may still catch the ends before they are marked
+    if (pipe(pipe_fds) != 0) { return false; }
+    fcntl(pipe_fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(pipe_fds[1], F_SETFD, FD_CLOEXEC);
+    return true;
+#endif
+}
+
+/**
+ * @brief Runs the probe in the forked child: its own process group (so that anything it spawns is
+ *        killed along with it), the resource limits, stdout into the pipe and stderr discarded.
+ *        Only async-signal-safe calls are made between fork() and exec(), which is why the program
+ *        is run with execve() from a path found beforehand rather than searched for by execvp().
+ */
+[[noreturn]] static void exec_probe(char * const argv[], const ProbeLimits & limits, int output_fd)
+{
+    setpgid(0, 0);
+    set_limit(RLIMIT_CPU, limits.cpu_seconds);
+    set_limit(RLIMIT_AS, limits.memory_bytes);
+    int null_fd = open("/dev/null", O_RDWR);
+    if (null_fd >= 0) {
+        dup2(null_fd, STDIN_FILENO);
+        dup2(null_fd, STDERR_FILENO);
+    }
+    dup2(output_fd, STDOUT_FILENO);
+    execve(argv[0], argv, environ);
+    _exit(EXEC_FAILED);
+}
+
+/**
+ * @brief Runs an external program (e.g. identify) without a shell and collects its output, killing
+ *        its process group if it runs past the timeout, so that a hanging probe can't stall the scan.
+ * @param arguments The path to the program, as find_program() returns it, and its arguments. The
+ *        path isn't searched for: callers find the program once rather than before every probe.
+ * @param limits The limits to run it under.
+ * @param output Set to the start of what the program wrote to stdout.
+ * @param max_output_size The most output to keep; the rest is read and dropped.
+ * @return How the program ended.
+ */
+ProbeStatus run_probe(const std::vector<std::string> & arguments, const ProbeLimits & limits, std::string & output,
+                      size_t max_output_size)
+{
+    output.clear();
+    if (arguments.empty() || arguments[0].empty()) { return ProbeStatus::FAILED; }
+    // the argument vector is built before fork(), since the child may not allocate
+    std::vector<char *> argv;
+    for (auto & argument : arguments) { argv.push_back(const_cast<char *>(argument.c_str())); }
+    argv.push_back(nullptr);
+
+    int pipe_fds[2];
+    if (! open_probe_pipe(pipe_fds)) { return ProbeStatus::FAILED; }
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+        return ProbeStatus::FAILED;
+    }
+    if (pid == 0) { exec_probe(argv.data(), limits, pipe_fds[1]); }
+    // set from both sides, so the group exists whichever process runs first
+    setpgid(pid, pid);
+    close(pipe_fds[1]);
+
+    long deadline = limits.timeout_seconds > 0 ? now_ms() + std::lround(limits.timeout_seconds * MS_PER_SECOND) : 0;
+    auto remaining_ms = [&]() { return deadline ? std::max(0L, deadline - now_ms()) : NO_TIMEOUT; };
+    bool timed_out = false;
+
+    // read until the probe closes its end of the pipe
+    pollfd output_poll = { pipe_fds[0], POLLIN, 0 };
+    char buffer[4096];
+    while (true) {
+        int ready = poll(&output_poll, 1, remaining_ms());
+        if (ready < 0 && errno == EINTR) { continue; }
+        if (ready <= 0) {
+            timed_out = ready == 0;
+            break;
+        }
+        ssize_t n_read = read(pipe_fds[0], buffer, sizeof(buffer));
+        if (n_read < 0 && errno == EINTR) { continue; }
+        if (n_read <= 0) { break; }
+        output.append(buffer, std::min(static_cast<size_t>(n_read), max_output_size - std::min(max_output_size, output.size())));
+    }
+    close(pipe_fds[0]);
+
+    // the probe may hold on after closing stdout, so waiting for it is bounded as well
+    int status = 0;
+    while (! timed_out) {
+        pid_t waited = waitpid(pid, &status, deadline ? WNOHANG : 0);
+        if (waited == pid) { break; }
+        if (waited < 0 && errno != EINTR) { return ProbeStatus::FAILED; }
+        if (deadline && remaining_ms() == 0) {
+            timed_out = true;
+            break;
+        }
+        if (waited == 0) { usleep(EXIT_POLL_US); }
+    }
+    if (timed_out) {
+        kill(-pid, SIGKILL);
+        while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+        return ProbeStatus::TIMED_OUT;
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? ProbeStatus::DONE : ProbeStatus::FAILED;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// limits an external probe runs under; 0 turns a limit off
+struct ProbeLimits {
+    double timeout_seconds = 0; // wall-clock time before the probe's whole process group is killed
+    long cpu_seconds = 0;       // RLIMIT_CPU of the probe
+    long memory_bytes = 0;      // RLIMIT_AS of the probe, which counts reserved address space too
+};
+
+enum class ProbeStatus {
+    DONE,      // the probe exited with status 0
+    FAILED,    // it could not be started, or exited with another status or a signal
+    TIMED_OUT, // it was killed for running past the timeout
+};
+
+std::string find_program(const std::string & name);
+ProbeStatus run_probe(const std::vector<std::string> & arguments, const ProbeLimits & limits, std::string & output,
+                      size_t max_output_size);
@@ -0,0 +1,44 @@
+#include "externalProbe.h"
+#include "testing.h"
+
+#include <chrono>
+#include <string>
+
+constexpr size_t PROBE_OUTPUT_SIZE = 4096;
+
+TEST_CASE(find_program_searches_path)
+{
+    std::string shell = find_program("sh");
+    CHECK(! shell.empty() && shell.back() == 'h' && shell.find('/') != std::string::npos);
+    CHECK(find_program(shell) == shell);
+    CHECK(find_program("no-such-program-anywhere").empty());
+    CHECK(find_program("/no/such/program").empty());
+    // a directory isn't a program, even though it can be searched (X_OK)
+    CHECK(find_program("/").empty());
+}
+
+TEST_CASE(run_probe_collects_output)
+{
+    std::string shell = find_program("sh");
+    std::string output;
+    CHECK(run_probe({ shell, "-c", "echo 12 34 PNG" }, ProbeLimits(), output, PROBE_OUTPUT_SIZE) == ProbeStatus::DONE);
+    CHECK(output == "12 34 PNG\n");
+    CHECK(run_probe({ shell, "-c", "echo partial; exit 3" }, ProbeLimits(), output, PROBE_OUTPUT_SIZE) == ProbeStatus::FAILED);
+    CHECK(run_probe({ shell, "-c", "echo 0123456789" }, ProbeLimits(), output, 4) == ProbeStatus::DONE);
+    CHECK(output == "0123");
+    CHECK(run_probe({ "/no/such/program" }, ProbeLimits(), output, PROBE_OUTPUT_SIZE) == ProbeStatus::FAILED);
+    CHECK(run_probe({}, ProbeLimits(), output, PROBE_OUTPUT_SIZE) == ProbeStatus::FAILED);
+    // the path is run as given, not searched for in PATH
+    CHECK(run_probe({ "sh", "-c", "true" }, ProbeLimits(), output, PROBE_OUTPUT_SIZE) == ProbeStatus::FAILED);
+}
+
+TEST_CASE(run_probe_kills_hanging_probes)
+{
+    // the child keeps stdout open, so only the timeout can end the probe
+    ProbeLimits limits;
+    limits.timeout_seconds = 0.2;
+    std::string output;
+    auto start = std::chrono::steady_clock::now();
+    CHECK(run_probe({ find_program("sh"), "-c", "sleep 30 & wait" }, limits, output, PROBE_OUTPUT_SIZE) == ProbeStatus::TIMED_OUT);
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+}
@@ -0,0 +1,130 @@
+#include "fileStore.h"
+
+#include <algorithm>
+#include <functional>
+
+constexpr char NAME_TERMINATOR = '\0';
+
+/**
+ * @brief Returns the size bucket of a file.
+ * @param size The size of the file, in bytes.
+ * @return 0 for an empty file, otherwise floor(log2(size)) + 1, capped at the last bucket.
+ */
+int file_size_bucket(long size)
+{
+    if (size <= 0) { return 0; }
+    int bucket = 64 - __builtin_clzl(static_cast<unsigned long>(size));
+    return std::min(bucket, FILE_SIZE_BUCKETS - 1);
+}
+
+/**
+ * @brief Adds a file.
+ * @param parent The ID of the directory holding the file.
+ * @param name The name of the file.
+ * @param extension Its extension, as file_extension() gives it ("" for none).
+ * @param size Its size, in bytes.
+ * @param mtime Its last modification time, in seconds since the epoch.
+ * @param kind What kind of file it is.
+ * @return The index of the file, which is also its position in every column.
+ */
+size_t FileStore::add(PathId parent, std::string_view name, std::string_view extension, long size, long mtime, FileKind kind)
+{
+    auto [it, inserted] = extension_ids.try_emplace(std::string(extension), static_cast<ExtensionId>(extension_names.size()));
+    if (inserted) { extension_names.emplace_back(extension); }
+
+    sizes.push_back(size);
+    mtimes.push_back(mtime);
+    parents.push_back(parent);
+    name_offsets.push_back(static_cast<uint32_t>(names.size()));
+    kinds.push_back(kind);
+    extensions.push_back(it->second);
+    names.append(name);
+    names.push_back(NAME_TERMINATOR);
+    return sizes.size() - 1;
+}
+
+/**
+ * @brief Counts the files of each extension and adds up their sizes.
+ * @return The totals, indexed by extension ID.
+ */
+std::vector<FileTotals> FileStore::extension_totals() const
+{
+    std::vector<FileTotals> totals(extension_names.size());
+    for (size_t i = 0; i < sizes.size(); i++) {
+        totals[extensions[i]].count++;
+        totals[extensions[i]].bytes += sizes[i];
+    }
+    return totals;
+}
+
+/**
+ * @brief Counts the files of each kind and adds up their sizes.
+ * @return The totals, indexed by FileKind.
+ */
+std::array<FileTotals, N_FILE_KINDS> FileStore::kind_totals() const
+{
+    std::array<FileTotals, N_FILE_KINDS> totals = {};
+    for (size_t i = 0; i < sizes.size(); i++) {
+        totals[static_cast<size_t>(kinds[i])].count++;
+        totals[static_cast<size_t>(kinds[i])].bytes += sizes[i];
+    }
+    return totals;
+}
+
+/**
+ * @brief Counts the files in each size bucket (see file_size_bucket()).
+ */
+FileSizeHistogram FileStore::size_histogram() const
+{
+    FileSizeHistogram histogram = {};
+    for (long size : sizes) { histogram[file_size_bucket(size)]++; }
+    return histogram;
+}
+
+/**
+ * @brief Counts the files last modified before a given time and adds up their sizes.
+ * @param mtime The time, in seconds since the epoch.
+ */
+FileTotals FileStore::modified_before(long mtime) const
+{
+    // branch-free, so that the compiler can vectorize it
+    FileTotals totals;
+    for (size_t i = 0; i < mtimes.size(); i++) {
+        bool older = mtimes[i] < mtime;
+        totals.count += older;
+        totals.bytes += older ? sizes[i] : 0;
+    }
+    return totals;
+}
+
+/**
+ * @brief Finds the candidates for the k largest files: the k largest, plus every other file as
+ *        large as the k-th, since ties are up to the caller to break.
+ * @param k The number of files wanted.
+ * @return The indices of the candidates, in no particular order.
+ */
+std::vector<size_t> FileStore::largest(size_t k) const
+{
+    std::vector<size_t> candidates;
+    k = std::min(k, sizes.size());
+    if (k == 0) { return candidates; }
+
+    std::vector<long> by_size(sizes);
+    std::nth_element(by_size.begin(), by_size.begin() + k - 1, by_size.end(), std::greater<long>());
+    long min_size = by_size[k - 1];
+    for (size_t i = 0; i < sizes.size(); i++) {
+        if (sizes[i] >= min_size) { candidates.push_back(i); }
+    }
+    return candidates;
+}
+
+/**
+ * @brief Returns the memory held by the columns and the name pool, in bytes.
+ */
+size_t FileStore::memory_usage() const
+{
+    size_t usage = sizes.capacity() * sizeof(long) + mtimes.capacity() * sizeof(long);
+    usage += parents.capacity() * sizeof(PathId) + name_offsets.capacity() * sizeof(uint32_t);
+    usage += kinds.capacity() * sizeof(FileKind) + extensions.capacity() * sizeof(ExtensionId);
+    return usage + names.capacity();
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "pathTable.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+enum class FileKind : uint8_t { OTHER, TEXT, COMPRESSED, ARCHIVE };
+constexpr int N_FILE_KINDS = 4;
+
+using ExtensionId = uint32_t;
+
+// empty files, then one bucket per power of two: 1, 2-3, 4-7, ... bytes, with 2^40+ in the last
+constexpr int FILE_SIZE_BUCKETS = 42;
+
+using FileSizeHistogram = std::array<long, FILE_SIZE_BUCKETS>;
+
+struct FileTotals {
+    long count = 0;
+    long bytes = 0;
+};
+
+/**
+ * @brief Keeps one record per file found by the scan, column by column: a query that only needs
+ *        sizes walks one array of sizes, instead of striding over whole records and their strings.
+ *
+ * Names are stored back to back in one pool, each ending with a NUL, and located by offset; a
+ * file's directory is its PathId in the scan's PathTable. Extensions are interned to small dense
+ * IDs, so that totals per extension are plain arrays indexed by ID.
+ */
+class FileStore {
+public:
+    size_t add(PathId parent, std::string_view name, std::string_view extension, long size, long mtime, FileKind kind);
+    size_t size() const { return sizes.size(); }
+    size_t memory_usage() const;
+
+    std::vector<FileTotals> extension_totals() const;
+    std::array<FileTotals, N_FILE_KINDS> kind_totals() const;
+    FileSizeHistogram size_histogram() const;
+    FileTotals modified_before(long mtime) const;
+    std::vector<size_t> largest(size_t k) const;
+
+    std::string_view name(size_t file) const { return names.data() + name_offsets[file]; }
+    PathId parent(size_t file) const { return parents[file]; }
+    long file_size(size_t file) const { return sizes[file]; }
+    const std::string & extension(ExtensionId id) const { return extension_names[id]; }
+
+private:
+    std::vector<long> sizes;
+    std::vector<long> mtimes;
+    std::vector<PathId> parents;
+    std::vector<uint32_t> name_offsets; // into names
+    std::vector<FileKind> kinds;
+    std::vector<ExtensionId> extensions;
+
+    std::string names;
+    std::unordered_map<std::string, ExtensionId> extension_ids;
+    std::vector<std::string> extension_names; // by ID
+};
+
+int file_size_bucket(long size);
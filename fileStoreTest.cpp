@@ -0,0 +1,79 @@
+#include "fileStore.h"
+#include "testing.h"
+
+#include <algorithm>
+#include <climits>
+#include <vector>
+
+constexpr long TERABYTE = 1L << 40;
+
+TEST_CASE(file_store_size_bucket_edges)
+{
+    CHECK(file_size_bucket(-1) == 0);
+    CHECK(file_size_bucket(0) == 0);
+    CHECK(file_size_bucket(1) == 1);
+    CHECK(file_size_bucket(2) == 2);
+    CHECK(file_size_bucket(3) == 2);
+    CHECK(file_size_bucket(4) == 3);
+    CHECK(file_size_bucket(4095) == 12);
+    CHECK(file_size_bucket(4096) == 13);
+    // everything from 2^40 up shares the last bucket
+    CHECK(file_size_bucket(TERABYTE - 1) == FILE_SIZE_BUCKETS - 2);
+    CHECK(file_size_bucket(TERABYTE) == FILE_SIZE_BUCKETS - 1);
+    CHECK(file_size_bucket(LONG_MAX) == FILE_SIZE_BUCKETS - 1);
+
+    FileStore store;
+    for (long size : { 0L, 1L, 2L, 3L, 4L, TERABYTE - 1, TERABYTE, 5 * TERABYTE }) { store.add(0, "file", "", size, 0, FileKind::OTHER); }
+    FileSizeHistogram histogram = store.size_histogram();
+    CHECK(histogram[0] == 1 && histogram[1] == 1 && histogram[2] == 2 && histogram[3] == 1);
+    CHECK(histogram[FILE_SIZE_BUCKETS - 2] == 1 && histogram[FILE_SIZE_BUCKETS - 1] == 2);
+}
+
+TEST_CASE(file_store_columns_and_totals)
+{
+    FileStore store;
+    CHECK(store.add(7, "notes.txt", "txt", 100, 10, FileKind::TEXT) == 0);
+    CHECK(store.add(8, "logs.tar", "tar", 5000, 20, FileKind::ARCHIVE) == 1);
+    CHECK(store.add(7, "more.txt", "txt", 50, 30, FileKind::TEXT) == 2);
+    CHECK(store.add(9, "Makefile", "", 7, 40, FileKind::OTHER) == 3);
+    CHECK(store.size() == 4);
+    CHECK(store.name(2) == "more.txt" && store.parent(2) == 7 && store.file_size(2) == 50);
+
+    std::vector<FileTotals> extensions = store.extension_totals();
+    CHECK(extensions.size() == 3);
+    CHECK(store.extension(0) == "txt" && extensions[0].count == 2 && extensions[0].bytes == 150);
+    CHECK(store.extension(2).empty() && extensions[2].count == 1 && extensions[2].bytes == 7);
+    auto kinds = store.kind_totals();
+    CHECK(kinds[static_cast<size_t>(FileKind::TEXT)].count == 2 && kinds[static_cast<size_t>(FileKind::TEXT)].bytes == 150);
+    CHECK(kinds[static_cast<size_t>(FileKind::COMPRESSED)].count == 0);
+}
+
+TEST_CASE(file_store_modified_before)
+{
+    FileStore store;
+    for (long mtime = 1; mtime <= 10; mtime++) { store.add(0, "file", "", mtime * 100, mtime, FileKind::OTHER); }
+    // strictly before: a file modified at the cutoff itself isn't counted
+    FileTotals older = store.modified_before(4);
+    CHECK(older.count == 3 && older.bytes == 600);
+    CHECK(store.modified_before(1).count == 0);
+    CHECK(store.modified_before(11).count == 10 && store.modified_before(11).bytes == 5500);
+}
+
+TEST_CASE(file_store_largest_with_ties)
+{
+    FileStore store;
+    for (long size : { 5L, 9L, 9L, 2L, 12L, 9L, 3L }) { store.add(0, "file", "", size, 0, FileKind::OTHER); }
+    auto largest = [&](size_t k) {
+        std::vector<size_t> candidates = store.largest(k);
+        std::sort(candidates.begin(), candidates.end());
+        return candidates;
+    };
+    CHECK(largest(1) == std::vector<size_t>{ 4 });
+    // every file as large as the k-th is a candidate, so that the caller can break the tie
+    CHECK((largest(2) == std::vector<size_t>{ 1, 2, 4, 5 }));
+    CHECK((largest(4) == std::vector<size_t>{ 1, 2, 4, 5 }));
+    CHECK((largest(5) == std::vector<size_t>{ 0, 1, 2, 4, 5 }));
+    CHECK(largest(100).size() == store.size());
+    CHECK(largest(0).empty());
+    CHECK(FileStore().largest(3).empty());
+}
@@ -0,0 +1,57 @@
+#include "hyperLogLog.h"
+
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @brief Adds a value, given by its hash (see hll_hash()).
+ * @param hash The hash of the value.
+ */
+void HyperLogLog::add(uint64_t hash)
+{
+    if (registers.empty()) { registers.resize(HLL_N_REGISTERS); }
+
+    size_t index = hash >> (64 - HLL_PRECISION);
+    uint64_t remaining = hash << HLL_PRECISION;
+    // the position of the first 1 bit, counting from 1; all zeros counts as one past the last bit
+    uint8_t rank = remaining == 0 ? 64 - HLL_PRECISION + 1 : __builtin_clzll(remaining) + 1;
+    registers[index] = std::max(registers[index], rank);
+}
+
+/**
+ * @brief Adds another sketch's values to this one.
+ * @param other The sketch to merge in.
+ */
+void HyperLogLog::merge(const HyperLogLog & other)
+{
+    if (other.registers.empty()) { return; }
+    if (registers.empty()) {
+        registers = other.registers;
+        return;
+    }
+    for (size_t i = 0; i < HLL_N_REGISTERS; i++) { registers[i] = std::max(registers[i], other.registers[i]); }
+}
+
+/**
+ * @brief Estimates the number of distinct values added so far.
+ * @return The estimate (0 if nothing was added).
+ */
+long HyperLogLog::estimate() const
+{
+    if (registers.empty()) { return 0; }
+
+    double m = HLL_N_REGISTERS;
+    double inverse_sum = 0;
+    size_t n_zero_registers = 0;
+    for (uint8_t rank : registers) {
+        inverse_sum += std::ldexp(1.0, -rank);
+        if (rank == 0) { n_zero_registers++; }
+    }
+    double alpha = 0.7213 / (1 + 1.079 / m);
+    double estimate = alpha * m * m / inverse_sum;
+
+    // the raw estimate is biased up for small sets, which linear counting of the empty registers
+    // handles much better; 64-bit hashes don't need a correction at the large end
+    if (estimate <= 2.5 * m && n_zero_registers > 0) { estimate = m * std::log(m / n_zero_registers); }
+    return std::lround(estimate);
+}
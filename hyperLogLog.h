@@ -0,0 +1,55 @@
+#pragma once
+
+#include "perfectHash.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+constexpr int HLL_PRECISION = 14;
+constexpr size_t HLL_N_REGISTERS = size_t(1) << HLL_PRECISION; // one byte each, so 16 KB per sketch
+constexpr uint64_t HLL_HASH_SEED = 0;
+
+/**
+ * @brief Hashes a string for a HyperLogLog sketch. The FNV-1a hash is good enough for table slots,
+ *        but its high bits are poorly mixed, so they are scrambled further with the MurmurHash3
+ *        finalizer.
+ * @param value The string to hash.
+ * @return A 64-bit hash whose bits are all close to uniform.
+ */
+constexpr uint64_t hll_hash(std::string_view value)
+{
+    uint64_t hash = seeded_hash(value, HLL_HASH_SEED);
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDULL;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+/**
+ * @brief A HyperLogLog sketch: estimates how many distinct values were added to it, within about
+ *        1% (1.04 / sqrt(HLL_N_REGISTERS)), in fixed memory however many values there are.
+ *
+ * Each value's hash picks a register with its top bits and leaves the longest run of leading zeros
+ * seen in its remaining bits there. Two sketches merge by taking the larger register of each pair,
+ * which gives exactly the sketch of both streams together, so subtree sketches roll up into their
+ * parents. The registers are only allocated on the first value, so an unused sketch costs nothing.
+ * They can come from a memory resource (e.g. the arena of a directory's scan).
+ */
+class HyperLogLog {
+public:
+    HyperLogLog() = default;
+    explicit HyperLogLog(std::pmr::memory_resource * resource) : registers(resource) {}
+
+    void add(uint64_t hash);
+    void add(std::string_view value) { add(hll_hash(value)); }
+    void merge(const HyperLogLog & other);
+    long estimate() const;
+
+private:
+    std::pmr::vector<uint8_t> registers;
+};
@@ -0,0 +1,58 @@
+#include "hyperLogLog.h"
+#include "testing.h"
+
+#include <cmath>
+#include <string>
+
+// three standard errors (the standard error is 1.04 / sqrt(HLL_N_REGISTERS)); the values are fixed,
+// so the checks don't flake
+constexpr double HLL_ERROR_BOUND = 3 * 1.04 / (1 << (HLL_PRECISION / 2));
+
+static bool within_bound(long estimate, long n_distinct)
+{
+    if (n_distinct == 0) { return estimate == 0; }
+    return std::abs(static_cast<double>(estimate - n_distinct)) <= HLL_ERROR_BOUND * n_distinct;
+}
+
+static void add_values(HyperLogLog & sketch, long first, long last)
+{
+    for (long i = first; i < last; i++) { sketch.add("value" + std::to_string(i)); }
+}
+
+TEST_CASE(hyper_log_log_error_bound)
+{
+    for (long n_distinct : { 0L, 1L, 100L, 5000L, 50000L, 500000L }) {
+        HyperLogLog sketch;
+        add_values(sketch, 0, n_distinct);
+        CHECK(within_bound(sketch.estimate(), n_distinct));
+    }
+}
+
+TEST_CASE(hyper_log_log_ignores_repeats)
+{
+    HyperLogLog once;
+    HyperLogLog thrice;
+    add_values(once, 0, 20000);
+    for (int repeat = 0; repeat < 3; repeat++) { add_values(thrice, 0, 20000); }
+    CHECK(thrice.estimate() == once.estimate());
+}
+
+TEST_CASE(hyper_log_log_merge_is_union)
+{
+    // overlapping halves: the merged sketch must be exactly the sketch of the union
+    HyperLogLog left;
+    HyperLogLog right;
+    HyperLogLog both;
+    add_values(left, 0, 60000);
+    add_values(right, 40000, 100000);
+    add_values(both, 0, 100000);
+    left.merge(right);
+    CHECK(left.estimate() == both.estimate());
+    CHECK(within_bound(left.estimate(), 100000));
+
+    HyperLogLog unused;
+    left.merge(unused);
+    CHECK(left.estimate() == both.estimate());
+    unused.merge(both);
+    CHECK(unused.estimate() == both.estimate());
+}
@@ -0,0 +1,175 @@
+#include "imageBatcher.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+constexpr unsigned OPS_PER_FILE = 3;
+constexpr unsigned OP_OPEN = 0;
+constexpr unsigned OP_READ = 1;
+constexpr unsigned OP_CLOSE = 2;
+constexpr unsigned READ_BUFFER_INDEX = 0;
+constexpr char PROBE_PATH[] = "/";
+
+/**
+ * @brief Sets up the ring, the buffer slots and the direct descriptor table.
+ * @return False if io_uring can't be used here, in which case add() reads headers synchronously.
+ */
+bool ImageBatcher::start()
+{
+#ifdef __linux__
+    buffers.resize(IMAGE_BATCH_SIZE * IMAGE_HEADER_SIZE);
+    iovec buffer = { buffers.data(), buffers.size() };
+    active = ring.setup(IMAGE_BATCH_SIZE * OPS_PER_FILE) && ring.register_buffers(&buffer, 1) &&
+             ring.register_sparse_files(IMAGE_BATCH_SIZE) && supports_direct_open();
+#endif
+    return active;
+}
+
+#ifdef __linux__
+
+/**
+ * @brief Queues the linked operations for one file.
+ * @param slot The buffer slot and direct descriptor the file uses.
+ * @param path The path to the file, which must stay valid until the operations are submitted.
+ * @param read Whether to read the header (without, the file is only opened and closed).
+ * @return False if the submission queue can't hold the whole chain until the next submit, in which
+ *         case nothing is queued (a chain cut in two would be ended early by the submit).
+ */
+bool ImageBatcher::queue_chain(unsigned slot, const char * path, bool read)
+{
+    if (ring.sq_space_left() < (read ? OPS_PER_FILE : OPS_PER_FILE - 1)) { return false; }
+    io_uring_sqe * open = ring.get_sqe();
+    open->opcode = IORING_OP_OPENAT;
+    open->fd = AT_FDCWD;
+    open->addr = reinterpret_cast<uint64_t>(path);
+    open->open_flags = O_RDONLY | O_CLOEXEC;
+    open->file_index = slot + 1; // 1-based, since 0 means a regular descriptor
+    open->flags = IOSQE_IO_LINK;
+    open->user_data = slot * OPS_PER_FILE + OP_OPEN;
+
+    if (read) {
+        io_uring_sqe * read = ring.get_sqe();
+        read->opcode = IORING_OP_READ_FIXED;
+        read->fd = slot;
+        read->addr = reinterpret_cast<uint64_t>(buffers.data() + slot * IMAGE_HEADER_SIZE);
+        read->len = IMAGE_HEADER_SIZE;
+        read->off = 0;
+        read->buf_index = READ_BUFFER_INDEX;
+        // a short read breaks a plain link, which would leave the descriptor open
+        read->flags = IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK;
+        read->user_data = slot * OPS_PER_FILE + OP_READ;
+    }
+
+    io_uring_sqe * close = ring.get_sqe();
+    close->opcode = IORING_OP_CLOSE;
+    close->file_index = slot + 1;
+    close->user_data = slot * OPS_PER_FILE + OP_CLOSE;
+    return true;
+}
+
+/**
+ * @brief Checks that the kernel can open into direct descriptors (5.15 and later), by opening and
+ *        closing the root directory that way.
+ */
+bool ImageBatcher::supports_direct_open()
+{
+    if (! queue_chain(0, PROBE_PATH, false)) { return false; }
+    if (ring.submit_and_wait(OPS_PER_FILE - 1) != static_cast<int>(OPS_PER_FILE - 1)) { return false; }
+    bool opened = true;
+    unsigned n_completed = 0;
+    while (n_completed < OPS_PER_FILE - 1) {
+        n_completed += ring.drain_completions([&](uint64_t, int result) { opened = opened && result >= 0; });
+        if (n_completed < OPS_PER_FILE - 1) { ring.submit_and_wait(1); }
+    }
+    return opened;
+}
+#endif
+
+/**
+ * @brief Queues a file, reading the whole batch once it is full.
+ * @param path The path to the file.
+ * @param path_id The ID of the path, passed on to the consumer.
+ * @param file_size The size of the file, passed on to the consumer.
+ */
+void ImageBatcher::add(const std::string & path, PathId path_id, long file_size)
+{
+    pending.push_back(PendingImage{ path, path_id, file_size });
+    if (pending.size() == IMAGE_BATCH_SIZE) { flush(); }
+}
+
+void ImageBatcher::flush_synchronously()
+{
+    for (auto & [path, path_id, file_size] : pending) { consumer(path, path_id, file_size, read_image_header(path)); }
+    pending.clear();
+}
+
+/**
+ * @brief Reads the headers of the queued files, handing each to the consumer as its read completes.
+ */
+void ImageBatcher::flush()
+{
+    if (pending.empty()) { return; }
+    if (! active) {
+        flush_synchronously();
+        return;
+    }
+
+#ifdef __linux__
+    unsigned n_expected = pending.size() * OPS_PER_FILE;
+    unsigned n_completed = 0;
+    std::vector<bool> consumed(pending.size(), false);
+    auto complete = [&](uint64_t user_data, int result) {
+        if (user_data % OPS_PER_FILE != OP_READ) { return; }
+        unsigned slot = user_data / OPS_PER_FILE;
+        const auto & [path, path_id, file_size] = pending[slot];
+        // formats that may keep their dimensions further in (TIFF, JPEG) read them directly from the file
+        int fd = -1;
+        auto read_at = [&](uint64_t offset, unsigned char * buffer, size_t size) -> size_t {
+            if (fd < 0) { fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC); }
+            ssize_t n_read = fd < 0 ? -1 : pread(fd, buffer, size, offset);
+            return n_read < 0 ? 0 : n_read;
+        };
+        std::optional<ImageHeader> header;
+        if (result > 0) { header = parse_image_header(buffers.data() + slot * IMAGE_HEADER_SIZE, result, read_at); }
+        if (fd >= 0) { ::close(fd); }
+        consumed[slot] = true;
+        consumer(path, path_id, file_size, header);
+    };
+    // the files not handed to the consumer yet are read the slow way, and io_uring is given up on
+    auto give_up = [&] {
+        active = false;
+        for (unsigned slot = 0; slot < pending.size(); slot++) {
+            const auto & [path, path_id, file_size] = pending[slot];
+            if (! consumed[slot]) { consumer(path, path_id, file_size, read_image_header(path)); }
+        }
+        pending.clear();
+    };
+
+    for (unsigned slot = 0; slot < pending.size(); slot++) {
+        // the ring holds a whole batch, but entries the kernel hasn't taken yet (after a short submit)
+        // may still fill it: those are submitted first, which frees their entries
+        while (! queue_chain(slot, pending[slot].path.c_str(), true)) {
+            if (ring.submit_and_wait(0) <= 0) {
+                give_up();
+                return;
+            }
+            n_completed += ring.drain_completions(complete);
+        }
+    }
+    if (ring.submit_and_wait(0) < 0) {
+        give_up();
+        return;
+    }
+
+    // the slots (buffers and descriptors) can only be reused once every operation has completed
+    while (true) {
+        n_completed += ring.drain_completions(complete);
+        if (n_completed >= n_expected) { break; }
+        if (ring.submit_and_wait(1) < 0) {
+            give_up();
+            return;
+        }
+    }
+    pending.clear();
+#endif
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "imageHeader.h"
+#include "ioUring.h"
+#include "pathTable.h"
+
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+constexpr unsigned IMAGE_BATCH_SIZE = 64; // files whose headers are read per submission
+
+/**
+ * @brief Reads the headers of image candidates in batches through io_uring, instead of one open,
+ *        read and close after another.
+ *
+ * Each file gets a linked open -> read -> close chain: the open fills a direct descriptor (so no
+ * regular file descriptor is ever created), the read lands in a slot of one registered buffer, and
+ * the close is hard-linked so that it runs even when the read fails or comes up short. Headers are
+ * parsed as the reads complete, and handed to the consumer along with their path, its ID in the
+ * scan's PathTable and the file size. Without io_uring (e.g. on other systems than Linux), the
+ * headers of a batch are read one after another.
+ */
+class ImageBatcher {
+public:
+    using Consumer = std::function<void(const std::string & path, PathId path_id, long file_size, std::optional<ImageHeader> header)>;
+
+    explicit ImageBatcher(Consumer consumer) : consumer(std::move(consumer)) {}
+
+    bool start();
+    void add(const std::string & path, PathId path_id, long file_size);
+    void flush();
+
+private:
+    struct PendingImage {
+        std::string path;
+        PathId path_id;
+        long file_size;
+    };
+
+    void flush_synchronously();
+#ifdef __linux__
+    bool queue_chain(unsigned slot, const char * path, bool read);
+    bool supports_direct_open();
+#endif
+
+    Consumer consumer;
+#ifdef __linux__
+    IoUring ring;
+#endif
+    bool active = false;
+    std::vector<unsigned char> buffers; // IMAGE_HEADER_SIZE bytes per slot
+    std::vector<PendingImage> pending;
+};
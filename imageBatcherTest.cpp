@@ -0,0 +1,62 @@
+#include "imageBatcher.h"
+#include "testing.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// more than two batches, so that a full batch is read, then another, then a partial one on flush
+constexpr unsigned N_BATCHED_FILES = 2 * IMAGE_BATCH_SIZE + IMAGE_BATCH_SIZE / 3;
+
+/**
+ * @brief Writes a GIF header whose width is the file's number, so that each result can be matched
+ *        with its file.
+ */
+static void write_numbered_gif(const std::string & path, unsigned number)
+{
+    std::string header = "GIF89a";
+    header += { static_cast<char>(number & 0xFF), static_cast<char>(number >> 8), '\x01', '\0' };
+    std::ofstream(path, std::ios::binary) << header;
+}
+
+TEST_CASE(image_batcher_hands_over_every_file_once)
+{
+    char directory[] = "/tmp/imageBatcherTestXXXXXX";
+    CHECK(mkdtemp(directory) != nullptr);
+    std::vector<std::string> paths;
+    for (unsigned i = 0; i < N_BATCHED_FILES; i++) {
+        paths.push_back(std::string(directory) + "/" + std::to_string(i) + (i % 7 == 0 ? ".txt" : ".gif"));
+        if (i % 7 == 0) {
+            std::ofstream(paths.back()) << "not an image\n";
+        } else {
+            write_numbered_gif(paths.back(), i + 1);
+        }
+    }
+    // a file that is gone by the time the batch is read fails its open, and must still be handed over
+    paths.push_back(std::string(directory) + "/missing.gif");
+
+    // with io_uring where the kernel has it, and the slow way in any case
+    for (bool use_ring : { true, false }) {
+        std::map<PathId, int> n_handed;
+        bool all_match = true;
+        ImageBatcher batcher([&](const std::string & path, PathId path_id, long file_size, std::optional<ImageHeader> header) {
+            n_handed[path_id]++;
+            bool is_image = path_id % 7 != 0 && path_id < N_BATCHED_FILES;
+            all_match = all_match && path == paths[path_id] && file_size == static_cast<long>(path_id)
+                && header.has_value() == is_image && (! header || header->width == static_cast<long>(path_id) + 1);
+        });
+        if (use_ring) { batcher.start(); }
+        for (unsigned i = 0; i < paths.size(); i++) { batcher.add(paths[i], i, i); }
+        batcher.flush();
+        CHECK(n_handed.size() == paths.size());
+        CHECK(std::all_of(n_handed.begin(), n_handed.end(), [](const auto & entry) { return entry.second == 1; }));
+        CHECK(all_match);
+    }
+
+    for (unsigned i = 0; i < N_BATCHED_FILES; i++) { unlink(paths[i].c_str()); }
+    rmdir(directory);
+}
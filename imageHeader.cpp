@@ -0,0 +1,456 @@
+#include "imageHeader.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <string_view>
+#include <vector>
+
+constexpr unsigned char PNG_SIGNATURE[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+constexpr size_t PNG_IHDR_WIDTH_OFFSET = 16;
+constexpr size_t PNG_IHDR_HEIGHT_OFFSET = 20;
+
+constexpr size_t GIF_WIDTH_OFFSET = 6;
+constexpr size_t GIF_HEIGHT_OFFSET = 8;
+
+constexpr size_t BMP_DIB_SIZE_OFFSET = 14;
+constexpr size_t BMP_WIDTH_OFFSET = 18;
+constexpr uint32_t BMP_CORE_HEADER_SIZE = 12; // OS/2 headers store 16-bit dimensions
+constexpr size_t BMP_CORE_HEIGHT_OFFSET = 20;
+constexpr size_t BMP_INFO_HEIGHT_OFFSET = 22;
+constexpr uint32_t BMP_DIB_HEADER_SIZES[] = { 12, 16, 40, 52, 56, 64, 108, 124 };
+
+constexpr unsigned char JPEG_MARKER = 0xFF;
+constexpr unsigned char JPEG_SOI = 0xD8;
+constexpr unsigned char JPEG_SOF_FIRST = 0xC0;
+constexpr unsigned char JPEG_SOF_LAST = 0xCF;
+constexpr unsigned char JPEG_DHT = 0xC4; // in the SOF range, but not a frame header
+constexpr unsigned char JPEG_JPG = 0xC8;
+constexpr unsigned char JPEG_DAC = 0xCC;
+constexpr unsigned char JPEG_SOS = 0xDA;
+constexpr unsigned char JPEG_RST_FIRST = 0xD0;
+constexpr unsigned char JPEG_RST_LAST = 0xD7;
+constexpr unsigned char JPEG_TEM = 0x01;
+constexpr size_t JPEG_SOF_HEIGHT_OFFSET = 5; // from the marker
+constexpr size_t JPEG_SOF_WIDTH_OFFSET = 7;
+constexpr size_t JPEG_MAX_READS = 1024; // markers read past the bytes given, one small read each
+
+constexpr size_t WEBP_CHUNK_OFFSET = 12;
+constexpr size_t WEBP_VP8_DIMENSIONS_OFFSET = 26;
+constexpr size_t WEBP_VP8L_DIMENSIONS_OFFSET = 21;
+constexpr size_t WEBP_VP8X_DIMENSIONS_OFFSET = 24;
+constexpr uint32_t WEBP_VP8_DIMENSION_MASK = 0x3FFF;
+
+constexpr size_t TIFF_IFD_OFFSET_OFFSET = 4;
+constexpr size_t TIFF_ENTRY_SIZE = 12;
+constexpr size_t TIFF_MAX_ENTRIES = 1024; // at most 12 KB of directory is ever read
+constexpr uint16_t TIFF_IMAGE_WIDTH = 256;
+constexpr uint16_t TIFF_IMAGE_LENGTH = 257;
+constexpr uint16_t TIFF_SHORT = 3;
+constexpr uint16_t TIFF_LONG = 4;
+
+constexpr size_t ICO_COUNT_OFFSET = 4;
+constexpr size_t ICO_ENTRIES_OFFSET = 6;
+constexpr size_t ICO_ENTRY_SIZE = 16;
+constexpr uint32_t ICO_FULL_SIZE = 256; // stored as 0, since the sizes are single bytes
+
+constexpr size_t PSD_VERSION_OFFSET = 4;
+constexpr size_t PSD_HEIGHT_OFFSET = 14;
+constexpr size_t PSD_WIDTH_OFFSET = 18;
+
+constexpr size_t BOX_HEADER_SIZE = 8;
+constexpr size_t BOX_LARGE_HEADER_SIZE = 16;
+constexpr size_t FULL_BOX_HEADER_SIZE = 4; // version and flags, after the box header
+constexpr size_t FTYP_MAJOR_BRAND_OFFSET = 8;
+constexpr int MAX_BOX_DEPTH = 4;
+
+constexpr size_t SVG_SCAN_SIZE = 4096; // the root element must start within this many bytes
+constexpr std::string_view UTF8_BOM = "\xEF\xBB\xBF";
+constexpr std::string_view SVG_SPACE = " \t\r\n"; // what XML counts as white space
+constexpr std::string_view SVG_SPACE_OR_EQUALS = " \t\r\n=";
+
+static uint32_t read_be16(const unsigned char * p) { return (p[0] << 8) | p[1]; }
+static uint32_t read_be32(const unsigned char * p) { return (uint32_t(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3]; }
+static uint32_t read_le16(const unsigned char * p) { return p[0] | (p[1] << 8); }
+static uint32_t read_le24(const unsigned char * p) { return p[0] | (p[1] << 8) | (p[2] << 16); }
+static uint32_t read_le32(const unsigned char * p) { return p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t(p[3]) << 24); }
+static uint64_t read_be64(const unsigned char * p) { return (uint64_t(read_be32(p)) << 32) | read_be32(p + 4); }
+
+static bool starts_with(const unsigned char * data, size_t size, const void * prefix, size_t prefix_size)
+{
+    return size >= prefix_size && memcmp(data, prefix, prefix_size) == 0;
+}
+
+static std::optional<ImageHeader> parse_png(const unsigned char * data, size_t size)
+{
+    if (size < PNG_IHDR_HEIGHT_OFFSET + 4) { return std::nullopt; }
+    return ImageHeader{ "PNG", read_be32(data + PNG_IHDR_WIDTH_OFFSET), read_be32(data + PNG_IHDR_HEIGHT_OFFSET) };
+}
+
+static std::optional<ImageHeader> parse_gif(const unsigned char * data, size_t size)
+{
+    if (size < GIF_HEIGHT_OFFSET + 2) { return std::nullopt; }
+    return ImageHeader{ "GIF", read_le16(data + GIF_WIDTH_OFFSET), read_le16(data + GIF_HEIGHT_OFFSET) };
+}
+
+static std::optional<ImageHeader> parse_bmp(const unsigned char * data, size_t size)
+{
+    if (size < BMP_INFO_HEIGHT_OFFSET + 4) { return std::nullopt; }
+    // "BM" alone is too common a start for a text file, so the DIB header size must be a known one
+    uint32_t dib_size = read_le32(data + BMP_DIB_SIZE_OFFSET);
+    if (std::find(std::begin(BMP_DIB_HEADER_SIZES), std::end(BMP_DIB_HEADER_SIZES), dib_size) == std::end(BMP_DIB_HEADER_SIZES)) {
+        return std::nullopt;
+    }
+    if (dib_size == BMP_CORE_HEADER_SIZE) {
+        return ImageHeader{ "BMP", read_le16(data + BMP_WIDTH_OFFSET), read_le16(data + BMP_CORE_HEIGHT_OFFSET) };
+    }
+    // a negative height means the rows are stored top-down
+    long width = static_cast<int32_t>(read_le32(data + BMP_WIDTH_OFFSET));
+    long height = static_cast<int32_t>(read_le32(data + BMP_INFO_HEIGHT_OFFSET));
+    return ImageHeader{ "BMP", width, labs(height) };
+}
+
+/**
+ * @brief Walks the JPEG segments up to the first frame header, which holds the dimensions. Metadata
+ *        segments (Exif thumbnails, ICC profiles, XMP) may push it past the bytes given, in which
+ *        case the walk goes on through `read_at`, reading only the markers and not the segments.
+ */
+static std::optional<ImageHeader> parse_jpeg(const unsigned char * data, size_t size, const ImageReader & read_at)
+{
+    // the bytes at a marker, from the bytes given or read from the file
+    unsigned char marker_bytes[JPEG_SOF_WIDTH_OFFSET + 2];
+    size_t n_reads = 0;
+    auto load = [&](uint64_t offset, size_t n_bytes) -> const unsigned char * {
+        if (offset + n_bytes <= size) { return data + offset; }
+        if (! read_at || n_reads++ == JPEG_MAX_READS || read_at(offset, marker_bytes, n_bytes) != n_bytes) { return nullptr; }
+        return marker_bytes;
+    };
+
+    uint64_t offset = 2;
+    while (const unsigned char * p = load(offset, 4)) {
+        if (p[0] != JPEG_MARKER) { return std::nullopt; }
+        unsigned char marker = p[1];
+        // markers may be padded with any number of 0xFF bytes
+        if (marker == JPEG_MARKER) {
+            offset++;
+            continue;
+        }
+        if (marker >= JPEG_SOF_FIRST && marker <= JPEG_SOF_LAST && marker != JPEG_DHT && marker != JPEG_JPG &&
+            marker != JPEG_DAC) {
+            p = load(offset, JPEG_SOF_WIDTH_OFFSET + 2);
+            if (! p) { return std::nullopt; }
+            return ImageHeader{ "JPEG", read_be16(p + JPEG_SOF_WIDTH_OFFSET), read_be16(p + JPEG_SOF_HEIGHT_OFFSET) };
+        }
+        // the image data starts without a frame header having been seen
+        if (marker == JPEG_SOS) { return std::nullopt; }
+        // restart and TEM markers stand alone, without a length
+        if ((marker >= JPEG_RST_FIRST && marker <= JPEG_RST_LAST) || marker == JPEG_TEM) {
+            offset += 2;
+            continue;
+        }
+        offset += 2 + read_be16(p + 2);
+    }
+    return std::nullopt;
+}
+
+static std::optional<ImageHeader> parse_webp(const unsigned char * data, size_t size)
+{
+    if (size < WEBP_VP8_DIMENSIONS_OFFSET + 4) { return std::nullopt; }
+    const unsigned char * chunk = data + WEBP_CHUNK_OFFSET;
+    if (memcmp(chunk, "VP8 ", 4) == 0) {
+        return ImageHeader{ "WEBP",
+                            read_le16(data + WEBP_VP8_DIMENSIONS_OFFSET) & WEBP_VP8_DIMENSION_MASK,
+                            read_le16(data + WEBP_VP8_DIMENSIONS_OFFSET + 2) & WEBP_VP8_DIMENSION_MASK };
+    }
+    if (memcmp(chunk, "VP8L", 4) == 0) {
+        // 14 bits of width - 1 followed by 14 bits of height - 1, after a signature byte
+        uint32_t bits = read_le32(data + WEBP_VP8L_DIMENSIONS_OFFSET);
+        return ImageHeader{ "WEBP", long(bits & WEBP_VP8_DIMENSION_MASK) + 1, long((bits >> 14) & WEBP_VP8_DIMENSION_MASK) + 1 };
+    }
+    if (memcmp(chunk, "VP8X", 4) == 0 && size >= WEBP_VP8X_DIMENSIONS_OFFSET + 6) {
+        return ImageHeader{ "WEBP",
+                            long(read_le24(data + WEBP_VP8X_DIMENSIONS_OFFSET)) + 1,
+                            long(read_le24(data + WEBP_VP8X_DIMENSIONS_OFFSET + 3)) + 1 };
+    }
+    return std::nullopt;
+}
+
+/**
+ * @brief Reads the first image directory of a TIFF file for its width and height tags. The directory
+ *        may be anywhere in the file; if it lies past the bytes given, at most TIFF_MAX_ENTRIES
+ *        entries of it are read through `read_at`.
+ */
+static std::optional<ImageHeader> parse_tiff(const unsigned char * data, size_t size, const ImageReader & read_at)
+{
+    bool little_endian = data[0] == 'I';
+    auto read16 = [&](const unsigned char * p) { return little_endian ? read_le16(p) : read_be16(p); };
+    auto read32 = [&](const unsigned char * p) { return little_endian ? read_le32(p) : read_be32(p); };
+    if (size < TIFF_IFD_OFFSET_OFFSET + 4) { return std::nullopt; }
+    uint64_t ifd_offset = read32(data + TIFF_IFD_OFFSET_OFFSET);
+
+    // the entry count first, then only as many entries as it announces (within the limit)
+    std::vector<unsigned char> ifd(2 + TIFF_MAX_ENTRIES * TIFF_ENTRY_SIZE);
+    auto load = [&](size_t n_bytes) {
+        if (ifd_offset + n_bytes <= size) {
+            std::copy(data + ifd_offset, data + ifd_offset + n_bytes, ifd.begin());
+            return true;
+        }
+        return read_at && read_at(ifd_offset, ifd.data(), n_bytes) == n_bytes;
+    };
+    if (! load(2)) { return std::nullopt; }
+    size_t n_entries = std::min<size_t>(read16(ifd.data()), TIFF_MAX_ENTRIES);
+    if (! load(2 + n_entries * TIFF_ENTRY_SIZE)) { return std::nullopt; }
+
+    long width = 0, height = 0;
+    for (size_t i = 0; i < n_entries; i++) {
+        const unsigned char * entry = ifd.data() + 2 + i * TIFF_ENTRY_SIZE;
+        uint16_t tag = read16(entry);
+        uint16_t type = read16(entry + 2);
+        if (tag != TIFF_IMAGE_WIDTH && tag != TIFF_IMAGE_LENGTH) { continue; }
+        // a single value is stored in the entry itself, left-justified
+        long value = type == TIFF_SHORT ? read16(entry + 8) : type == TIFF_LONG ? read32(entry + 8) : 0;
+        (tag == TIFF_IMAGE_WIDTH ? width : height) = value;
+    }
+    return ImageHeader{ "TIFF", width, height };
+}
+
+/**
+ * @brief Reads the size of the first image of an icon (or cursor) file.
+ */
+static std::optional<ImageHeader> parse_ico(const unsigned char * data, size_t size)
+{
+    if (size < ICO_ENTRIES_OFFSET + ICO_ENTRY_SIZE) { return std::nullopt; }
+    // the header is only 4 bytes of magic, so the first entry has to look sane too
+    const unsigned char * entry = data + ICO_ENTRIES_OFFSET;
+    if (read_le16(data + ICO_COUNT_OFFSET) == 0 || entry[3] != 0) { return std::nullopt; }
+    return ImageHeader{ "ICO", entry[0] ? entry[0] : ICO_FULL_SIZE, entry[1] ? entry[1] : ICO_FULL_SIZE };
+}
+
+static std::optional<ImageHeader> parse_psd(const unsigned char * data, size_t size)
+{
+    if (size < PSD_WIDTH_OFFSET + 4) { return std::nullopt; }
+    // version 2 is the large document format (PSB), with the same header
+    uint32_t version = read_be16(data + PSD_VERSION_OFFSET);
+    if (version != 1 && version != 2) { return std::nullopt; }
+    return ImageHeader{ "PSD", read_be32(data + PSD_WIDTH_OFFSET), read_be32(data + PSD_HEIGHT_OFFSET) };
+}
+
+/**
+ * @brief Looks for image spatial extents ('ispe') in the boxes between `begin` and `end`, descending
+ *        into the boxes that can hold them (meta, iprp, ipco). Several images (thumbnails, grid
+ *        tiles) may have one, so the largest is kept, which is the primary image in practice.
+ */
+static void find_ispe(const unsigned char * begin, const unsigned char * end, int depth, ImageHeader & header)
+{
+    const unsigned char * box = begin;
+    while (end - box >= static_cast<ptrdiff_t>(BOX_HEADER_SIZE)) {
+        uint64_t box_size = read_be32(box);
+        size_t header_size = BOX_HEADER_SIZE;
+        if (box_size == 1) {
+            if (end - box < static_cast<ptrdiff_t>(BOX_LARGE_HEADER_SIZE)) { return; }
+            box_size = read_be64(box + BOX_HEADER_SIZE);
+            header_size = BOX_LARGE_HEADER_SIZE;
+        } else if (box_size == 0) {
+            box_size = end - box; // the box runs to the end of its parent
+        }
+        if (box_size < header_size) { return; }
+        // a box cut off by the end of the bytes given is still searched as far as it goes
+        const unsigned char * box_end = box_size > static_cast<uint64_t>(end - box) ? end : box + box_size;
+        std::string_view type(reinterpret_cast<const char *>(box + 4), 4);
+
+        if (type == "ispe" && box_end - box >= static_cast<ptrdiff_t>(header_size + FULL_BOX_HEADER_SIZE + 8)) {
+            const unsigned char * extents = box + header_size + FULL_BOX_HEADER_SIZE;
+            long width = read_be32(extents), height = read_be32(extents + 4);
+            if (pixel_count(width, height) > pixel_count(header.width, header.height)) {
+                header.width = width;
+                header.height = height;
+            }
+        } else if (depth < MAX_BOX_DEPTH && (type == "meta" || type == "iprp" || type == "ipco")) {
+            size_t children_offset = header_size + (type == "meta" ? FULL_BOX_HEADER_SIZE : 0);
+            if (box_end - box > static_cast<ptrdiff_t>(children_offset)) { find_ispe(box + children_offset, box_end, depth + 1, header); }
+        }
+        if (box_end == end) { return; }
+        box = box_end;
+    }
+}
+
+/**
+ * @brief Reads the dimensions of a HEIF (HEIC) or AVIF image from its item properties. Only the
+ *        bytes given are searched, which hold the metadata box in files written the usual way.
+ */
+static std::optional<ImageHeader> parse_isobmff(const unsigned char * data, size_t size)
+{
+    if (size < FTYP_MAJOR_BRAND_OFFSET + 4) { return std::nullopt; }
+    std::string_view brand(reinterpret_cast<const char *>(data + FTYP_MAJOR_BRAND_OFFSET), 4);
+    const char * format;
+    if (brand == "avif" || brand == "avis") {
+        format = "AVIF";
+    } else if (brand == "heic" || brand == "heix" || brand == "heim" || brand == "heis" || brand == "mif1" || brand == "msf1") {
+        format = "HEIC";
+    } else {
+        return std::nullopt; // other ISO media files (MP4, MOV, ...) are not images
+    }
+    ImageHeader header{ format, 0, 0 };
+    find_ispe(data, data + size, 0, header);
+    return header;
+}
+
+/**
+ * @brief Finds an attribute of an SVG root element. The attributes are walked one by one, so that a
+ *        name inside another attribute's value (e.g. data-x=' width="5"') isn't taken for one.
+ * @return The value, without its quotes, or null if the attribute is missing or the tag malformed.
+ */
+static std::optional<std::string_view> svg_attribute(std::string_view tag, std::string_view name)
+{
+    auto skip_space = [&](size_t at) { return std::min(tag.find_first_not_of(SVG_SPACE, at), tag.size()); };
+    size_t at = skip_space(tag.find_first_of(SVG_SPACE)); // past "<svg"
+    while (at < tag.size()) {
+        size_t name_end = std::min(tag.find_first_of(SVG_SPACE_OR_EQUALS, at), tag.size());
+        std::string_view attribute = tag.substr(at, name_end - at);
+        at = skip_space(name_end);
+        if (at == tag.size() || tag[at] != '=') { return std::nullopt; }
+        at = skip_space(at + 1);
+        if (at == tag.size() || (tag[at] != '"' && tag[at] != '\'')) { return std::nullopt; }
+        size_t close = tag.find(tag[at], at + 1);
+        if (close == std::string_view::npos) { return std::nullopt; }
+        if (attribute == name) { return tag.substr(at + 1, close - at - 1); }
+        at = skip_space(close + 1);
+    }
+    return std::nullopt;
+}
+
+/**
+ * @brief Reads a length attribute of an SVG root element, in pixels.
+ * @return The length, or 0 if it is missing or in units that depend on the rendering (%, em, ...).
+ */
+static double svg_length(std::string_view tag, std::string_view name)
+{
+    std::optional<std::string_view> value = svg_attribute(tag, name);
+    if (! value) { return 0; }
+    std::string text(*value);
+    char * unit;
+    double length = strtod(text.c_str(), &unit);
+    std::string_view suffix(unit);
+    return suffix.empty() || suffix == "px" ? length : 0;
+}
+
+/**
+ * @brief Reads the size of an SVG image from the width and height attributes of its root element,
+ *        falling back to its viewBox. The root element must start within SVG_SCAN_SIZE bytes, after
+ *        only an XML declaration, comments or a doctype, so that e.g. an HTML page embedding an SVG
+ *        is not taken for one.
+ */
+static std::optional<ImageHeader> parse_svg(const unsigned char * data, size_t size)
+{
+    std::string_view text(reinterpret_cast<const char *>(data), std::min(size, SVG_SCAN_SIZE));
+    size_t at = text.substr(0, UTF8_BOM.size()) == UTF8_BOM ? UTF8_BOM.size() : 0;
+    while (true) {
+        while (at < text.size() && isspace(static_cast<unsigned char>(text[at]))) { at++; }
+        std::string_view rest = text.substr(at);
+        std::string_view terminator;
+        if (rest.substr(0, 2) == "<?") {
+            terminator = "?>";
+        } else if (rest.substr(0, 4) == "<!--") {
+            terminator = "-->";
+        } else if (rest.substr(0, 2) == "<!") {
+            terminator = ">";
+        } else {
+            break;
+        }
+        size_t end = rest.find(terminator);
+        if (end == std::string_view::npos) { return std::nullopt; }
+        at += end + terminator.size();
+    }
+
+    std::string_view rest = text.substr(at);
+    if (rest.size() < 5 || rest.substr(0, 4) != "<svg" || ! (isspace(static_cast<unsigned char>(rest[4])) || rest[4] == '>')) {
+        return std::nullopt;
+    }
+    size_t tag_end = rest.find('>');
+    if (tag_end == std::string_view::npos) { return std::nullopt; }
+    std::string_view tag = rest.substr(0, tag_end);
+
+    double width = svg_length(tag, "width");
+    double height = svg_length(tag, "height");
+    if (width <= 0 || height <= 0) {
+        std::optional<std::string_view> view_box = svg_attribute(tag, "viewBox");
+        if (! view_box) { return std::nullopt; }
+        std::string values(*view_box);
+        double min_x, min_y;
+        if (sscanf(values.c_str(), "%lf%*[ ,]%lf%*[ ,]%lf%*[ ,]%lf", &min_x, &min_y, &width, &height) != 4) { return std::nullopt; }
+    }
+    // checked before rounding, which is undefined for values out of range (NaN included)
+    if (! (width <= MAX_IMAGE_DIMENSION && height <= MAX_IMAGE_DIMENSION)) { return std::nullopt; }
+    return ImageHeader{ "SVG", std::lround(width), std::lround(height) };
+}
+
+/**
+ * @brief Reads an image's format and dimensions from the start of its file, without decoding it.
+ *        Understands PNG, GIF, BMP, JPEG, WebP, TIFF, ICO, PSD, HEIC, AVIF and SVG.
+ * @param data The first bytes of the file (up to IMAGE_HEADER_SIZE are useful).
+ * @param size The number of bytes available.
+ * @param read_at Reads further into the file, for the formats whose dimensions may be stored past
+ *        the first bytes (TIFF, and JPEG after large metadata); without it, only the bytes given are looked at.
+ * @return The format and dimensions, or null if the bytes are not a recognized image (or the header
+ *         doesn't fit in the bytes given).
+ */
+std::optional<ImageHeader> parse_image_header(const unsigned char * data, size_t size, const ImageReader & read_at)
+{
+    std::optional<ImageHeader> header;
+    if (starts_with(data, size, PNG_SIGNATURE, sizeof(PNG_SIGNATURE))) {
+        header = parse_png(data, size);
+    } else if (starts_with(data, size, "GIF87a", 6) || starts_with(data, size, "GIF89a", 6)) {
+        header = parse_gif(data, size);
+    } else if (starts_with(data, size, "BM", 2)) {
+        header = parse_bmp(data, size);
+    } else if (size >= 2 && data[0] == JPEG_MARKER && data[1] == JPEG_SOI) {
+        header = parse_jpeg(data, size, read_at);
+    } else if (starts_with(data, size, "RIFF", 4) && size >= 12 && memcmp(data + 8, "WEBP", 4) == 0) {
+        header = parse_webp(data, size);
+    } else if (starts_with(data, size, "II*\0", 4) || starts_with(data, size, "MM\0*", 4)) {
+        header = parse_tiff(data, size, read_at);
+    } else if (starts_with(data, size, "\0\0\1\0", 4)) {
+        header = parse_ico(data, size);
+    } else if (starts_with(data, size, "8BPS", 4)) {
+        header = parse_psd(data, size);
+    } else if (size >= 8 && memcmp(data + 4, "ftyp", 4) == 0) {
+        header = parse_isobmff(data, size);
+    } else if (size > 0 && (data[0] == '<' || data[0] == static_cast<unsigned char>(UTF8_BOM[0]) || isspace(data[0]))) {
+        header = parse_svg(data, size);
+    }
+
+    if (header && (header->width <= 0 || header->height <= 0)) { return std::nullopt; }
+    if (header && (header->width > MAX_IMAGE_DIMENSION || header->height > MAX_IMAGE_DIMENSION)) { return std::nullopt; }
+    return header;
+}
+
+/**
+ * @brief Reads an image's format and dimensions from its file: the first IMAGE_HEADER_SIZE bytes,
+ *        plus whatever parse_image_header() asks for further in.
+ * @param path The path to the file.
+ * @return The format and dimensions, or null if the file can't be read or is not a recognized image.
+ */
+std::optional<ImageHeader> read_image_header(const std::string & path)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) { return std::nullopt; }
+
+    // one buffer per thread, rather than one allocation per file scanned
+    static thread_local std::vector<unsigned char> header(IMAGE_HEADER_SIZE);
+    ssize_t n_read = pread(fd, header.data(), header.size(), 0);
+    auto read_at = [fd](uint64_t offset, unsigned char * buffer, size_t size) -> size_t {
+        ssize_t n_read_at = pread(fd, buffer, size, offset);
+        return n_read_at < 0 ? 0 : n_read_at;
+    };
+    auto image_header = n_read > 0 ? parse_image_header(header.data(), n_read, read_at) : std::nullopt;
+    close(fd);
+    return image_header;
+}
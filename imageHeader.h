@@ -0,0 +1,34 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+
+// the most of a file that is ever looked at to find an image's dimensions
+constexpr size_t IMAGE_HEADER_SIZE = 64 * 1024;
+// larger widths or heights in a header are taken for garbage (PSB, the largest format read, stops at 300000)
+constexpr long MAX_IMAGE_DIMENSION = 300000;
+
+struct ImageHeader {
+    const char * format; // format name as ImageMagick reports it (%m), e.g. "PNG"
+    long width, height;
+};
+
+// reads up to `size` bytes at `offset` of the image file into `buffer`, returning how many it read
+using ImageReader = std::function<size_t(uint64_t offset, unsigned char * buffer, size_t size)>;
+
+/**
+ * @brief Returns an image's number of pixels. It is computed in 64 bits, with each side clamped to
+ *        32 bits (what identify reports isn't bounded by MAX_IMAGE_DIMENSION), so it can't overflow.
+ */
+inline uint64_t pixel_count(long width, long height)
+{
+    auto side = [](long length) { return length <= 0 ? 0 : std::min<uint64_t>(length, UINT32_MAX); };
+    return side(width) * side(height);
+}
+
+std::optional<ImageHeader> parse_image_header(const unsigned char * data, size_t size, const ImageReader & read_at = nullptr);
+std::optional<ImageHeader> read_image_header(const std::string & path);
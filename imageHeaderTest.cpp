@@ -0,0 +1,287 @@
+#include "imageHeader.h"
+#include "testing.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// more metadata than the header buffer holds, as a camera's Exif thumbnail and an ICC profile can be
+constexpr size_t LARGE_METADATA_SIZE = 3 * IMAGE_HEADER_SIZE / 2;
+constexpr size_t MAX_SEGMENT_SIZE = 0xFFFF; // the length field includes itself
+
+static std::string le16(uint32_t value) { return { static_cast<char>(value & 0xFF), static_cast<char>((value >> 8) & 0xFF) }; }
+static std::string le32(uint32_t value) { return le16(value & 0xFFFF) + le16(value >> 16); }
+static std::string be16(uint32_t value) { return { static_cast<char>((value >> 8) & 0xFF), static_cast<char>(value & 0xFF) }; }
+static std::string be32(uint32_t value) { return be16(value >> 16) + be16(value & 0xFFFF); }
+
+static std::optional<ImageHeader> parse(const std::string & bytes)
+{
+    return parse_image_header(reinterpret_cast<const unsigned char *>(bytes.data()), bytes.size());
+}
+
+static bool has_header(const std::optional<ImageHeader> & header, const std::string & format, long width, long height)
+{
+    return header && header->format == format && header->width == width && header->height == height;
+}
+
+/**
+ * @brief Checks that every strict prefix of a minimal image file (one ending with the last byte its
+ *        dimensions need) is rejected rather than misread.
+ */
+static bool prefixes_rejected(const std::string & bytes)
+{
+    for (size_t size = 0; size < bytes.size(); size++) {
+        if (parse(bytes.substr(0, size))) { return false; }
+    }
+    return true;
+}
+
+// JPEG
+// ===================================================================================================================
+/**
+ * @brief Makes a JPEG file start: SOI, APP segments holding `metadata_size` bytes in all, then a
+ *        baseline frame header. Nothing after the frame header is looked at.
+ */
+static std::string jpeg_start(size_t metadata_size, uint16_t width, uint16_t height)
+{
+    std::string jpeg("\xFF\xD8", 2);
+    while (metadata_size > 0) {
+        size_t payload_size = std::min(metadata_size, MAX_SEGMENT_SIZE - 2);
+        jpeg += "\xFF\xE1" + be16(payload_size + 2) + std::string(payload_size, 'x');
+        metadata_size -= payload_size;
+    }
+    // a fill byte before the marker, which the walk has to skip wherever it falls
+    jpeg += std::string("\xFF\xFF\xC0", 3) + be16(17) + '\x08' + be16(height) + be16(width) + std::string("\x03", 1);
+    return jpeg;
+}
+
+TEST_CASE(image_header_jpeg_within_buffer)
+{
+    CHECK(has_header(parse(jpeg_start(100, 640, 480)), "JPEG", 640, 480));
+    CHECK(! parse(jpeg_start(100, 640, 480).substr(0, 110)));
+}
+
+TEST_CASE(image_header_jpeg_after_large_metadata)
+{
+    std::string jpeg = jpeg_start(LARGE_METADATA_SIZE, 4000, 3000);
+    CHECK(jpeg.size() > IMAGE_HEADER_SIZE);
+    // the frame header is past the bytes given, so it can only be found by reading further in
+    CHECK(! parse(jpeg.substr(0, IMAGE_HEADER_SIZE)));
+    auto read_at = [&](uint64_t offset, unsigned char * buffer, size_t size) -> size_t {
+        if (offset >= jpeg.size()) { return 0; }
+        return jpeg.copy(reinterpret_cast<char *>(buffer), size, offset);
+    };
+    // every split of the file, including through a marker
+    for (size_t size : { IMAGE_HEADER_SIZE, size_t(MAX_SEGMENT_SIZE + 2), size_t(MAX_SEGMENT_SIZE + 3), size_t(4) }) {
+        CHECK(has_header(parse_image_header(reinterpret_cast<const unsigned char *>(jpeg.data()), size, read_at), "JPEG", 4000, 3000));
+    }
+
+    char path[] = "/tmp/imageHeaderTestXXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    close(fd);
+    std::ofstream(path, std::ios::binary) << jpeg;
+    CHECK(has_header(read_image_header(path), "JPEG", 4000, 3000));
+    // a file cut off before the frame header is not an image
+    std::ofstream(path, std::ios::binary) << jpeg.substr(0, jpeg.size() - 8);
+    CHECK(! read_image_header(path));
+    unlink(path);
+}
+
+// TIFF
+// ===================================================================================================================
+/**
+ * @brief Makes a TIFF file whose first image directory is at `ifd_offset`, holding an unrelated tag,
+ *        the width as a SHORT and the height as a LONG.
+ */
+static std::string tiff(bool little_endian, uint32_t ifd_offset, uint16_t width, uint32_t height)
+{
+    auto u16 = little_endian ? le16 : be16;
+    auto u32 = little_endian ? le32 : be32;
+    std::string file = std::string(little_endian ? "II*\0" : "MM\0*", 4) + u32(ifd_offset);
+    file.resize(ifd_offset, '\0');
+    file += u16(3);
+    file += u16(254) + u16(4) + u32(1) + u32(0); // NewSubfileType
+    // a SHORT is left-justified in the 4-byte value field
+    file += u16(256) + u16(3) + u32(1) + u16(width) + u16(0);
+    file += u16(257) + u16(4) + u32(1) + u32(height);
+    return file;
+}
+
+TEST_CASE(image_header_tiff_byte_orders)
+{
+    CHECK(has_header(parse(tiff(true, 8, 640, 480)), "TIFF", 640, 480));
+    CHECK(has_header(parse(tiff(false, 8, 640, 70000)), "TIFF", 640, 70000));
+    CHECK(prefixes_rejected(tiff(true, 8, 640, 480)));
+    CHECK(prefixes_rejected(tiff(false, 8, 640, 480)));
+}
+
+TEST_CASE(image_header_tiff_directory_past_buffer)
+{
+    // writers may put the directory after the image data, far past the bytes read up front
+    for (bool little_endian : { true, false }) {
+        std::string file = tiff(little_endian, IMAGE_HEADER_SIZE + 1000, 4000, 3000);
+        std::string start = file.substr(0, IMAGE_HEADER_SIZE);
+        auto read_at = [&](uint64_t offset, unsigned char * buffer, size_t size) -> size_t {
+            if (offset >= file.size()) { return 0; }
+            return file.copy(reinterpret_cast<char *>(buffer), size, offset);
+        };
+        auto data = reinterpret_cast<const unsigned char *>(start.data());
+        CHECK(has_header(parse_image_header(data, start.size(), read_at), "TIFF", 4000, 3000));
+        CHECK(! parse_image_header(data, start.size()));
+
+        // a directory cut off by the end of the file is rejected
+        file.resize(file.size() - 3);
+        CHECK(! parse_image_header(data, start.size(), read_at));
+    }
+}
+
+// ICO, PSD
+// ===================================================================================================================
+static std::string ico(uint8_t width, uint8_t height)
+{
+    return std::string("\0\0\1\0", 4) + le16(1) + std::string{ static_cast<char>(width), static_cast<char>(height), 0, 0 }
+        + le16(1) + le16(32) + le32(1000) + le32(22);
+}
+
+TEST_CASE(image_header_ico)
+{
+    CHECK(has_header(parse(ico(16, 32)), "ICO", 16, 32));
+    // sizes are single bytes, so 256 is stored as 0
+    CHECK(has_header(parse(ico(0, 0)), "ICO", 256, 256));
+    CHECK(prefixes_rejected(ico(48, 48)));
+    // no images, or a reserved byte that isn't 0: something else that starts with the same 4 bytes
+    std::string empty = ico(16, 16);
+    empty[4] = 0;
+    CHECK(! parse(empty));
+    std::string reserved = ico(16, 16);
+    reserved[9] = 1;
+    CHECK(! parse(reserved));
+}
+
+static std::string psd(uint16_t version, uint32_t width, uint32_t height)
+{
+    return "8BPS" + be16(version) + std::string(6, '\0') + be16(3) + be32(height) + be32(width);
+}
+
+TEST_CASE(image_header_psd)
+{
+    CHECK(has_header(parse(psd(1, 1920, 1080)), "PSD", 1920, 1080));
+    // the large document format (PSB) has the same header
+    CHECK(has_header(parse(psd(2, 120000, 90000)), "PSD", 120000, 90000));
+    CHECK(has_header(parse(psd(2, 300000, 300000)), "PSD", 300000, 300000));
+    // past what PSB allows, the size is garbage
+    CHECK(! parse(psd(2, 300001, 1080)));
+    CHECK(! parse(psd(2, 1920, 0xFFFFFFFF)));
+    CHECK(! parse(psd(3, 1920, 1080)));
+    CHECK(prefixes_rejected(psd(1, 1920, 1080)));
+}
+
+// HEIF, AVIF
+// ===================================================================================================================
+static std::string box(const std::string & type, const std::string & payload)
+{
+    return be32(8 + payload.size()) + type + payload;
+}
+
+static std::string full_box(const std::string & type, const std::string & payload)
+{
+    return box(type, std::string(4, '\0') + payload);
+}
+
+static std::string ispe(uint32_t width, uint32_t height)
+{
+    return full_box("ispe", be32(width) + be32(height));
+}
+
+/**
+ * @brief Makes the start of a HEIF file: ftyp, then meta holding a handler and the item properties.
+ */
+static std::string heif(const std::string & brand, const std::string & properties)
+{
+    std::string ftyp = box("ftyp", brand + be32(0) + "mif1" + brand);
+    std::string hdlr = full_box("hdlr", be32(0) + "pict" + std::string(13, '\0'));
+    return ftyp + full_box("meta", hdlr + box("iprp", box("ipco", properties)));
+}
+
+TEST_CASE(image_header_heif_nested_ispe)
+{
+    // ispe is only found nested in meta/iprp/ipco, among other properties
+    std::string colour = box("colr", "nclx" + std::string(7, '\0'));
+    CHECK(has_header(parse(heif("heic", colour + ispe(4032, 3024))), "HEIC", 4032, 3024));
+    CHECK(has_header(parse(heif("avif", ispe(1920, 1080) + colour)), "AVIF", 1920, 1080));
+    // a thumbnail has its own, smaller extents, before or after the primary image's
+    CHECK(has_header(parse(heif("heic", ispe(320, 240) + ispe(4032, 3024))), "HEIC", 4032, 3024));
+    CHECK(has_header(parse(heif("mif1", ispe(4032, 3024) + ispe(320, 240))), "HEIC", 4032, 3024));
+
+    // an ispe outside of ipco isn't the image's
+    std::string ftyp = box("ftyp", "heic" + be32(0));
+    CHECK(! parse(ftyp + box("free", ispe(640, 480))));
+    // other ISO media files are not images
+    CHECK(! parse(box("ftyp", "isom" + be32(0)) + full_box("meta", box("iprp", box("ipco", ispe(640, 480))))));
+    CHECK(prefixes_rejected(heif("heic", ispe(4032, 3024))));
+}
+
+TEST_CASE(image_header_heif_huge_ispe)
+{
+    // the largest extents are taken without overflowing, then rejected as garbage
+    CHECK(! parse(heif("heic", ispe(4032, 3024) + ispe(0xFFFFFFFF, 0xFFFFFFFF))));
+    CHECK(! parse(heif("heic", ispe(0xFFFFFFFF, 0xFFFFFFFF) + ispe(4032, 3024))));
+    CHECK(! parse(heif("heic", ispe(0x80000000, 2) + ispe(4032, 3024))));
+}
+
+TEST_CASE(image_header_pixel_count)
+{
+    CHECK(pixel_count(4032, 3024) == 4032u * 3024u);
+    CHECK(pixel_count(0, 3024) == 0 && pixel_count(-5, 3024) == 0);
+    // identify's sizes aren't bounded, so each side is clamped to 32 bits
+    CHECK(pixel_count(LONG_MAX, LONG_MAX) == uint64_t(UINT32_MAX) * UINT32_MAX);
+    CHECK(pixel_count(LONG_MAX, 2) > pixel_count(UINT32_MAX - 1L, 2));
+}
+
+// SVG
+// ===================================================================================================================
+TEST_CASE(image_header_svg)
+{
+    CHECK(has_header(parse("<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"120\" height='80px'>"), "SVG", 120, 80));
+    // only an XML declaration, comments and a doctype may come first
+    CHECK(has_header(parse("\xEF\xBB\xBF<?xml version=\"1.0\"?>\n<!-- drawn by hand -->\n<!DOCTYPE svg>\n"
+                           "<svg width=\"10.6\" height=\"20\">"),
+                     "SVG", 11, 20));
+    CHECK(! parse("<html><svg width=\"10\" height=\"20\"></svg></html>"));
+    // "stroke-width" isn't "width"
+    CHECK(has_header(parse("<svg stroke-width=\"3\" viewBox=\"0 0 64 48\">"), "SVG", 64, 48));
+    CHECK(prefixes_rejected("<svg width=\"10\" height=\"20\">"));
+}
+
+TEST_CASE(image_header_svg_view_box_and_units)
+{
+    // sizes relative to the page or the font fall back to the viewBox, with either separator
+    CHECK(has_header(parse("<svg width=\"100%\" height=\"100%\" viewBox=\"0 0 300 150\">"), "SVG", 300, 150));
+    CHECK(has_header(parse("<svg width=\"2em\" height=\"1em\" viewBox=\"-5,-5,24,12\">"), "SVG", 24, 12));
+    CHECK(has_header(parse("<svg viewBox=\"0 0 640 480\">"), "SVG", 640, 480));
+    // and without one there is no size
+    CHECK(! parse("<svg width=\"100%\" height=\"100%\">"));
+    CHECK(! parse("<svg width=\"2em\" height=\"10\">"));
+    CHECK(! parse("<svg>"));
+}
+
+TEST_CASE(image_header_svg_attribute_syntax)
+{
+    // XML allows white space around '='
+    CHECK(has_header(parse("<svg width = \"10\" height =\n'20'>"), "SVG", 10, 20));
+    CHECK(has_header(parse("<svg\tviewBox = \"0 0 30 40\">"), "SVG", 30, 40));
+    // a name inside another attribute's value isn't an attribute
+    CHECK(has_header(parse("<svg data-x=' width=\"5\"' width=\"10\" height=\"7\">"), "SVG", 10, 7));
+    CHECK(! parse("<svg data-x='width=\"5\" height=\"5\"'>"));
+    // neither are unquoted values
+    CHECK(! parse("<svg width=10 height=20>"));
+    // sizes past what any raster format allows are garbage
+    CHECK(! parse("<svg width=\"1e300\" height=\"10\">"));
+    CHECK(! parse("<svg viewBox=\"0 0 nan 10\">"));
+    CHECK(! parse("<svg width=\"300001\" height=\"10\">"));
+}
@@ -0,0 +1,95 @@
+#include "imageStats.h"
+#include "imageHeader.h"
+
+#include <algorithm>
+
+constexpr double PIXELS_PER_MEGAPIXEL = 1e6;
+
+static uint64_t pixel_count(const SmallImage & image)
+{
+    return pixel_count(image.width, image.height);
+}
+
+/**
+ * @brief Returns the log2 bucket of an image side.
+ * @param length The width or height, in pixels (at least 1).
+ * @return floor(log2(length)), capped at the last bucket.
+ */
+int image_size_bucket(long length)
+{
+    int bucket = 63 - __builtin_clzl(static_cast<unsigned long>(std::max(length, 1L)));
+    return std::min(bucket, IMAGE_SIZE_BUCKETS - 1);
+}
+
+void ImageStats::keep_if_small(PathId path, const std::string & format, long width, long height)
+{
+    if (n_smallest == 0 || pixel_count(width, height) > max_candidate_pixels) { return; }
+    candidates.push_back(SmallImage{ path, width, height, format });
+    // dropping only once the list has doubled keeps the work linear, even when many images tie
+    if (candidates.size() >= 2 * std::max(n_smallest, n_kept_candidates)) { drop_larger_candidates(); }
+}
+
+/**
+ * @brief Keeps only the candidates no larger than the n-th smallest, ties included.
+ */
+void ImageStats::drop_larger_candidates()
+{
+    if (candidates.size() <= n_smallest) { return; }
+    auto smaller = [](const SmallImage & image1, const SmallImage & image2) { return pixel_count(image1) < pixel_count(image2); };
+    std::nth_element(candidates.begin(), candidates.begin() + n_smallest - 1, candidates.end(), smaller);
+    max_candidate_pixels = pixel_count(candidates[n_smallest - 1]);
+    candidates.erase(std::remove_if(candidates.begin(), candidates.end(), [&](const SmallImage & image) {
+        return pixel_count(image) > max_candidate_pixels;
+    }), candidates.end());
+    n_kept_candidates = candidates.size();
+}
+
+/**
+ * @brief Adds an image.
+ * @param path The ID of the image's path.
+ * @param format Its format, as ImageMagick names it (e.g. "PNG").
+ * @param width Its width, in pixels.
+ * @param height Its height, in pixels.
+ * @param bytes The size of its file.
+ */
+void ImageStats::add(PathId path, const std::string & format, long width, long height, long bytes)
+{
+    double megapixels = width * static_cast<double>(height) / PIXELS_PER_MEGAPIXEL;
+    ImageFormatStats & format_stats = by_format[format];
+    format_stats.count++;
+    format_stats.bytes += bytes;
+    format_stats.megapixels += megapixels;
+    total_megapixels += megapixels;
+    histogram[image_size_bucket(width)][image_size_bucket(height)]++;
+    keep_if_small(path, format, width, height);
+}
+
+/**
+ * @brief Adds another population's statistics to these.
+ * @param other The statistics to merge in.
+ */
+void ImageStats::merge(const ImageStats & other)
+{
+    for (auto & [format, other_stats] : other.by_format) {
+        ImageFormatStats & format_stats = by_format[format];
+        format_stats.count += other_stats.count;
+        format_stats.bytes += other_stats.bytes;
+        format_stats.megapixels += other_stats.megapixels;
+    }
+    total_megapixels += other.total_megapixels;
+    for (int w = 0; w < IMAGE_SIZE_BUCKETS; w++) {
+        for (int h = 0; h < IMAGE_SIZE_BUCKETS; h++) { histogram[w][h] += other.histogram[w][h]; }
+    }
+    for (auto & image : other.candidates) { keep_if_small(image.path, image.format, image.width, image.height); }
+}
+
+/**
+ * @brief Returns the candidates for the smallest images: the n smallest by pixel count, plus any
+ *        others tied with the n-th, since ties are broken by path.
+ */
+std::vector<SmallImage> ImageStats::smallest() const
+{
+    ImageStats trimmed = *this;
+    trimmed.drop_larger_candidates();
+    return trimmed.candidates;
+}
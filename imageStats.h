@@ -0,0 +1,66 @@
+#pragma once
+
+#include "pathTable.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+constexpr int IMAGE_SIZE_BUCKETS = 16; // log2 buckets per side: 1, 2-3, 4-7, ..., 16384 and up
+
+// the images of one format
+struct ImageFormatStats {
+    long count = 0;
+    long bytes = 0;
+    double megapixels = 0;
+};
+
+// an image kept among the smallest ones. Its path is only built if it makes it into the results.
+struct SmallImage {
+    PathId path;
+    long width, height;
+    std::string format;
+};
+
+using ImageSizeHistogram = std::array<std::array<long, IMAGE_SIZE_BUCKETS>, IMAGE_SIZE_BUCKETS>;
+
+/**
+ * @brief Statistics of a population of images, gathered one image at a time: counts, bytes and
+ *        megapixels per format, a histogram of dimensions in log2 buckets (width x height) and the
+ *        candidates for the smallest few images. Everything but the per-format table has a bounded
+ *        size (unless many images tie in size), and two ImageStats merge into the statistics of
+ *        both populations.
+ *
+ * Images are kept by PathId, so that only the candidates' paths ever have to be built. Ties in size
+ * are broken by path, so the candidates include every image tied with the n-th smallest.
+ */
+class ImageStats {
+public:
+    ImageStats() = default;
+    explicit ImageStats(size_t n_smallest) : n_smallest(n_smallest) {}
+
+    void add(PathId path, const std::string & format, long width, long height, long bytes);
+    void merge(const ImageStats & other);
+
+    const std::map<std::string, ImageFormatStats> & formats() const { return by_format; }
+    double megapixels() const { return total_megapixels; }
+    const ImageSizeHistogram & size_histogram() const { return histogram; }
+    std::vector<SmallImage> smallest() const;
+
+private:
+    void keep_if_small(PathId path, const std::string & format, long width, long height);
+    void drop_larger_candidates();
+
+    size_t n_smallest = 0;
+    std::map<std::string, ImageFormatStats> by_format;
+    double total_megapixels = 0;
+    ImageSizeHistogram histogram = {};
+    std::vector<SmallImage> candidates; // at most twice n_smallest, plus ties
+    uint64_t max_candidate_pixels = UINT64_MAX; // larger images can't be among the smallest any more
+    size_t n_kept_candidates = 0;               // how many the last drop left
+};
+
+int image_size_bucket(long length);
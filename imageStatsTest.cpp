@@ -0,0 +1,30 @@
+#include "imageStats.h"
+#include "testing.h"
+
+#include <climits>
+#include <vector>
+
+TEST_CASE(image_stats_smallest_with_huge_sizes)
+{
+    // identify's sizes aren't bounded: their pixel counts must not overflow into small ones
+    ImageStats stats(1);
+    stats.add(0, "PNG", 4000000000L, 4000000000L, 100);
+    stats.add(1, "PNG", 2, 2, 100);
+    stats.add(2, "PNG", LONG_MAX, 3, 100);
+    std::vector<SmallImage> smallest = stats.smallest();
+    CHECK(smallest.size() == 1 && smallest[0].path == 1);
+}
+
+TEST_CASE(image_stats_smallest_keeps_ties)
+{
+    ImageStats stats(2), other(2);
+    for (PathId path = 0; path < 10; path++) { stats.add(path, "GIF", 100 + path, 100, 10); }
+    other.add(10, "GIF", 50, 2, 10);
+    other.add(11, "GIF", 2, 50, 10);
+    other.add(12, "GIF", 10, 10, 10);
+    stats.merge(other);
+    // 100 pixels each: the n-th smallest and everything tied with it
+    std::vector<SmallImage> smallest = stats.smallest();
+    CHECK(smallest.size() == 3);
+    for (const SmallImage & image : smallest) { CHECK(image.path >= 10); }
+}
@@ -0,0 +1,142 @@
+#include "ioUring.h"
+
+#ifdef __linux__
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+IoUring::~IoUring()
+{
+    if (sqes) { munmap(sqes, sqes_size); }
+    if (cq_ring && cq_ring != sq_ring) { munmap(cq_ring, cq_ring_size); }
+    if (sq_ring) { munmap(sq_ring, sq_ring_size); }
+    if (ring_fd >= 0) { close(ring_fd); }
+}
+
+static void * map_ring(int ring_fd, size_t size, off_t offset)
+{
+    void * ring = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, offset);
+    return ring == MAP_FAILED ? nullptr : ring;
+}
+
+/**
+ * @brief Creates the ring and maps its queues.
+ *        Submission carries on past entries that fail (where the kernel supports it, since 5.18), so
+ *        that a submit either takes every entry or none.
+ * @param entries The number of submission queue entries (rounded up to a power of two by the kernel).
+ * @return False if io_uring is unavailable (old kernel, or blocked by a seccomp filter).
+ */
+bool IoUring::setup(unsigned entries)
+{
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_SUBMIT_ALL;
+    int fd = syscall(__NR_io_uring_setup, entries, &params);
+    if (fd < 0 && errno == EINVAL) {
+        memset(&params, 0, sizeof(params));
+        fd = syscall(__NR_io_uring_setup, entries, &params);
+    }
+    if (fd < 0) { return false; }
+    ring_fd = fd;
+
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    // since 5.4 both rings live in a single mapping
+    if (params.features & IORING_FEAT_SINGLE_MMAP) { sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size); }
+    sq_ring = map_ring(ring_fd, sq_ring_size, IORING_OFF_SQ_RING);
+    if (! sq_ring) { return false; }
+    cq_ring = params.features & IORING_FEAT_SINGLE_MMAP ? sq_ring : map_ring(ring_fd, cq_ring_size, IORING_OFF_CQ_RING);
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    sqes = static_cast<io_uring_sqe *>(map_ring(ring_fd, sqes_size, IORING_OFF_SQES));
+    if (! cq_ring || ! sqes) { return false; }
+
+    char * sq = static_cast<char *>(sq_ring);
+    sq_head = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    sq_tail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sq_mask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    sq_entries = params.sq_entries;
+    sqe_tail = submitted_tail = *sq_tail;
+
+    char * cq = static_cast<char *>(cq_ring);
+    cq_head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cq_mask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+    return true;
+}
+
+/**
+ * @brief Registers buffers that READ_FIXED operations can then read into without the kernel
+ *        mapping them on every call.
+ */
+bool IoUring::register_buffers(const iovec * buffers, unsigned n_buffers)
+{
+    return syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_BUFFERS, buffers, n_buffers) == 0;
+}
+
+/**
+ * @brief Registers an empty table of direct descriptors, which OPENAT can fill and CLOSE empty
+ *        without ever creating a regular file descriptor.
+ */
+bool IoUring::register_sparse_files(unsigned n_files)
+{
+    io_uring_rsrc_register registration;
+    memset(&registration, 0, sizeof(registration));
+    registration.nr = n_files;
+    registration.flags = IORING_RSRC_REGISTER_SPARSE;
+    if (syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_FILES2, &registration, sizeof(registration)) == 0) {
+        return true;
+    }
+    // before 5.19, a table of -1 descriptors does the same
+    std::vector<int> empty_slots(n_files, -1);
+    return syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_FILES, empty_slots.data(), n_files) == 0;
+}
+
+/**
+ * @brief Returns the next free submission queue entry, zeroed.
+ * @return The entry, or null if the queue is full until the next submit.
+ */
+io_uring_sqe * IoUring::get_sqe()
+{
+    unsigned head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+    if (sqe_tail - head >= sq_entries) { return nullptr; }
+    unsigned index = sqe_tail & *sq_mask;
+    sq_array[index] = index;
+    sqe_tail++;
+    memset(&sqes[index], 0, sizeof(io_uring_sqe));
+    return &sqes[index];
+}
+
+/**
+ * @brief Returns how many entries get_sqe() can hand out before the next submit, so that a chain of
+ *        linked entries can be checked to fit before any of it is queued.
+ */
+unsigned IoUring::sq_space_left() const
+{
+    return sq_entries - (sqe_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE));
+}
+
+/**
+ * @brief Submits the entries handed out since the last submit, and waits for completions.
+ * @param n_wait The number of completions to wait for (0 to only submit).
+ * @return The number of entries submitted, or -errno.
+ */
+int IoUring::submit_and_wait(unsigned n_wait)
+{
+    __atomic_store_n(sq_tail, sqe_tail, __ATOMIC_RELEASE);
+    int result;
+    do {
+        result = syscall(__NR_io_uring_enter, ring_fd, sqe_tail - submitted_tail, n_wait, IORING_ENTER_GETEVENTS, nullptr, 0);
+    } while (result < 0 && errno == EINTR);
+    if (result < 0) { return -errno; }
+    submitted_tail += result;
+    return result;
+}
+
+#endif
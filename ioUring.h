@@ -0,0 +1,76 @@
+#pragma once
+
+// io_uring only exists on Linux; elsewhere ImageBatcher reads headers synchronously
+#ifdef __linux__
+
+#include <linux/io_uring.h>
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief A minimal io_uring instance driven through the raw system calls (no liburing): one
+ *        submission queue, one completion queue, and registration of fixed buffers and files.
+ *
+ * The queue heads and tails are shared with the kernel, so they are read with acquire and written
+ * with release ordering.
+ */
+class IoUring {
+public:
+    IoUring() = default;
+    ~IoUring();
+    IoUring(const IoUring &) = delete;
+    IoUring & operator=(const IoUring &) = delete;
+
+    bool setup(unsigned entries);
+    bool ready() const { return ring_fd >= 0; }
+    bool register_buffers(const iovec * buffers, unsigned n_buffers);
+    bool register_sparse_files(unsigned n_files);
+
+    io_uring_sqe * get_sqe();
+    unsigned sq_space_left() const;
+    int submit_and_wait(unsigned n_wait);
+
+    /**
+     * @brief Hands every completion that has arrived to `consumer(user_data, result)`.
+     * @return The number of completions consumed.
+     */
+    template <typename Consumer>
+    unsigned drain_completions(Consumer consumer)
+    {
+        unsigned head = *cq_head;
+        unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+        unsigned n_consumed = 0;
+        for (; head != tail; head++, n_consumed++) {
+            const io_uring_cqe & cqe = cqes[head & *cq_mask];
+            consumer(cqe.user_data, cqe.res);
+        }
+        __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+        return n_consumed;
+    }
+
+private:
+    int ring_fd = -1;
+    void * sq_ring = nullptr;
+    size_t sq_ring_size = 0;
+    void * cq_ring = nullptr;
+    size_t cq_ring_size = 0;
+    io_uring_sqe * sqes = nullptr;
+    size_t sqes_size = 0;
+
+    unsigned * sq_head = nullptr;
+    unsigned * sq_tail = nullptr;
+    unsigned * sq_mask = nullptr;
+    unsigned * sq_array = nullptr;
+    unsigned sq_entries = 0;
+    unsigned sqe_tail = 0;      // SQEs handed out so far, published to the kernel on submit
+    unsigned submitted_tail = 0; // SQEs the kernel has taken so far
+
+    unsigned * cq_head = nullptr;
+    unsigned * cq_tail = nullptr;
+    unsigned * cq_mask = nullptr;
+    io_uring_cqe * cqes = nullptr;
+};
+
+#endif
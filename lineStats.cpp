@@ -0,0 +1,77 @@
+#include "lineStats.h"
+
+#include <algorithm>
+
+#ifdef __SSE2__
+    #include <emmintrin.h>
+#endif
+
+constexpr unsigned char NEWLINE = '\n';
+constexpr unsigned char CARRIAGE_RETURN = '\r';
+constexpr unsigned char ASCII_MAX = 0x7F;
+
+void LineCounter::end_line(bool crlf)
+{
+    stats.n_lines++;
+    stats.n_crlf_lines += crlf;
+    stats.longest_line = std::max(stats.longest_line, current_line - crlf);
+    current_line = 0;
+}
+
+/**
+ * @brief Scans the next block of the file.
+ * @param data The block.
+ * @param size The size of the block.
+ */
+void LineCounter::feed(const unsigned char * data, size_t size)
+{
+    size_t i = 0;
+    stats.n_bytes += size;
+
+#ifdef __SSE2__
+    const __m128i newline = _mm_set1_epi8(NEWLINE);
+    const __m128i carriage_return = _mm_set1_epi8(CARRIAGE_RETURN);
+    for (; i + sizeof(__m128i) <= size; i += sizeof(__m128i)) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        // the sign bit of a byte is set exactly when it is above 0x7F
+        stats.n_non_ascii_bytes += __builtin_popcount(_mm_movemask_epi8(block));
+        unsigned newlines = _mm_movemask_epi8(_mm_cmpeq_epi8(block, newline));
+        unsigned carriage_returns = _mm_movemask_epi8(_mm_cmpeq_epi8(block, carriage_return));
+        // bit p says whether the byte before byte p is a '\r', reaching back into the previous chunk
+        unsigned preceded_by_cr = (carriage_returns << 1) | previous_was_cr;
+
+        int line_start = 0;
+        for (unsigned remaining = newlines; remaining != 0; remaining &= remaining - 1) {
+            int position = __builtin_ctz(remaining);
+            current_line += position - line_start;
+            end_line((preceded_by_cr >> position) & 1);
+            line_start = position + 1;
+        }
+        current_line += sizeof(__m128i) - line_start;
+        previous_was_cr = (carriage_returns >> (sizeof(__m128i) - 1)) & 1;
+    }
+#endif
+
+    for (; i < size; i++) {
+        unsigned char c = data[i];
+        stats.n_non_ascii_bytes += c > ASCII_MAX;
+        if (c == NEWLINE) {
+            end_line(previous_was_cr);
+        } else {
+            current_line++;
+        }
+        previous_was_cr = c == CARRIAGE_RETURN;
+    }
+}
+
+/**
+ * @brief Ends the file and starts the next one.
+ * @return The statistics of the file.
+ */
+LineStats LineCounter::finish()
+{
+    if (current_line > 0) { end_line(false); }
+    LineStats file_stats = stats;
+    *this = LineCounter();
+    return file_stats;
+}
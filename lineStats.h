@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+
+// line and byte-class statistics of one text file (or, summed up, of many)
+struct LineStats {
+    long n_lines = 0;           // an unterminated last line counts too
+    long longest_line = 0;      // in bytes, without the line ending
+    long n_bytes = 0;
+    long n_non_ascii_bytes = 0; // bytes above 0x7F
+    long n_crlf_lines = 0;      // lines ending with "\r\n" rather than "\n"
+};
+
+/**
+ * @brief Gathers the LineStats of a file from the same blocks the tokenizer reads. Blocks are
+ *        scanned 16 bytes at a time, and only chunks holding a newline are looked at more closely.
+ */
+class LineCounter {
+public:
+    void feed(const unsigned char * data, size_t size);
+    LineStats finish();
+
+private:
+    void end_line(bool crlf);
+
+    LineStats stats;
+    long current_line = 0;         // bytes of the current line so far, a trailing '\r' included
+    bool previous_was_cr = false;  // whether the last byte fed was a '\r'
+};
@@ -0,0 +1,102 @@
+#include "lineStats.h"
+#include "testing.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Computes the LineStats of a whole text one byte at a time, as the reference the vectorized
+ *        counter must agree with.
+ */
+static LineStats reference_stats(const std::string & text)
+{
+    LineStats stats;
+    long line = 0;
+    for (size_t i = 0; i < text.size(); i++) {
+        unsigned char c = text[i];
+        stats.n_non_ascii_bytes += c > 0x7F;
+        if (c != '\n') {
+            line++;
+            continue;
+        }
+        bool crlf = i > 0 && text[i - 1] == '\r';
+        stats.n_lines++;
+        stats.n_crlf_lines += crlf;
+        stats.longest_line = std::max(stats.longest_line, line - crlf);
+        line = 0;
+    }
+    if (line > 0) {
+        stats.n_lines++;
+        stats.longest_line = std::max(stats.longest_line, line);
+    }
+    stats.n_bytes = text.size();
+    return stats;
+}
+
+static bool same_stats(const LineStats & stats1, const LineStats & stats2)
+{
+    return stats1.n_lines == stats2.n_lines && stats1.longest_line == stats2.longest_line && stats1.n_bytes == stats2.n_bytes
+        && stats1.n_non_ascii_bytes == stats2.n_non_ascii_bytes && stats1.n_crlf_lines == stats2.n_crlf_lines;
+}
+
+/**
+ * @brief Feeds a text to a counter in blocks of the given sizes (the last block takes the rest).
+ */
+static LineStats counted_stats(LineCounter & counter, const std::string & text, const std::vector<size_t> & block_sizes)
+{
+    const unsigned char * data = reinterpret_cast<const unsigned char *>(text.data());
+    size_t offset = 0;
+    for (size_t block_size : block_sizes) {
+        block_size = std::min(block_size, text.size() - offset);
+        counter.feed(data + offset, block_size);
+        offset += block_size;
+    }
+    counter.feed(data + offset, text.size() - offset);
+    return counter.finish();
+}
+
+TEST_CASE(line_counter_edge_cases)
+{
+    LineCounter counter;
+    for (const std::string & text : std::vector<std::string>{ "", "\n", "\r\n", "\r", "abc", "a\r\nb\n\rc\r\r\n", std::string(16, '\n'), std::string(15, 'x') + "\r\n" }) {
+        CHECK(same_stats(counted_stats(counter, text, {}), reference_stats(text)));
+    }
+    // a "\r\n" split between two 16-byte chunks, and between two blocks
+    std::string split = std::string(15, 'x') + "\r\n" + std::string(20, 'y');
+    CHECK(same_stats(counted_stats(counter, split, {}), reference_stats(split)));
+    CHECK(same_stats(counted_stats(counter, split, { 16 }), reference_stats(split)));
+    CHECK(same_stats(counted_stats(counter, split, { 3, 13 }), reference_stats(split)));
+}
+
+TEST_CASE(line_counter_matches_scalar_reference)
+{
+    // line endings, carriage returns and bytes above 0x7F are frequent, and blocks come in odd
+    // sizes, so that the 16-byte chunks and the byte-at-a-time tail hand over in every position
+    const std::string alphabet = "ab\n\r\x80\xFF";
+    std::mt19937 generator(11);
+    std::uniform_int_distribution<size_t> byte(0, alphabet.size() - 1);
+    std::uniform_int_distribution<size_t> text_length(0, 300);
+    std::uniform_int_distribution<size_t> block_size(0, 40);
+    LineCounter counter;
+    for (int round = 0; round < 2000; round++) {
+        std::string text;
+        for (size_t i = text_length(generator); i > 0; i--) { text += alphabet[byte(generator)]; }
+        std::vector<size_t> block_sizes;
+        for (size_t total = 0; total < text.size();) {
+            block_sizes.push_back(block_size(generator));
+            total += block_sizes.back();
+        }
+        CHECK(same_stats(counted_stats(counter, text, block_sizes), reference_stats(text)));
+    }
+}
+
+TEST_CASE(line_counter_long_lines)
+{
+    std::string text = std::string(1000, 'x') + "\r\n" + std::string(70000, 'y') + "\n" + std::string(33, 'z');
+    LineCounter counter;
+    LineStats stats = counted_stats(counter, text, { 4096, 4096, 4096 });
+    CHECK(same_stats(stats, reference_stats(text)));
+    CHECK(stats.n_lines == 3 && stats.longest_line == 70000 && stats.n_crlf_lines == 1);
+}
@@ -1,18 +1,91 @@
 #include "analyzeDir.h"
+#include "fileStore.h"
+#include "imageStats.h"
 #include <cassert>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <climits>
+#include <getopt.h>
 #include <sys/resource.h>
 #include <sys/time.h>
 #include <unistd.h>
 
 constexpr int MAX_OPEN_FILES = 256;
-constexpr int EXPECTED_ARG_COUNT = 3; // Expecting program name, N, and directory name
-constexpr int ARG_N_INDEX = 1;
-constexpr int ARG_DIR_INDEX = 2;
+constexpr int EXPECTED_POSITIONAL_ARG_COUNT = 2; // Expecting N and directory name after the options
+constexpr int ARG_N_OFFSET = 0;
+constexpr int ARG_DIR_OFFSET = 1;
 constexpr int SYSCALL_SUCCESS = 0;
 constexpr int PROGRAM_FAILED = -1;
 
+// values returned by getopt_long() for options that only have a long form
+enum LongOption {
+    OPTION_RETRIES = 256,
+    OPTION_ERROR_SAMPLES,
+    OPTION_TEXT_EXTENSIONS,
+    OPTION_SNIFF_TEXT,
+    OPTION_UNICODE,
+    OPTION_NGRAMS,
+    OPTION_STOP_WORDS,
+    OPTION_STOP_WORDS_FILE,
+    OPTION_DIR_WORDS,
+    OPTION_DIR_WORDS_SIZE,
+    OPTION_DISTINCT,
+    OPTION_DISTINCT_DEPTH,
+    OPTION_NEAR_DUPLICATES,
+    OPTION_SIMILARITY,
+    OPTION_COUNT_TERMS,
+    OPTION_COUNT_TERMS_FILE,
+    OPTION_LINE_STATS,
+    OPTION_NATIVE_IMAGES,
+    OPTION_NO_IDENTIFY,
+    OPTION_IO_URING,
+    OPTION_IMAGE_THREADS,
+    OPTION_PIN_THREADS,
+    OPTION_NUMA_BIND,
+    OPTION_IMAGE_STATS,
+    OPTION_FILE_STATS,
+    OPTION_MAX_MEMORY,
+    OPTION_IDENTIFY_TIMEOUT,
+    OPTION_IDENTIFY_MEMORY,
+    OPTION_ARCHIVES,
+    OPTION_ARCHIVE_TOTALS,
+};
+
+const struct option LONG_OPTIONS[] = {
+    { "retries", required_argument, nullptr, OPTION_RETRIES },
+    { "error-samples", required_argument, nullptr, OPTION_ERROR_SAMPLES },
+    { "text-ext", required_argument, nullptr, OPTION_TEXT_EXTENSIONS },
+    { "sniff-text", no_argument, nullptr, OPTION_SNIFF_TEXT },
+    { "unicode", no_argument, nullptr, OPTION_UNICODE },
+    { "ngrams", required_argument, nullptr, OPTION_NGRAMS },
+    { "stop-words", no_argument, nullptr, OPTION_STOP_WORDS },
+    { "stop-words-file", required_argument, nullptr, OPTION_STOP_WORDS_FILE },
+    { "dir-words", required_argument, nullptr, OPTION_DIR_WORDS },
+    { "dir-words-size", required_argument, nullptr, OPTION_DIR_WORDS_SIZE },
+    { "distinct", no_argument, nullptr, OPTION_DISTINCT },
+    { "distinct-depth", required_argument, nullptr, OPTION_DISTINCT_DEPTH },
+    { "near-duplicates", no_argument, nullptr, OPTION_NEAR_DUPLICATES },
+    { "similarity", required_argument, nullptr, OPTION_SIMILARITY },
+    { "count-terms", required_argument, nullptr, OPTION_COUNT_TERMS },
+    { "count-terms-file", required_argument, nullptr, OPTION_COUNT_TERMS_FILE },
+    { "line-stats", no_argument, nullptr, OPTION_LINE_STATS },
+    { "native-images", no_argument, nullptr, OPTION_NATIVE_IMAGES },
+    { "no-identify", no_argument, nullptr, OPTION_NO_IDENTIFY },
+    { "io-uring", no_argument, nullptr, OPTION_IO_URING },
+    { "image-threads", required_argument, nullptr, OPTION_IMAGE_THREADS },
+    { "pin-threads", no_argument, nullptr, OPTION_PIN_THREADS },
+    { "numa-bind", no_argument, nullptr, OPTION_NUMA_BIND },
+    { "image-stats", no_argument, nullptr, OPTION_IMAGE_STATS },
+    { "file-stats", no_argument, nullptr, OPTION_FILE_STATS },
+    { "max-memory", required_argument, nullptr, OPTION_MAX_MEMORY },
+    { "identify-timeout", required_argument, nullptr, OPTION_IDENTIFY_TIMEOUT },
+    { "identify-memory", required_argument, nullptr, OPTION_IDENTIFY_MEMORY },
+    { "archives", no_argument, nullptr, OPTION_ARCHIVES },
+    { "archive-totals", no_argument, nullptr, OPTION_ARCHIVE_TOTALS },
+    { nullptr, 0, nullptr, 0 },
+};
+
 /**
  * @brief Prints usage instructions and exits the program.
  * 
@@ -21,10 +94,163 @@ constexpr int PROGRAM_FAILED = -1;
  */
 void usage(const std::string & pname, int exit_code)
 {
-    printf("Usage: %s N directory_name\n", pname.c_str());
+    printf("Usage: %s [options] N directory_name\n", pname.c_str());
+    printf("Options:\n");
+    printf("  --retries=R         retry reads failing with a transient error (EINTR, ESTALE, ...) R times\n");
+    printf("  --error-samples=S   report at most S failing paths per error (default 5)\n");
+    printf("  --text-ext=E1,E2    count words in files with these extensions (default .txt)\n");
+    printf("  --sniff-text        also count words in any other file whose first 4 KB look like text\n");
+    printf("  --unicode           read text as UTF-8, so words may contain letters of any script\n");
+    printf("  --ngrams=M          also report the most common word bigrams (M=2) and trigrams (M=3)\n");
+    printf("  --stop-words        don't count common English words (\"there\", \"which\", ...)\n");
+    printf("  --stop-words-file=F don't count the words listed in F, one per line\n");
+    printf("  --dir-words=D       report the most common words of each directory D levels down\n");
+    printf("  --dir-words-size=M  counters per directory word summary (default 256)\n");
+    printf("  --distinct          estimate the number of distinct words and file extensions\n");
+    printf("  --distinct-depth=D  also estimate them for each directory D levels down (implies --distinct)\n");
+    printf("  --near-duplicates   report clusters of text files with nearly the same words\n");
+    printf("  --similarity=J      similarity (0-1) from which text files are near duplicates (default 0.8)\n");
+    printf("  --count-terms=T1,T2 count the occurrences of these terms in text files (case-sensitive)\n");
+    printf("  --count-terms-file=F count the terms listed in F, one per line\n");
+    printf("  --line-stats        report line counts, longest line, CRLF and non-ASCII bytes of text files\n");
+    printf("  --file-stats        report files per extension, kind, size and age, and the largest files\n");
+    printf("  --max-memory=MB     past MB of memory, make the largest analyzers approximate (default 0 = no limit)\n");
+    printf("  --native-images     read image sizes from file headers, running identify only on other formats\n");
+    printf("  --no-identify       never run identify (implies --native-images)\n");
+    printf("  --io-uring          experimental: read image headers in batches through io_uring (implies --native-images)\n");
+    printf("  --image-threads=T   measure images on T threads (default 1)\n");
+    printf("  --pin-threads       pin the image threads to CPUs, spread over the NUMA nodes\n");
+    printf("  --numa-bind         allocate each image thread's memory on its node (implies --pin-threads)\n");
+    printf("  --image-stats       report image counts per format, megapixels, sizes and the smallest images\n");
+    printf("  --identify-timeout=T kill identify after T seconds on one file (default 10, 0 = never)\n");
+    printf("  --identify-memory=MB limit identify to MB of address space (default 8192, 0 = no limit)\n");
+    printf("  --archives          analyze the files inside .tar(.gz/.zst) and .zip archives\n");
+    printf("  --archive-totals    count the files inside archives in the file totals (implies --archives)\n");
     exit(exit_code);
 }
 
+/**
+ * @brief Splits a comma-separated option value into its items.
+ *
+ * @param value The option value.
+ * @return The non-empty items, in order.
+ */
+std::vector<std::string> split_list(const std::string & value)
+{
+    std::vector<std::string> items;
+    size_t start = 0;
+    for (size_t comma; (comma = value.find(',', start)) != std::string::npos; start = comma + 1) {
+        if (comma > start) { items.push_back(value.substr(start, comma - start)); }
+    }
+    if (start < value.size()) { items.push_back(value.substr(start)); }
+    return items;
+}
+
+/**
+ * @brief Reads a file with one word per line, exiting with the usage if it can't be read. This has
+ *        to happen before changing into the analyzed directory, since the path is relative to the
+ *        caller's working directory.
+ *
+ * @param pname The program name.
+ * @param file_name The path of the file.
+ * @param words The list to append the words to.
+ */
+void read_word_list(const std::string & pname, const char * file_name, std::vector<std::string> & words)
+{
+    FILE * file = fopen(file_name, "r");
+    if (! file) {
+        perror(file_name);
+        usage(pname, PROGRAM_FAILED);
+    }
+    char line[LINE_MAX];
+    while (fgets(line, sizeof(line), file)) {
+        std::string word = line;
+        word.erase(word.find_last_not_of(" \t\r\n") + 1);
+        if (! word.empty()) { words.push_back(word); }
+    }
+    fclose(file);
+}
+
+/**
+ * @brief Formats the range of image side lengths a log2 histogram bucket covers.
+ * @param log2_length The bucket.
+ * @return E.g. "64-127", or "16384+" for the last, open-ended bucket.
+ */
+std::string size_bucket_range(int log2_length)
+{
+    long low = 1L << log2_length;
+    if (log2_length == IMAGE_SIZE_BUCKETS - 1) { return std::to_string(low) + "+"; }
+    return std::to_string(low) + "-" + std::to_string(2 * low - 1);
+}
+
+/**
+ * @brief Formats the range of file sizes a bucket of Results::file_size_histogram covers.
+ * @param bucket The bucket.
+ * @return E.g. "0", "64-127", or "1099511627776+" for the last, open-ended bucket.
+ */
+std::string file_size_range(int bucket)
+{
+    if (bucket == 0) { return "0"; }
+    long low = 1L << (bucket - 1);
+    if (bucket == static_cast<int>(FILE_SIZE_BUCKETS) - 1) { return std::to_string(low) + "+"; }
+    return std::to_string(low) + "-" + std::to_string(2 * low - 1);
+}
+
+/**
+ * @brief Parses the command line options into `options`, exiting with the usage on bad input.
+ *
+ * @param argc The argument count.
+ * @param argv The arguments.
+ * @param options The options to fill in.
+ */
+void parse_options(int argc, char ** argv, AnalyzeOptions & options)
+{
+    for (int opt; (opt = getopt_long(argc, argv, "", LONG_OPTIONS, nullptr)) != -1;) {
+        switch (opt) {
+        case OPTION_RETRIES: options.transient_retries = std::stoi(optarg); break;
+        case OPTION_ERROR_SAMPLES: options.max_error_samples = std::stoi(optarg); break;
+        case OPTION_TEXT_EXTENSIONS: options.text_extensions = split_list(optarg); break;
+        case OPTION_SNIFF_TEXT: options.sniff_text = true; break;
+        case OPTION_UNICODE: options.unicode_words = true; break;
+        case OPTION_NGRAMS: options.max_ngram_size = std::stoi(optarg); break;
+        case OPTION_STOP_WORDS: options.builtin_stop_words = true; break;
+        case OPTION_STOP_WORDS_FILE: read_word_list(argv[0], optarg, options.stop_words); break;
+        case OPTION_DIR_WORDS: options.dir_words_depth = std::stoi(optarg); break;
+        case OPTION_DIR_WORDS_SIZE: options.dir_words_summary_size = std::stoul(optarg); break;
+        case OPTION_DISTINCT: options.count_distinct = true; break;
+        case OPTION_DISTINCT_DEPTH:
+            options.count_distinct = true;
+            options.distinct_depth = std::stoi(optarg);
+            break;
+        case OPTION_NEAR_DUPLICATES: options.find_near_duplicates = true; break;
+        case OPTION_SIMILARITY: options.near_duplicate_similarity = std::stod(optarg); break;
+        case OPTION_COUNT_TERMS:
+            for (auto & term : split_list(optarg)) { options.count_terms.push_back(term); }
+            break;
+        case OPTION_COUNT_TERMS_FILE: read_word_list(argv[0], optarg, options.count_terms); break;
+        case OPTION_LINE_STATS: options.line_stats = true; break;
+        case OPTION_FILE_STATS: options.file_stats = true; break;
+        case OPTION_MAX_MEMORY: options.max_memory_mb = std::stol(optarg); break;
+        case OPTION_NATIVE_IMAGES: options.native_images = true; break;
+        case OPTION_NO_IDENTIFY:
+            options.native_images = true;
+            options.use_identify = false;
+            break;
+        case OPTION_IO_URING: options.native_images = options.io_uring_images = true; break;
+        case OPTION_IMAGE_THREADS: options.image_threads = std::stoi(optarg); break;
+        case OPTION_PIN_THREADS: options.pin_threads = true; break;
+        case OPTION_NUMA_BIND: options.pin_threads = options.numa_bind = true; break;
+        case OPTION_IMAGE_STATS: options.image_stats = true; break;
+        case OPTION_IDENTIFY_TIMEOUT: options.identify_timeout_seconds = std::stod(optarg); break;
+        case OPTION_IDENTIFY_MEMORY: options.identify_memory_mb = std::stol(optarg); break;
+        case OPTION_ARCHIVES: options.scan_archives = true; break;
+        case OPTION_ARCHIVE_TOTALS: options.scan_archives = options.count_archive_members = true; break;
+        default: usage(argv[0], PROGRAM_FAILED);
+        }
+    }
+    if (argc - optind != EXPECTED_POSITIONAL_ARG_COUNT) { usage(argv[0], PROGRAM_FAILED); }
+}
+
 int main(int argc, char ** argv)
 {
     // set the max number of open file descriptors to avoid hitting system limits
@@ -36,9 +262,11 @@ int main(int argc, char ** argv)
         assert(res == SYSCALL_SUCCESS);
     }
 
-    // convert the first argument (N) to an integer and analyze the directory
-    if (argc != EXPECTED_ARG_COUNT || chdir(argv[ARG_DIR_INDEX])) { usage(argv[0], PROGRAM_FAILED); }
-    Results res = analyzeDir(std::stoi(argv[1]));
+    // convert the first positional argument (N) to an integer and analyze the directory
+    AnalyzeOptions options;
+    parse_options(argc, argv, options);
+    if (chdir(argv[optind + ARG_DIR_OFFSET])) { usage(argv[0], PROGRAM_FAILED); }
+    Results res = analyzeDir(std::stoi(argv[optind + ARG_N_OFFSET]), options);
     
     // print the results in a formatted output
     printf("--------------------------------------------------------------\n");
@@ -47,12 +275,41 @@ int main(int argc, char ** argv)
     printf("Number of files:   %ld\n", res.n_files);
     printf("Number of dirs:    %ld\n", res.n_dirs);
     printf("Total file size:   %ld\n", res.all_files_size);
+    if (options.scan_archives) {
+        printf("Archive members:   %ld\n", res.n_archive_members);
+        printf("Archive size:      %ld\n", res.archive_members_size);
+    }
+    if (options.count_distinct) {
+        printf("Distinct words:    ~%ld\n", res.n_distinct_words);
+        printf("Distinct exts:     ~%ld\n", res.n_distinct_extensions);
+    }
 
     // descending order, follwoed by alphabetical
     printf("Most common words from .txt files:\n");
     for (auto & w : res.most_common_words) {
         printf(" - \"%s\" x %d\n", w.first.c_str(), w.second);
     }
+    if (options.max_ngram_size >= 2) {
+        printf("Most common bigrams from .txt files:\n");
+        for (auto & w : res.most_common_bigrams) { printf(" - \"%s\" x %d\n", w.first.c_str(), w.second); }
+    }
+    if (options.max_ngram_size >= 3) {
+        printf("Most common trigrams from .txt files:\n");
+        for (auto & w : res.most_common_trigrams) { printf(" - \"%s\" x %d\n", w.first.c_str(), w.second); }
+    }
+    if (options.dir_words_depth >= 0) {
+        printf("Most common words per directory:\n");
+        for (auto & d : res.dir_top_words) {
+            printf(" - \"%s\"\n", d.path.c_str());
+            for (auto & w : d.words) { printf("    - \"%s\" x %d\n", w.first.c_str(), w.second); }
+        }
+    }
+    if (options.distinct_depth >= 0) {
+        printf("Distinct words and extensions per directory:\n");
+        for (auto & d : res.dir_distinct_counts) {
+            printf(" - \"%s\" ~%ld words, ~%ld extensions\n", d.path.c_str(), d.n_distinct_words, d.n_distinct_extensions);
+        }
+    }
     printf("Vacant directories:\n");
     for (auto & d : res.vacant_dirs) { printf(" - \"%s\"\n", d.c_str()); }
     
@@ -61,6 +318,76 @@ int main(int argc, char ** argv)
     for (auto & ii : res.largest_images) {
         printf(" - \"%s\" %ldx%ld\n", ii.path.c_str(), ii.width, ii.height);
     }
+    if (options.image_stats) {
+        printf("Image formats:\n");
+        for (auto & f : res.image_formats) {
+            printf(" - %s x %ld, %ld bytes, %.1f MP\n", f.format.c_str(), f.count, f.bytes, f.megapixels);
+        }
+        printf("Image megapixels:  %.1f\n", res.image_megapixels);
+        printf("Image sizes (width x height):\n");
+        for (auto & b : res.image_size_histogram) {
+            printf(" - %s x %s: %ld\n", size_bucket_range(b.log2_width).c_str(), size_bucket_range(b.log2_height).c_str(), b.count);
+        }
+        printf("Smallest images:\n");
+        for (auto & ii : res.smallest_images) {
+            printf(" - \"%s\" %ldx%ld\n", ii.path.c_str(), ii.width, ii.height);
+        }
+    }
+
+    if (! options.count_terms.empty()) {
+        printf("Term counts:\n");
+        for (auto & t : res.term_counts) {
+            printf(" - \"%s\" x %ld\n", t.term.c_str(), t.count);
+            for (auto & f : t.top_files) { printf("    \"%s\" x %ld\n", f.first.c_str(), f.second); }
+        }
+    }
+    if (options.find_near_duplicates) {
+        printf("Near-duplicate text files:\n");
+        for (auto & c : res.near_duplicates) {
+            printf(" - ~%.2f similar:\n", c.min_similarity);
+            for (auto & p : c.paths) { printf("    \"%s\"\n", p.c_str()); }
+        }
+    }
+    if (options.line_stats) {
+        const LineStats & l = res.text_lines;
+        printf("Text lines:        %ld\n", l.n_lines);
+        printf("Longest line:      %ld (\"%s\")\n", l.longest_line, res.longest_line_path.c_str());
+        printf("Non-ASCII bytes:   %ld of %ld\n", l.n_non_ascii_bytes, l.n_bytes);
+        printf("CRLF lines:        %ld in %ld files\n", l.n_crlf_lines, res.n_crlf_files);
+        printf("Most lines:\n");
+        for (auto & f : res.most_lines_files) { printf(" - \"%s\" x %ld\n", f.first.c_str(), f.second); }
+    }
+    if (options.file_stats) {
+        printf("File extensions:\n");
+        for (auto & e : res.extension_counts) {
+            printf(" - %s x %ld, %ld bytes\n", e.name.empty() ? "(none)" : e.name.c_str(), e.count, e.bytes);
+        }
+        printf("File kinds:\n");
+        for (auto & k : res.file_kind_counts) { printf(" - %s x %ld, %ld bytes\n", k.name.c_str(), k.count, k.bytes); }
+        printf("File sizes (bytes):\n");
+        for (size_t b = 0; b < res.file_size_histogram.size(); b++) {
+            if (res.file_size_histogram[b] > 0) { printf(" - %s: %ld\n", file_size_range(b).c_str(), res.file_size_histogram[b]); }
+        }
+        printf("Unchanged for a year: %ld, %ld bytes\n", res.n_stale_files, res.stale_files_size);
+        printf("Largest files:\n");
+        for (auto & f : res.largest_files) { printf(" - \"%s\" %ld\n", f.path.c_str(), f.size); }
+    }
+    if (! res.timed_out_images.empty()) {
+        printf("Image probes timed out:\n");
+        for (auto & p : res.timed_out_images) { printf(" - \"%s\"\n", p.c_str()); }
+    }
+    if (! res.degraded_analyzers.empty()) {
+        printf("Over the memory budget, degraded:\n");
+        for (auto & a : res.degraded_analyzers) { printf(" - %s\n", a.c_str()); }
+    }
+    // only shown when something could not be read, so a clean scan prints exactly as before
+    if (! res.scan_errors.empty()) {
+        printf("Scan errors:\n");
+        for (auto & e : res.scan_errors) {
+            printf(" - %s x %ld\n", describe_scan_error(e.error_code).c_str(), e.count);
+            for (auto & p : e.sample_paths) { printf("    \"%s\"\n", p.c_str()); }
+        }
+    }
     printf("--------------------------------------------------------------\n");
     return 0;
 }
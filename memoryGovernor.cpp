@@ -0,0 +1,87 @@
+#include "memoryGovernor.h"
+
+#include <algorithm>
+#include <cstdio>
+#ifdef __linux__
+    #include <malloc.h>
+    #include <unistd.h>
+#else
+    #include <sys/resource.h>
+#endif
+
+#ifdef __linux__
+constexpr char STATM_PATH[] = "/proc/self/statm";
+#elif ! defined(__APPLE__)
+constexpr size_t BYTES_PER_KB = 1024;
+#endif
+
+/**
+ * @brief Returns the resident set size of the process. Without /proc (elsewhere than on Linux), this
+ *        is the peak resident set size, which getrusage() reports: it never goes down, so once over
+ *        the budget the governor keeps degrading at every check.
+ * @return The size in bytes, or 0 if it can't be read.
+ */
+size_t current_rss()
+{
+#ifdef __linux__
+    FILE * statm = fopen(STATM_PATH, "r");
+    if (! statm) { return 0; }
+    unsigned long n_total_pages = 0;
+    unsigned long n_resident_pages = 0;
+    int n_read = fscanf(statm, "%lu %lu", &n_total_pages, &n_resident_pages);
+    fclose(statm);
+    return n_read == 2 ? n_resident_pages * sysconf(_SC_PAGESIZE) : 0;
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) { return 0; }
+    #ifdef __APPLE__
+        return usage.ru_maxrss; // in bytes on macOS
+    #else
+        return usage.ru_maxrss * BYTES_PER_KB;
+    #endif
+#endif
+}
+
+/**
+ * @brief Registers an analyzer.
+ * @param name The name reported if it degrades.
+ * @param usage Estimates its memory usage.
+ * @param degrade Makes it give up memory, or null if it can't.
+ */
+void MemoryGovernor::add_analyzer(const std::string & name, Usage usage, Degrade degrade)
+{
+    bool can_degrade = static_cast<bool>(degrade);
+    analyzers.push_back(Analyzer{ name, std::move(usage), std::move(degrade), ! can_degrade });
+}
+
+/**
+ * @brief Degrades the largest analyzer that still can if the process is over the budget.
+ */
+void MemoryGovernor::check()
+{
+    if (budget_bytes == 0 || current_rss() <= budget_bytes) { return; }
+
+    Analyzer * largest = nullptr;
+    size_t largest_usage = 0;
+    for (Analyzer & analyzer : analyzers) {
+        if (analyzer.exhausted) { continue; }
+        size_t usage = analyzer.usage();
+        if (! largest || usage > largest_usage) {
+            largest = &analyzer;
+            largest_usage = usage;
+        }
+    }
+    if (! largest) { return; }
+
+    if (! largest->degrade()) {
+        largest->exhausted = true;
+        return;
+    }
+    if (std::find(degraded_names.begin(), degraded_names.end(), largest->name) == degraded_names.end()) {
+        degraded_names.push_back(largest->name);
+    }
+#ifdef __linux__
+    // freed memory stays with malloc otherwise, and the next check would still see it as used
+    malloc_trim(0);
+#endif
+}
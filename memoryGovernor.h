@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+// the resident set size is read once per this many ticks, since reading it takes a system call
+constexpr unsigned long MEMORY_CHECK_INTERVAL = 4096;
+
+size_t current_rss();
+
+/**
+ * @brief Keeps the scan within a memory budget by asking the analyzers holding the most memory to
+ *        trade accuracy for space.
+ *
+ * Each analyzer registers an estimate of its usage and a way to degrade (e.g. switching from an
+ * exact table to a bounded summary). The scan ticks the governor as it goes; every so often the
+ * governor compares the process's resident set size with the budget, and when it is over, asks the
+ * largest analyzer that can still give something up to do so. One analyzer degrades per check, and
+ * freed memory is handed back to the system, so the next check sees whether that was enough.
+ */
+class MemoryGovernor {
+public:
+    // returns an estimate of the memory an analyzer holds, in bytes
+    using Usage = std::function<size_t()>;
+    // releases what it can, returning false once there is nothing left to give up
+    using Degrade = std::function<bool()>;
+
+    MemoryGovernor() = default;
+    explicit MemoryGovernor(size_t budget_bytes) : budget_bytes(budget_bytes) {}
+
+    void add_analyzer(const std::string & name, Usage usage, Degrade degrade = nullptr);
+    void tick()
+    {
+        if (budget_bytes > 0 && ++n_ticks % MEMORY_CHECK_INTERVAL == 0) { check(); }
+    }
+    void check();
+    const std::vector<std::string> & degraded() const { return degraded_names; }
+
+private:
+    struct Analyzer {
+        std::string name;
+        Usage usage;
+        Degrade degrade;
+        bool exhausted;
+    };
+
+    size_t budget_bytes = 0; // 0 = no budget
+    unsigned long n_ticks = 0;
+    std::vector<Analyzer> analyzers;
+    std::vector<std::string> degraded_names; // in the order they first degraded
+};
@@ -0,0 +1,164 @@
+#include "minHash.h"
+#include "perfectHash.h"
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <unordered_map>
+
+constexpr uint64_t MINHASH_WORD_SEED = 0x6D696E68; // "minh"
+constexpr uint64_t SHINGLE_MULTIPLIER = 0x9E3779B97F4A7C15ULL;
+
+/**
+ * @brief The multipliers and offsets of the hash functions (multiply-shift needs odd multipliers),
+ *        drawn once from a SplitMix64 sequence so that signatures are comparable across runs.
+ */
+struct MinHashFunctions {
+    std::array<uint64_t, MINHASH_SIZE> multipliers;
+    std::array<uint64_t, MINHASH_SIZE> offsets;
+
+    MinHashFunctions()
+    {
+        uint64_t state = 0;
+        auto next = [&]() {
+            uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            return z ^ (z >> 31);
+        };
+        for (size_t i = 0; i < MINHASH_SIZE; i++) {
+            multipliers[i] = next() | 1;
+            offsets[i] = next();
+        }
+    }
+};
+
+static const MinHashFunctions MINHASH_FUNCTIONS;
+
+MinHasher::MinHasher()
+{
+    minimums.fill(std::numeric_limits<uint32_t>::max());
+}
+
+/**
+ * @brief Adds the next word of the current document, hashing the shingle it completes.
+ * @param word The word.
+ */
+void MinHasher::add_word(const std::string & word)
+{
+    ring[n_words_in_document % SHINGLE_SIZE] = seeded_hash(word, MINHASH_WORD_SEED);
+    n_words_in_document++;
+    if (n_words_in_document < SHINGLE_SIZE) { return; }
+
+    uint64_t shingle_hash = 0;
+    for (size_t back = SHINGLE_SIZE; back > 0; back--) {
+        shingle_hash = (shingle_hash ^ ring[(n_words_in_document - back) % SHINGLE_SIZE]) * SHINGLE_MULTIPLIER;
+    }
+    add_shingle(shingle_hash);
+}
+
+void MinHasher::add_shingle(uint64_t shingle_hash)
+{
+    for (size_t i = 0; i < MINHASH_SIZE; i++) {
+        uint32_t value = (MINHASH_FUNCTIONS.multipliers[i] * shingle_hash + MINHASH_FUNCTIONS.offsets[i]) >> 32;
+        minimums[i] = std::min(minimums[i], value);
+    }
+}
+
+/**
+ * @brief Ends the current document and starts the next one.
+ * @param signature Set to the document's signature.
+ * @return False if the document had no words, so that there is no signature to compare.
+ */
+bool MinHasher::end_document(MinHashSignature & signature)
+{
+    // a document shorter than one shingle is its own single shingle
+    if (n_words_in_document > 0 && n_words_in_document < SHINGLE_SIZE) {
+        uint64_t shingle_hash = 0;
+        for (size_t i = 0; i < n_words_in_document; i++) { shingle_hash = (shingle_hash ^ ring[i]) * SHINGLE_MULTIPLIER; }
+        add_shingle(shingle_hash);
+    }
+
+    bool has_words = n_words_in_document > 0;
+    signature = minimums;
+    minimums.fill(std::numeric_limits<uint32_t>::max());
+    n_words_in_document = 0;
+    return has_words;
+}
+
+/**
+ * @brief Adds a document to compare with the others.
+ * @param path The path reported for the document.
+ * @param signature Its MinHash signature.
+ */
+void NearDuplicateFinder::add_document(const std::string & path, const MinHashSignature & signature)
+{
+    paths.push_back(path);
+    signatures.push_back(signature);
+}
+
+/**
+ * @brief Groups the documents into clusters of near duplicates.
+ * @param min_similarity The estimated Jaccard similarity from which two documents are near duplicates.
+ * @return The clusters of two or more documents, each sorted by path, sorted by their first path.
+ */
+std::vector<NearDuplicateCluster> NearDuplicateFinder::clusters(double min_similarity) const
+{
+    std::vector<size_t> parents(paths.size());
+    std::iota(parents.begin(), parents.end(), 0);
+    auto find = [&](size_t document) {
+        while (parents[document] != document) { document = parents[document] = parents[parents[document]]; }
+        return document;
+    };
+    std::vector<double> cluster_similarities(paths.size(), 1.0);
+
+    for (size_t band = 0; band < LSH_N_BANDS; band++) {
+        std::unordered_map<uint64_t, std::vector<size_t>> buckets;
+        for (size_t document = 0; document < signatures.size(); document++) {
+            uint64_t band_hash = 0;
+            for (size_t row = band * LSH_ROWS_PER_BAND; row < (band + 1) * LSH_ROWS_PER_BAND; row++) {
+                band_hash = (band_hash ^ signatures[document][row]) * SHINGLE_MULTIPLIER;
+            }
+            buckets[band_hash].push_back(document);
+        }
+
+        for (auto & [band_hash, documents] : buckets) {
+            for (size_t i = 0; i < documents.size(); i++) {
+                for (size_t j = i + 1; j < documents.size(); j++) {
+                    size_t root1 = find(documents[i]), root2 = find(documents[j]);
+                    if (root1 == root2) { continue; }
+
+                    const MinHashSignature & signature1 = signatures[documents[i]];
+                    const MinHashSignature & signature2 = signatures[documents[j]];
+                    size_t n_equal = 0;
+                    for (size_t k = 0; k < MINHASH_SIZE; k++) { n_equal += signature1[k] == signature2[k]; }
+                    double similarity = static_cast<double>(n_equal) / MINHASH_SIZE;
+                    if (similarity < min_similarity) { continue; }
+
+                    parents[root2] = root1;
+                    cluster_similarities[root1] = std::min({ cluster_similarities[root1], cluster_similarities[root2], similarity });
+                }
+            }
+        }
+    }
+
+    // paths are added in traversal order, so the clusters are sorted for a stable report
+    std::map<size_t, NearDuplicateCluster> clusters_by_root;
+    for (size_t document = 0; document < paths.size(); document++) {
+        size_t root = find(document);
+        NearDuplicateCluster & cluster = clusters_by_root[root];
+        cluster.paths.push_back(paths[document]);
+        cluster.min_similarity = cluster_similarities[root];
+    }
+    std::vector<NearDuplicateCluster> result;
+    for (auto & [root, cluster] : clusters_by_root) {
+        if (cluster.paths.size() < 2) { continue; }
+        std::sort(cluster.paths.begin(), cluster.paths.end());
+        result.push_back(std::move(cluster));
+    }
+    std::sort(result.begin(), result.end(), [](const NearDuplicateCluster & cluster1, const NearDuplicateCluster & cluster2) {
+        return cluster1.paths.front() < cluster2.paths.front();
+    });
+    return result;
+}
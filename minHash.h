@@ -0,0 +1,60 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+constexpr size_t MINHASH_SIZE = 64; // 32-bit minimums, so 256 bytes per file
+constexpr size_t SHINGLE_SIZE = 3;  // words per shingle
+constexpr size_t LSH_N_BANDS = 16;
+constexpr size_t LSH_ROWS_PER_BAND = MINHASH_SIZE / LSH_N_BANDS;
+
+using MinHashSignature = std::array<uint32_t, MINHASH_SIZE>;
+
+/**
+ * @brief Builds the MinHash signature of a document from the words the tokenizer finds in it.
+ *
+ * Every run of SHINGLE_SIZE consecutive words (a shingle) is hashed once, then through MINHASH_SIZE
+ * multiply-shift hash functions, and the signature keeps the smallest value of each. Two documents
+ * agree on any given minimum with probability equal to the Jaccard similarity of their shingle sets.
+ */
+class MinHasher {
+public:
+    MinHasher();
+
+    void add_word(const std::string & word);
+    bool end_document(MinHashSignature & signature);
+
+private:
+    void add_shingle(uint64_t shingle_hash);
+
+    std::array<uint64_t, SHINGLE_SIZE> ring; // hashes of the last few words
+    size_t n_words_in_document = 0;
+    MinHashSignature minimums;
+};
+
+// a group of files whose text is nearly the same
+struct NearDuplicateCluster {
+    std::vector<std::string> paths;
+    // the lowest estimated Jaccard similarity among the pairs that joined the cluster
+    double min_similarity;
+};
+
+/**
+ * @brief Finds clusters of near-duplicate documents among their MinHash signatures.
+ *
+ * Signatures are split into LSH_N_BANDS bands of LSH_ROWS_PER_BAND minimums; documents sharing a
+ * whole band become candidate pairs, so only likely matches are ever compared. Candidates whose
+ * estimated similarity reaches the threshold are joined with a union-find.
+ */
+class NearDuplicateFinder {
+public:
+    void add_document(const std::string & path, const MinHashSignature & signature);
+    std::vector<NearDuplicateCluster> clusters(double min_similarity) const;
+
+private:
+    std::vector<std::string> paths;
+    std::vector<MinHashSignature> signatures;
+};
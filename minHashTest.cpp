@@ -0,0 +1,107 @@
+#include "minHash.h"
+#include "testing.h"
+
+#include <cmath>
+#include <set>
+#include <string>
+#include <vector>
+
+constexpr int N_PAIRS = 200;
+constexpr int DOCUMENT_LENGTH = 202; // words, so 200 shingles
+constexpr double NEAR_DUPLICATE_THRESHOLD = 0.5;
+
+/**
+ * @brief Writes a document of distinct words, unique to its pair, and a copy of it with a few words
+ *        replaced (each replacement changes the SHINGLE_SIZE shingles it is part of).
+ * @param pair The pair number, which keeps the pairs' vocabularies apart.
+ * @param n_replaced The number of words replaced in the copy, spread over the document.
+ * @return The original and the copy.
+ */
+static std::pair<std::vector<std::string>, std::vector<std::string>> document_pair(int pair, int n_replaced)
+{
+    std::vector<std::string> original;
+    for (int i = 0; i < DOCUMENT_LENGTH; i++) { original.push_back("p" + std::to_string(pair) + "w" + std::to_string(i)); }
+    std::vector<std::string> copy = original;
+    // away from the ends, where a word is part of fewer shingles
+    for (int r = 0; r < n_replaced; r++) { copy[(r * DOCUMENT_LENGTH) / n_replaced + SHINGLE_SIZE - 1] += "x"; }
+    return { original, copy };
+}
+
+static double jaccard_similarity(const std::vector<std::string> & words1, const std::vector<std::string> & words2)
+{
+    auto shingles = [](const std::vector<std::string> & words) {
+        std::set<std::string> set;
+        for (size_t i = 0; i + SHINGLE_SIZE <= words.size(); i++) {
+            std::string shingle;
+            for (size_t j = i; j < i + SHINGLE_SIZE; j++) { shingle += words[j] + " "; }
+            set.insert(shingle);
+        }
+        return set;
+    };
+    std::set<std::string> shingles1 = shingles(words1), shingles2 = shingles(words2);
+    size_t n_shared = 0;
+    for (const std::string & shingle : shingles1) { n_shared += shingles2.count(shingle); }
+    return static_cast<double>(n_shared) / (shingles1.size() + shingles2.size() - n_shared);
+}
+
+/**
+ * @brief Signs N_PAIRS document pairs and clusters them.
+ * @param n_replaced The number of words replaced in each copy.
+ * @param similarity Set to the Jaccard similarity of the pairs (the same for every pair).
+ * @return The clusters found.
+ */
+static std::vector<NearDuplicateCluster> cluster_pairs(int n_replaced, double & similarity)
+{
+    MinHasher hasher;
+    NearDuplicateFinder finder;
+    for (int pair = 0; pair < N_PAIRS; pair++) {
+        auto [original, copy] = document_pair(pair, n_replaced);
+        similarity = jaccard_similarity(original, copy);
+        int version = 0;
+        for (const auto & document : { original, copy }) {
+            for (const std::string & word : document) { hasher.add_word(word); }
+            MinHashSignature signature;
+            CHECK(hasher.end_document(signature));
+            finder.add_document(std::to_string(pair) + "/" + std::to_string(version++), signature);
+        }
+    }
+    return finder.clusters(NEAR_DUPLICATE_THRESHOLD);
+}
+
+TEST_CASE(min_hash_identical_documents_have_identical_signatures)
+{
+    MinHasher hasher;
+    MinHashSignature signature1, signature2;
+    for (const char * word : { "the", "quick", "brown", "fox" }) { hasher.add_word(word); }
+    CHECK(hasher.end_document(signature1));
+    for (const char * word : { "the", "quick", "brown", "fox" }) { hasher.add_word(word); }
+    CHECK(hasher.end_document(signature2));
+    CHECK(signature1 == signature2);
+    CHECK(! hasher.end_document(signature1));
+}
+
+TEST_CASE(min_hash_banding_recall)
+{
+    // at a similarity of about 0.79 a pair shares a whole band with probability 1 - (1 - s^4)^16,
+    // over 0.999, and its estimated similarity is several standard errors above the threshold
+    double similarity = 0;
+    std::vector<NearDuplicateCluster> clusters = cluster_pairs(8, similarity);
+    CHECK(similarity > 0.75 && similarity < 0.8);
+    CHECK(clusters.size() >= N_PAIRS - 2);
+    for (const NearDuplicateCluster & cluster : clusters) {
+        // the pairs share no shingle with each other, so a cluster is always one pair
+        CHECK(cluster.paths.size() == 2);
+        CHECK(cluster.paths[0].substr(0, cluster.paths[0].find('/')) == cluster.paths[1].substr(0, cluster.paths[1].find('/')));
+        CHECK(std::abs(cluster.min_similarity - similarity) < 0.2);
+    }
+}
+
+TEST_CASE(min_hash_dissimilar_pairs_rarely_match)
+{
+    // at a similarity of about 0.25 a pair becomes a candidate with probability about 6%, and even
+    // then its estimate has to reach the threshold
+    double similarity = 0;
+    std::vector<NearDuplicateCluster> clusters = cluster_pairs(40, similarity);
+    CHECK(similarity > 0.2 && similarity < 0.3);
+    CHECK(clusters.size() <= 2);
+}
@@ -0,0 +1,154 @@
+#include "ngramCounter.h"
+
+#include <algorithm>
+#include <iterator>
+
+constexpr char NGRAM_WORD_SEPARATOR = ' ';
+// what a hash table entry costs besides its key and value: the node's next pointer and cached
+// hash, its bucket pointer and malloc's header, roughly
+constexpr size_t HASH_ENTRY_OVERHEAD = 40;
+
+/**
+ * @brief Returns the ID of a word, giving it the next free ID the first time it is seen.
+ */
+uint32_t NGramCounter::intern(const std::string & word)
+{
+    auto [it, inserted] = word_ids.try_emplace(word, static_cast<uint32_t>(words.size()));
+    // keys of an unordered_map never move, so the ID -> word table can point at them
+    if (inserted) { words.push_back(&it->first); }
+    return it->second;
+}
+
+/**
+ * @brief Adds the next word of the current document, counting the n-grams it completes.
+ * @param word The word.
+ */
+void NGramCounter::add_word(const std::string & word)
+{
+    ring[n_words_in_document % MAX_NGRAM_SIZE] = intern(word);
+    n_words_in_document++;
+
+    auto previous = [&](size_t back) { return ring[(n_words_in_document - 1 - back) % MAX_NGRAM_SIZE]; };
+    if (n_words_in_document >= 2) { bigram_counts[{ previous(1), previous(0) }]++; }
+    if (max_n >= 3 && n_words_in_document >= 3) { trigram_counts[{ previous(2), previous(1), previous(0) }]++; }
+}
+
+/**
+ * @brief Ends the current document, so that its last words don't pair up with the next one's.
+ */
+void NGramCounter::end_document()
+{
+    n_words_in_document = 0;
+}
+
+template <size_t N>
+std::vector<std::pair<std::string, int>> NGramCounter::most_common(
+    const std::unordered_map<std::array<uint32_t, N>, int, WordIdTupleHash<N>> & counts, size_t k) const
+{
+    using Entry = std::pair<std::array<uint32_t, N>, int>;
+    std::vector<Entry> entries(counts.begin(), counts.end());
+
+    // same order as WordFrequencyComparator on the joined phrases: comparing word by word gives the
+    // same result as comparing "w1 w2", since the separator sorts before every word character
+    auto comparator = [&](const Entry & ngram1, const Entry & ngram2) {
+        if (ngram1.second != ngram2.second) { return ngram1.second > ngram2.second; }
+        for (size_t i = 0; i < N; i++) {
+            int comparison = words[ngram1.first[i]]->compare(*words[ngram2.first[i]]);
+            if (comparison != 0) { return comparison < 0; }
+        }
+        return false;
+    };
+    k = std::min(k, entries.size());
+    std::partial_sort(entries.begin(), entries.begin() + k, entries.end(), comparator);
+
+    // only the reported n-grams are ever turned back into strings
+    std::vector<std::pair<std::string, int>> top;
+    for (size_t i = 0; i < k; i++) {
+        std::string phrase = *words[entries[i].first[0]];
+        for (size_t w = 1; w < N; w++) { phrase += NGRAM_WORD_SEPARATOR + *words[entries[i].first[w]]; }
+        top.emplace_back(std::move(phrase), entries[i].second);
+    }
+    return top;
+}
+
+/**
+ * @brief Returns the most common n-grams of a given size.
+ * @param n The size of the n-grams (2 or 3).
+ * @param k The number of n-grams to return.
+ * @return The words of each n-gram joined by spaces, with its count, sorted by count (descending)
+ *         and then alphabetically.
+ */
+std::vector<std::pair<std::string, int>> NGramCounter::most_common(int n, size_t k) const
+{
+    return n == 2 ? most_common(bigram_counts, k) : most_common(trigram_counts, k);
+}
+
+/**
+ * @brief Drops the n-grams seen fewer than a given number of times, to save memory. The n-grams
+ *        that are kept still have exact counts, but a dropped one starts over if it shows up again.
+ * @param min_count The count below which n-grams are dropped.
+ * @return The number of n-grams dropped.
+ */
+size_t NGramCounter::prune(int min_count)
+{
+    size_t n_before = bigram_counts.size() + trigram_counts.size();
+    auto prune_counts = [&](auto & counts) {
+        for (auto it = counts.begin(); it != counts.end();) { it = it->second < min_count ? counts.erase(it) : std::next(it); }
+    };
+    prune_counts(bigram_counts);
+    prune_counts(trigram_counts);
+    size_t n_dropped = n_before - bigram_counts.size() - trigram_counts.size();
+    if (n_dropped > 0) { drop_unused_words(); }
+    return n_dropped;
+}
+
+/**
+ * @brief Re-interns only the words still used by a counted n-gram or by the current document,
+ *        giving them new, dense IDs.
+ */
+void NGramCounter::drop_unused_words()
+{
+    constexpr uint32_t NOT_KEPT = UINT32_MAX;
+    std::vector<uint32_t> new_ids(words.size(), NOT_KEPT);
+    std::unordered_map<std::string, uint32_t> kept_word_ids;
+    std::vector<const std::string *> kept_words;
+    auto keep = [&](uint32_t id) {
+        if (new_ids[id] == NOT_KEPT) {
+            auto [it, inserted] = kept_word_ids.emplace(*words[id], static_cast<uint32_t>(kept_words.size()));
+            kept_words.push_back(&it->first);
+            new_ids[id] = it->second;
+        }
+        return new_ids[id];
+    };
+
+    for (size_t back = 0; back < std::min(n_words_in_document, static_cast<size_t>(MAX_NGRAM_SIZE)); back++) {
+        uint32_t & id = ring[(n_words_in_document - 1 - back) % MAX_NGRAM_SIZE];
+        id = keep(id);
+    }
+    auto remap = [&](auto & counts) {
+        std::remove_reference_t<decltype(counts)> remapped;
+        remapped.reserve(counts.size());
+        for (auto & [ids, count] : counts) {
+            auto new_key = ids;
+            for (uint32_t & id : new_key) { id = keep(id); }
+            remapped.emplace(new_key, count);
+        }
+        counts.swap(remapped);
+    };
+    remap(bigram_counts);
+    remap(trigram_counts);
+
+    word_ids.swap(kept_word_ids);
+    words.swap(kept_words);
+}
+
+/**
+ * @brief Estimates the memory held by the counts and the interned words, in bytes.
+ */
+size_t NGramCounter::memory_usage() const
+{
+    size_t usage = bigram_counts.size() * (HASH_ENTRY_OVERHEAD + sizeof(std::array<uint32_t, 2>) + sizeof(int));
+    usage += trigram_counts.size() * (HASH_ENTRY_OVERHEAD + sizeof(std::array<uint32_t, 3>) + sizeof(int));
+    usage += word_ids.size() * (HASH_ENTRY_OVERHEAD + sizeof(std::string) + sizeof(uint32_t) + sizeof(const std::string *));
+    return usage;
+}
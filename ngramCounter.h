@@ -0,0 +1,64 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+constexpr int MAX_NGRAM_SIZE = 3;
+
+/**
+ * @brief Hashes a tuple of word IDs (packed, so that a bigram is a single 64-bit key).
+ */
+template <size_t N>
+struct WordIdTupleHash {
+    size_t operator()(const std::array<uint32_t, N> & ids) const
+    {
+        uint64_t hash = 0;
+        for (uint32_t id : ids) { hash = (hash ^ id) * 0x9E3779B97F4A7C15ULL; }
+        return hash ^ (hash >> 32);
+    }
+};
+
+/**
+ * @brief Counts word n-grams (bigrams and, optionally, trigrams) in the order words come out of the
+ *        tokenizer.
+ *
+ * Each distinct word is interned once to a 32-bit ID, and n-grams are counted in hash tables keyed
+ * by tuples of those IDs, so a phrase costs 8 or 12 bytes of key instead of a concatenated string.
+ * The last few word IDs are kept in a ring, and n-grams never span two documents.
+ */
+class NGramCounter {
+public:
+    NGramCounter() = default;
+    explicit NGramCounter(int max_n) : max_n(max_n) {}
+    // the ID -> word table points into the interning table, so copies would dangle
+    NGramCounter(const NGramCounter &) = delete;
+    NGramCounter & operator=(const NGramCounter &) = delete;
+    NGramCounter(NGramCounter &&) = default;
+    NGramCounter & operator=(NGramCounter &&) = default;
+
+    void add_word(const std::string & word);
+    void end_document();
+    std::vector<std::pair<std::string, int>> most_common(int n, size_t k) const;
+    size_t prune(int min_count);
+    size_t memory_usage() const;
+
+private:
+    uint32_t intern(const std::string & word);
+    void drop_unused_words();
+    template <size_t N>
+    std::vector<std::pair<std::string, int>> most_common(
+        const std::unordered_map<std::array<uint32_t, N>, int, WordIdTupleHash<N>> & counts, size_t k) const;
+
+    int max_n = 1;
+    std::unordered_map<std::string, uint32_t> word_ids;
+    std::vector<const std::string *> words; // the interned words by ID, pointing at the keys of word_ids
+    std::array<uint32_t, MAX_NGRAM_SIZE> ring;
+    size_t n_words_in_document = 0;
+    std::unordered_map<std::array<uint32_t, 2>, int, WordIdTupleHash<2>> bigram_counts;
+    std::unordered_map<std::array<uint32_t, 3>, int, WordIdTupleHash<3>> trigram_counts;
+};
@@ -0,0 +1,74 @@
+#include "ngramCounter.h"
+#include "testing.h"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+using Phrases = std::vector<std::pair<std::string, int>>;
+
+/**
+ * @brief Adds each space-separated word of `text` as one document.
+ */
+static void add_document(NGramCounter & counter, const std::string & text)
+{
+    std::istringstream words(text);
+    std::string word;
+    while (words >> word) { counter.add_word(word); }
+    counter.end_document();
+}
+
+TEST_CASE(ngram_counter_counts_and_orders)
+{
+    NGramCounter counter(3);
+    add_document(counter, "quick brown foxes quick brown foxes quick brown dogs");
+    // ties are ordered alphabetically, word by word
+    CHECK((counter.most_common(2, 3) == Phrases{ { "quick brown", 3 }, { "brown foxes", 2 }, { "foxes quick", 2 } }));
+    CHECK((counter.most_common(3, 2) == Phrases{ { "brown foxes quick", 2 }, { "foxes quick brown", 2 } }));
+    // asking for more than there are returns them all
+    CHECK(counter.most_common(2, 100).size() == 4);
+    CHECK(counter.most_common(3, 100).size() == 4);
+}
+
+TEST_CASE(ngram_counter_never_spans_documents)
+{
+    NGramCounter counter(3);
+    add_document(counter, "alpha bravo");
+    add_document(counter, "charlie delta");
+    add_document(counter, "");
+    add_document(counter, "lonely");
+    add_document(counter, "echo foxtrot golfs");
+    // "bravo charlie" and "delta lonely" would come from words of two files
+    CHECK((counter.most_common(2, 10) == Phrases{ { "alpha bravo", 1 }, { "charlie delta", 1 }, { "echo foxtrot", 1 }, { "foxtrot golfs", 1 } }));
+    CHECK((counter.most_common(3, 10) == Phrases{ { "echo foxtrot golfs", 1 } }));
+}
+
+TEST_CASE(ngram_counter_bigrams_only)
+{
+    NGramCounter counter(2);
+    add_document(counter, "three words here");
+    CHECK(counter.most_common(2, 10).size() == 2);
+    CHECK(counter.most_common(3, 10).empty());
+}
+
+TEST_CASE(ngram_counter_prune)
+{
+    NGramCounter counter(3);
+    add_document(counter, "often often often often rarely heard");
+    add_document(counter, "kept words stay");
+    size_t usage_before = counter.memory_usage();
+    // "often often" (3) and "often often often" (2) are the only ones to survive
+    CHECK(counter.prune(2) == 7);
+    CHECK(counter.memory_usage() < usage_before);
+    CHECK((counter.most_common(2, 10) == Phrases{ { "often often", 3 } }));
+    CHECK((counter.most_common(3, 10) == Phrases{ { "often often often", 2 } }));
+
+    // the words of the current document survive pruning, so its n-grams keep counting across it
+    counter.add_word("alpha");
+    counter.add_word("bravo");
+    CHECK(counter.prune(2) == 1);
+    counter.add_word("charlie");
+    counter.end_document();
+    CHECK((counter.most_common(2, 10) == Phrases{ { "often often", 3 }, { "bravo charlie", 1 } }));
+    CHECK((counter.most_common(3, 10) == Phrases{ { "often often often", 2 }, { "alpha bravo charlie", 1 } }));
+}
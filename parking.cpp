@@ -0,0 +1,96 @@
+#include "parking.h"
+
+#include <climits>
+#ifdef __linux__
+    #include <linux/futex.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#else
+    #include <condition_variable>
+    #include <cstdint>
+    #include <mutex>
+#endif
+
+#ifdef __linux__
+/**
+ * @brief Sleeps while a word holds a value, until futex_wake() is called on it.
+ * @param word The word; only its address and value matter to the kernel.
+ * @param expected Returns at once unless the word still holds this value.
+ *
+ * May also return spuriously (e.g. on a signal), so callers recheck their condition.
+ */
+void futex_wait(std::atomic<uint32_t> & word, uint32_t expected)
+{
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "a futex is a plain 32-bit word");
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+}
+
+/**
+ * @brief Wakes threads sleeping in futex_wait() on a word.
+ * @param word The word.
+ * @param n_threads How many to wake at most.
+ */
+void futex_wake(std::atomic<uint32_t> & word, int n_threads)
+{
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAKE_PRIVATE, n_threads, nullptr, nullptr, 0);
+}
+#else
+// without futexes, sleepers wait on a condition variable picked by the address of their word
+constexpr size_t N_PARKING_BUCKETS = 64;
+
+struct ParkingBucket {
+    std::mutex mutex;
+    std::condition_variable woken;
+};
+
+static ParkingBucket & parking_bucket(const std::atomic<uint32_t> & word)
+{
+    static ParkingBucket buckets[N_PARKING_BUCKETS];
+    return buckets[(reinterpret_cast<uintptr_t>(&word) / sizeof(word)) % N_PARKING_BUCKETS];
+}
+
+/**
+ * @brief Sleeps while a word holds a value, until futex_wake() is called on it. The value is checked
+ *        under the bucket's lock, which futex_wake() takes too, so a wakeup can't slip in between.
+ */
+void futex_wait(std::atomic<uint32_t> & word, uint32_t expected)
+{
+    ParkingBucket & bucket = parking_bucket(word);
+    std::unique_lock<std::mutex> lock(bucket.mutex);
+    if (word.load(std::memory_order_seq_cst) == expected) { bucket.woken.wait(lock); }
+}
+
+/**
+ * @brief Wakes threads sleeping in futex_wait() on a word. Everyone in the bucket is woken, however
+ *        few threads are asked for, since other words may share it; the others go back to sleep.
+ */
+void futex_wake(std::atomic<uint32_t> & word, int)
+{
+    ParkingBucket & bucket = parking_bucket(word);
+    { std::lock_guard<std::mutex> lock(bucket.mutex); }
+    bucket.woken.notify_all();
+}
+#endif
+
+/**
+ * @brief Sleeps until a notification arrives after the key was taken.
+ * @param key The value prepare_wait() returned.
+ */
+void IdleWorkers::wait(uint32_t key)
+{
+    while (epoch.load(std::memory_order_seq_cst) == key) { futex_wait(epoch, key); }
+    n_waiters.fetch_sub(1, std::memory_order_seq_cst);
+}
+
+/**
+ * @brief Wakes waiting workers, if there are any.
+ * @param all Whether to wake all of them instead of one.
+ */
+void IdleWorkers::notify(bool all)
+{
+    // orders the caller's publishing of work before the check for waiters
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (n_waiters.load(std::memory_order_seq_cst) == 0) { return; }
+    epoch.fetch_add(1, std::memory_order_seq_cst);
+    futex_wake(epoch, all ? INT_MAX : 1);
+}
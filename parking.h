@@ -0,0 +1,39 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @brief Lets idle worker threads sleep until there may be work, without a lock on the path that
+ *        hands work out (an "eventcount").
+ *
+ * A worker that found nothing to do calls prepare_wait(), checks the queues once more, and then
+ * either cancel_wait()s (it found something) or wait()s with the key it was given. A producer calls
+ * notify_one() after publishing work; the check between prepare_wait() and wait() is what makes a
+ * wakeup impossible to miss, since the notification bumps the epoch the key came from. Producers pay
+ * a fence and one atomic load when nobody is waiting. Sleeping is a futex on the epoch (a condition
+ * variable on systems without futexes).
+ */
+class IdleWorkers {
+public:
+    uint32_t prepare_wait()
+    {
+        n_waiters.fetch_add(1, std::memory_order_seq_cst);
+        // orders the registration before the caller's last look at the queues
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return epoch.load(std::memory_order_seq_cst);
+    }
+    void cancel_wait() { n_waiters.fetch_sub(1, std::memory_order_seq_cst); }
+    void wait(uint32_t key);
+    void notify_one() { notify(false); }
+    void notify_all() { notify(true); }
+
+private:
+    void notify(bool all);
+
+    std::atomic<uint32_t> epoch { 0 };
+    std::atomic<int> n_waiters { 0 };
+};
+
+void futex_wait(std::atomic<uint32_t> & word, uint32_t expected);
+void futex_wake(std::atomic<uint32_t> & word, int n_threads);
@@ -0,0 +1,135 @@
+#include "pathTable.h"
+
+#include <functional>
+
+constexpr char PATH_TABLE_SEPARATOR = '/';
+
+/**
+ * @brief Returns the ID of a name, giving it one the first time it is seen.
+ * @param name The name.
+ * @return The ID, the same for every call with an equal name.
+ */
+NameId NameTable::intern(std::string_view name)
+{
+    size_t shard_index = std::hash<std::string_view>{}(name) & (N_NAME_SHARDS - 1);
+    Shard & shard = shards[shard_index];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.ids.find(name);
+    if (it != shard.ids.end()) { return it->second; }
+
+    NameId id = static_cast<NameId>(shard.names.size() * N_NAME_SHARDS + shard_index);
+    shard.names.emplace_back(name);
+    shard.ids.emplace(shard.names.back(), id);
+    return id;
+}
+
+/**
+ * @brief Returns the name an ID was given to.
+ * @param id An ID returned by intern().
+ * @return The name, valid for the life of the table.
+ */
+std::string_view NameTable::name(NameId id) const
+{
+    const Shard & shard = shards[id & (N_NAME_SHARDS - 1)];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.names[id / N_NAME_SHARDS];
+}
+
+/**
+ * @brief Returns the number of distinct names interned.
+ */
+size_t NameTable::size() const
+{
+    size_t n_names = 0;
+    for (const Shard & shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        n_names += shard.names.size();
+    }
+    return n_names;
+}
+
+/**
+ * @brief Forgets every name, invalidating their IDs and views.
+ */
+void NameTable::clear()
+{
+    for (Shard & shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.ids.clear();
+        shard.names.clear();
+    }
+}
+
+/**
+ * @brief Adds a path. Each call adds a new node, so a path should be added once and its ID kept.
+ * @param parent The ID of the parent path, or NO_PATH_ID for a path at the top.
+ * @param name The last component of the path.
+ * @return The ID of the path.
+ */
+PathId PathTable::add(PathId parent, std::string_view name)
+{
+    NameId name_id = names.intern(name);
+    std::lock_guard<std::mutex> lock(mutex);
+    nodes.push_back(Node{ parent, name_id });
+    return static_cast<PathId>(nodes.size() - 1);
+}
+
+/**
+ * @brief Returns the ID of a path's parent, or NO_PATH_ID for a path at the top.
+ */
+PathId PathTable::parent(PathId path) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return nodes[path].parent;
+}
+
+/**
+ * @brief Builds the string of a path.
+ * @param path The ID of the path.
+ * @return Its components from the top down, joined by slashes.
+ */
+std::string PathTable::path(PathId path) const
+{
+    std::string joined;
+    append_path(path, joined);
+    return joined;
+}
+
+/**
+ * @brief Appends the string of a path to a buffer, so that building many paths into one reused
+ *        buffer doesn't allocate.
+ * @param path The ID of the path.
+ * @param out The buffer.
+ */
+void PathTable::append_path(PathId path, std::string & out) const
+{
+    Node node;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        node = nodes[path];
+    }
+    if (node.parent != NO_PATH_ID) {
+        append_path(node.parent, out);
+        out += PATH_TABLE_SEPARATOR;
+    }
+    out += names.name(node.name);
+}
+
+/**
+ * @brief Returns the number of paths added.
+ */
+size_t PathTable::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return nodes.size();
+}
+
+/**
+ * @brief Forgets every path and name, invalidating their IDs.
+ */
+void PathTable::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    nodes.clear();
+    names.clear();
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using NameId = uint32_t;
+using PathId = uint32_t;
+
+constexpr PathId NO_PATH_ID = UINT32_MAX;
+constexpr size_t N_NAME_SHARDS = 16; // a power of two, so that IDs can carry their shard in the low bits
+
+/**
+ * @brief Interns path components (file and directory names), so that each distinct name is stored
+ *        once however many directories it appears in.
+ *
+ * Names are spread over shards by hash, each with its own lock, so that threads interning names at
+ * the same time rarely wait for each other. A name's ID is its index within its shard followed by
+ * the shard number, so looking a name up by ID only touches (and locks) that one shard.
+ */
+class NameTable {
+public:
+    NameId intern(std::string_view name);
+    std::string_view name(NameId id) const;
+    size_t size() const;
+    void clear();
+
+private:
+    struct Shard {
+        mutable std::mutex mutex;
+        // the keys are views of the names, which a deque never moves
+        std::unordered_map<std::string_view, NameId> ids;
+        std::deque<std::string> names;
+    };
+
+    std::array<Shard, N_NAME_SHARDS> shards;
+};
+
+/**
+ * @brief Stores paths as chains of (parent, name) nodes, so a path costs 8 bytes on top of its
+ *        parent's instead of a string repeating every directory above it. Paths are only turned back
+ *        into strings when they are reported.
+ *
+ * Nodes are only ever appended, so a PathId stays valid (and means the same path) for the life of
+ * the table. The table is safe to add to and read from several threads.
+ */
+class PathTable {
+public:
+    PathId add(PathId parent, std::string_view name);
+    PathId parent(PathId path) const;
+    std::string path(PathId path) const;
+    void append_path(PathId path, std::string & out) const;
+    size_t size() const;
+    size_t n_names() const { return names.size(); }
+    void clear();
+
+private:
+    struct Node {
+        PathId parent;
+        NameId name;
+    };
+
+    NameTable names;
+    mutable std::mutex mutex;
+    std::vector<Node> nodes;
+};
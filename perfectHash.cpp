@@ -0,0 +1,136 @@
+#include "perfectHash.h"
+
+#include <algorithm>
+
+// the table has at least this many slots per key, so the last buckets still find free slots quickly
+constexpr size_t MIN_SLOTS_PER_KEY = 2;
+constexpr size_t MIN_TABLE_SIZE = 8;
+// the average number of keys per bucket: more buckets make the search faster, fewer make the
+// displacement table smaller
+constexpr size_t KEYS_PER_BUCKET = 4;
+// values of d0 a bucket tries (d1 goes through every slot for each) before the seed is given up
+constexpr uint32_t MAX_D0 = 32;
+// seeds tried for one table size before the table is doubled
+constexpr uint64_t MAX_SEEDS_PER_SIZE = 8;
+
+/**
+ * @brief Mixes all the bits of a hash into all the others (the MurmurHash3 finalizer), so that its
+ *        high and low halves can be used as independent values.
+ */
+static uint64_t mix_hash(uint64_t hash)
+{
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDULL;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+/**
+ * @brief Builds the set, placing every key in its own slot.
+ * @param keys The keys of the set; duplicates are ignored.
+ */
+PerfectHashSet::PerfectHashSet(const std::vector<std::string> & keys)
+{
+    std::vector<std::string> unique_keys = keys;
+    std::sort(unique_keys.begin(), unique_keys.end());
+    unique_keys.erase(std::unique(unique_keys.begin(), unique_keys.end()), unique_keys.end());
+    n_keys = unique_keys.size();
+    for (auto & key : unique_keys) { max_key_size = std::max(max_key_size, key.size()); }
+
+    size_t table_size = MIN_TABLE_SIZE;
+    while (table_size < n_keys * MIN_SLOTS_PER_KEY) { table_size <<= 1; }
+    displacements.resize(std::max<size_t>(1, (n_keys + KEYS_PER_BUCKET - 1) / KEYS_PER_BUCKET));
+
+    for (;; table_size <<= 1) {
+        mask = table_size - 1;
+        for (uint64_t attempt = 0; attempt < MAX_SEEDS_PER_SIZE; attempt++, seed++) {
+            if (place_keys(unique_keys)) { return; }
+        }
+    }
+}
+
+/**
+ * @brief Hashes a key once and derives its bucket and the two values its slot is computed from.
+ */
+PerfectHashSet::KeyHashes PerfectHashSet::key_hashes(std::string_view key) const
+{
+    uint64_t hash = mix_hash(seeded_hash(key, seed));
+    uint64_t second_hash = mix_hash(hash);
+    // the high half is mapped onto the buckets by multiplication, since their number isn't a power of two
+    uint32_t bucket = ((hash >> 32) * displacements.size()) >> 32;
+    return KeyHashes{ bucket, static_cast<uint32_t>(hash), static_cast<uint32_t>(second_hash >> 32) };
+}
+
+/**
+ * @brief Tries to place the keys with the current seed and table size.
+ * @param keys The keys, without duplicates.
+ * @return False if some bucket found no displacement, in which case the table is left to be rebuilt.
+ */
+bool PerfectHashSet::place_keys(const std::vector<std::string> & keys)
+{
+    size_t table_size = mask + 1;
+    slots.assign(table_size, std::string());
+    occupied.assign(table_size, false);
+    std::fill(displacements.begin(), displacements.end(), Displacement{ 0, 0 });
+
+    std::vector<KeyHashes> hashes;
+    hashes.reserve(keys.size());
+    std::vector<std::vector<uint32_t>> buckets(displacements.size());
+    for (uint32_t i = 0; i < keys.size(); i++) {
+        hashes.push_back(key_hashes(keys[i]));
+        buckets[hashes.back().bucket].push_back(i);
+    }
+
+    // largest buckets first, while the table is still empty enough for them; buckets are small, so a
+    // counting sort by size keeps this linear
+    size_t largest = 0;
+    for (auto & bucket : buckets) { largest = std::max(largest, bucket.size()); }
+    std::vector<std::vector<uint32_t>> buckets_by_size(largest + 1);
+    for (uint32_t b = 0; b < buckets.size(); b++) { buckets_by_size[buckets[b].size()].push_back(b); }
+
+    std::vector<uint64_t> bucket_slots;
+    for (size_t size = largest; size > 0; size--) {
+        for (uint32_t b : buckets_by_size[size]) {
+            const std::vector<uint32_t> & bucket = buckets[b];
+            bool placed = false;
+            for (uint32_t d0 = 0; d0 < MAX_D0 && ! placed; d0++) {
+                for (uint32_t d1 = 0; d1 < table_size && ! placed; d1++) {
+                    bucket_slots.clear();
+                    placed = true;
+                    for (uint32_t key : bucket) {
+                        uint64_t slot = (hashes[key].first + uint64_t(d0) * hashes[key].second + d1) & mask;
+                        if (occupied[slot] || std::find(bucket_slots.begin(), bucket_slots.end(), slot) != bucket_slots.end()) {
+                            placed = false;
+                            break;
+                        }
+                        bucket_slots.push_back(slot);
+                    }
+                    if (placed) { displacements[b] = Displacement{ d0, d1 }; }
+                }
+            }
+            // two keys of a bucket with the same hashes modulo the table size can never be separated
+            if (! placed) { return false; }
+            for (size_t k = 0; k < bucket.size(); k++) {
+                occupied[bucket_slots[k]] = true;
+                slots[bucket_slots[k]] = keys[bucket[k]];
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Checks whether a key is in the set.
+ * @param key The key to look up.
+ * @return True if the key is one of the keys the set was built from, false otherwise.
+ */
+bool PerfectHashSet::contains(std::string_view key) const
+{
+    if (n_keys == 0 || key.size() > max_key_size) { return false; }
+    KeyHashes hashes = key_hashes(key);
+    const Displacement & displacement = displacements[hashes.bucket];
+    uint64_t slot = (hashes.first + uint64_t(displacement.d0) * hashes.second + displacement.d1) & mask;
+    return occupied[slot] && slots[slot] == key;
+}
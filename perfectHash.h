@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+constexpr uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+constexpr uint64_t FNV_PRIME = 1099511628211ULL;
+
+/**
+ * @brief Seeded FNV-1a hash of a short string. Changing the seed gives an unrelated hash function,
+ *        which is what the perfect hash searches over.
+ * @param key The string to hash.
+ * @param seed The seed that selects the hash function.
+ * @return The hash of the string.
+ */
+constexpr uint64_t seeded_hash(std::string_view key, uint64_t seed)
+{
+    uint64_t hash = FNV_OFFSET_BASIS ^ (seed * FNV_PRIME);
+    for (char c : key) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= FNV_PRIME;
+    }
+    // fold the high bits down, since the table index only looks at the low ones
+    return hash ^ (hash >> 29);
+}
+
+/**
+ * @brief A fixed set of short strings looked up through a collision-free hash table.
+ *
+ * The table is built by hash and displace (CHD, Belazzougui, Botelho and Dietzfelbinger, ESA 2009):
+ * keys are hashed into small buckets, and the buckets, largest first, each search for a displacement
+ * that moves all their keys into free slots. Early buckets find a fit at once in the nearly empty
+ * table and the late ones hold a single key, so building takes expected linear time. A lookup is one
+ * hash, one displacement, one slot and at most one string comparison, whether the key is present or
+ * not.
+ */
+class PerfectHashSet {
+public:
+    PerfectHashSet() = default;
+    explicit PerfectHashSet(const std::vector<std::string> & keys);
+
+    bool contains(std::string_view key) const;
+    bool empty() const { return n_keys == 0; }
+
+private:
+    // where a key's bucket is, and the two values its displacement combines into a slot
+    struct KeyHashes {
+        uint32_t bucket;
+        uint32_t first;
+        uint32_t second;
+    };
+    // a bucket's keys go to slots (first + d0 * second + d1) & mask
+    struct Displacement {
+        uint32_t d0;
+        uint32_t d1;
+    };
+
+    KeyHashes key_hashes(std::string_view key) const;
+    bool place_keys(const std::vector<std::string> & keys);
+
+    std::vector<std::string> slots; // each key sits in the slot its displaced hash points at; others are empty
+    std::vector<bool> occupied;     // tells an empty slot apart from the empty string
+    std::vector<Displacement> displacements; // one per bucket
+    uint64_t seed = 0;
+    uint64_t mask = 0;
+    size_t max_key_size = 0;
+    size_t n_keys = 0;
+};
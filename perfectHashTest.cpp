@@ -0,0 +1,56 @@
+#include "perfectHash.h"
+#include "testing.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+// generous, so that a slow machine passes; the quadratic seed search took minutes at this size
+constexpr long LARGE_SET_BUILD_LIMIT_MS = 2000;
+
+static std::vector<std::string> numbered_keys(const std::string & prefix, long n)
+{
+    std::vector<std::string> keys;
+    for (long i = 0; i < n; i++) { keys.push_back(prefix + std::to_string(i)); }
+    return keys;
+}
+
+TEST_CASE(perfect_hash_small_sets)
+{
+    PerfectHashSet none;
+    CHECK(none.empty());
+    CHECK(! none.contains(""));
+    CHECK(! none.contains("a"));
+
+    PerfectHashSet empty_key({ "" });
+    CHECK(! empty_key.empty());
+    CHECK(empty_key.contains(""));
+    CHECK(! empty_key.contains("a"));
+
+    PerfectHashSet duplicates({ "txt", "log", "txt", "md", "log" });
+    for (const char * key : { "txt", "log", "md" }) { CHECK(duplicates.contains(key)); }
+    for (const char * key : { "", "tx", "txtx", "LOG", "m" }) { CHECK(! duplicates.contains(key)); }
+}
+
+TEST_CASE(perfect_hash_contains_exactly_its_keys)
+{
+    for (long n_keys : { 1L, 7L, 100L, 5000L }) {
+        PerfectHashSet set(numbered_keys("key", n_keys));
+        for (const std::string & key : numbered_keys("key", n_keys)) { CHECK(set.contains(key)); }
+        for (const std::string & key : numbered_keys("kez", n_keys)) { CHECK(! set.contains(key)); }
+        CHECK(! set.contains("key" + std::to_string(n_keys)));
+    }
+}
+
+TEST_CASE(perfect_hash_builds_large_sets_quickly)
+{
+    std::vector<std::string> keys = numbered_keys("word", 200000);
+    auto start = std::chrono::steady_clock::now();
+    PerfectHashSet set(keys);
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    CHECK(elapsed < LARGE_SET_BUILD_LIMIT_MS);
+    size_t n_found = 0;
+    for (const std::string & key : keys) { n_found += set.contains(key); }
+    CHECK(n_found == keys.size());
+    CHECK(! set.contains("word200000"));
+}
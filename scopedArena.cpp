@@ -0,0 +1,11 @@
+#include "scopedArena.h"
+
+/**
+ * @brief Returns the calling thread's pool of arena blocks. It is never shared between threads, so
+ *        it needs no locking.
+ */
+std::pmr::memory_resource * thread_arena_pool()
+{
+    static thread_local std::pmr::unsynchronized_pool_resource pool(std::pmr::pool_options{ 0, ARENA_LARGEST_POOLED_BLOCK });
+    return &pool;
+}
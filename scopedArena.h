@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+
+constexpr size_t ARENA_INITIAL_BLOCK_SIZE = 4096;
+// arena blocks up to this size are recycled by the thread's pool; larger ones come from the heap
+constexpr size_t ARENA_LARGEST_POOLED_BLOCK = 1 << 20;
+
+std::pmr::memory_resource * thread_arena_pool();
+
+/**
+ * @brief A bump allocator for the temporaries of one scope, such as the stats of one directory.
+ *
+ * Allocations just advance a pointer through the current block, and freeing is a no-op: everything
+ * is released at once when the arena goes out of scope. The blocks come from a pool belonging to
+ * the calling thread, which keeps them for the next arena, so once a traversal has warmed the pool
+ * up, opening and closing arenas doesn't reach the heap at all. An arena must only be used by the
+ * thread that created it.
+ */
+class ScopedArena {
+public:
+    ScopedArena() : arena(ARENA_INITIAL_BLOCK_SIZE, thread_arena_pool()) {}
+    ScopedArena(const ScopedArena &) = delete;
+    ScopedArena & operator=(const ScopedArena &) = delete;
+
+    std::pmr::memory_resource * resource() { return &arena; }
+
+private:
+    std::pmr::monotonic_buffer_resource arena;
+};
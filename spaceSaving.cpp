@@ -0,0 +1,132 @@
+#include "spaceSaving.h"
+
+#include <algorithm>
+
+/**
+ * @brief Counts occurrences of a word.
+ * @param word The word.
+ * @param count The number of occurrences.
+ */
+void SpaceSavingSummary::add(const std::string & word, long count)
+{
+    auto it = positions.find(word);
+    if (it != positions.end()) {
+        counters[it->second].count += count;
+        sift_down(it->second);
+        return;
+    }
+
+    if (counters.size() < capacity) {
+        positions[word] = counters.size();
+        counters.push_back(Counter{ word, count, 0 });
+        sift_up(counters.size() - 1);
+        return;
+    }
+    if (capacity == 0) { return; }
+
+    // the new word takes over the smallest counter, and might have occurred that many times before
+    Counter & evicted = counters[0];
+    positions.erase(evicted.word);
+    evicted.error = evicted.count;
+    evicted.count += count;
+    evicted.word = word;
+    positions[word] = 0;
+    sift_down(0);
+}
+
+/**
+ * @brief Adds another summary's counts to this one, so that this summary covers both streams.
+ *        A word missing from a full summary may have occurred up to that summary's smallest count
+ *        times, so it is credited with that much (as error).
+ * @param other The summary to merge in.
+ */
+void SpaceSavingSummary::merge(const SpaceSavingSummary & other)
+{
+    long this_missing = counters.size() == capacity ? min_count() : 0;
+    long other_missing = other.counters.size() == other.capacity ? other.min_count() : 0;
+
+    std::unordered_map<std::string, Counter> merged;
+    for (auto & counter : counters) {
+        merged[counter.word] = Counter{ counter.word, counter.count + other_missing, counter.error + other_missing };
+    }
+    for (auto & counter : other.counters) {
+        auto it = merged.find(counter.word);
+        if (it != merged.end()) {
+            // it was credited other_missing above, which its real count in the other summary replaces
+            it->second.count += counter.count - other_missing;
+            it->second.error += counter.error - other_missing;
+        } else {
+            merged[counter.word] = Counter{ counter.word, counter.count + this_missing, counter.error + this_missing };
+        }
+    }
+
+    // keep the largest counters, then rebuild the heap
+    std::vector<Counter> kept;
+    kept.reserve(merged.size());
+    for (auto & [word, counter] : merged) { kept.push_back(std::move(counter)); }
+    if (kept.size() > capacity) {
+        std::nth_element(kept.begin(), kept.begin() + capacity, kept.end(), [](const Counter & a, const Counter & b) {
+            return a.count > b.count;
+        });
+        kept.resize(capacity);
+    }
+
+    counters = std::move(kept);
+    positions.clear();
+    for (size_t i = 0; i < counters.size(); i++) { positions[counters[i].word] = i; }
+    for (size_t i = counters.size() / 2; i-- > 0;) { sift_down(i); }
+}
+
+/**
+ * @brief Returns the words with the highest estimated counts.
+ * @param k The number of words to return.
+ * @return The words with their estimated counts (upper bounds on the true counts), sorted by count
+ *         (descending) and then alphabetically, like WordFrequencyComparator.
+ */
+std::vector<std::pair<std::string, int>> SpaceSavingSummary::top(size_t k) const
+{
+    std::vector<std::pair<std::string, int>> words;
+    for (auto & counter : counters) { words.emplace_back(counter.word, counter.count); }
+    k = std::min(k, words.size());
+    std::partial_sort(words.begin(), words.begin() + k, words.end(), [](const auto & word1, const auto & word2) {
+        if (word1.second != word2.second) { return word1.second > word2.second; }
+        return word1.first < word2.first;
+    });
+    words.resize(k);
+    return words;
+}
+
+long SpaceSavingSummary::min_count() const
+{
+    return counters.empty() ? 0 : counters[0].count;
+}
+
+void SpaceSavingSummary::sift_down(size_t position)
+{
+    while (true) {
+        size_t smallest = position;
+        for (size_t child = 2 * position + 1; child <= 2 * position + 2 && child < counters.size(); child++) {
+            if (counters[child].count < counters[smallest].count) { smallest = child; }
+        }
+        if (smallest == position) { return; }
+        swap_counters(position, smallest);
+        position = smallest;
+    }
+}
+
+void SpaceSavingSummary::sift_up(size_t position)
+{
+    while (position > 0) {
+        size_t parent = (position - 1) / 2;
+        if (counters[parent].count <= counters[position].count) { return; }
+        swap_counters(position, parent);
+        position = parent;
+    }
+}
+
+void SpaceSavingSummary::swap_counters(size_t a, size_t b)
+{
+    std::swap(counters[a], counters[b]);
+    positions[counters[a].word] = a;
+    positions[counters[b].word] = b;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief A Space-Saving summary: approximate counts of the most frequent words of a stream, in
+ *        memory bounded by a fixed number of counters.
+ *
+ * While there is room every word gets an exact counter. Once the summary is full, a new word takes
+ * over the smallest counter and inherits its count, which is remembered as the word's possible
+ * overestimate. Any word occurring more than (total / capacity) times is guaranteed to be kept.
+ * Summaries of two streams can be merged into a summary of the combined stream with the same
+ * guarantee, which is how per-directory summaries roll up into their parents.
+ */
+class SpaceSavingSummary {
+public:
+    SpaceSavingSummary() = default;
+    explicit SpaceSavingSummary(size_t capacity) : capacity(capacity) {}
+
+    void add(const std::string & word, long count = 1);
+    void merge(const SpaceSavingSummary & other);
+    std::vector<std::pair<std::string, int>> top(size_t k) const;
+    size_t size() const { return counters.size(); }
+
+private:
+    struct Counter {
+        std::string word;
+        long count;
+        long error; // how much of count may have been inherited from evicted words
+    };
+
+    long min_count() const;
+    void sift_down(size_t position);
+    void sift_up(size_t position);
+    void swap_counters(size_t a, size_t b);
+
+    size_t capacity = 0;
+    // min-heap on count, so the counter to evict is always at the root
+    std::vector<Counter> counters;
+    std::unordered_map<std::string, size_t> positions; // word -> index in counters
+};
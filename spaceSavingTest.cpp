@@ -0,0 +1,170 @@
+#include "analyzeDir.h"
+#include "spaceSaving.h"
+#include "testing.h"
+#include "wordTokenizer.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+constexpr size_t SUMMARY_CAPACITY = 50;
+constexpr int N_DISTINCT_WORDS = 2000;
+constexpr long STREAM_LENGTH = 100000;
+
+/**
+ * @brief Spells a word number in letters (e.g. 0 -> "wab", 27 -> "wbbb"), since digits aren't part of
+ *        words when the scan tokenizes text.
+ */
+static std::string word_name(int number)
+{
+    std::string name = "w";
+    do {
+        name += static_cast<char>('a' + number % 26);
+        number /= 26;
+    } while (number > 0);
+    return name + "b";
+}
+
+/**
+ * @brief Draws a skewed stream of words (word i is drawn about 1/(i+1) as often as word 0), so that
+ *        a few words are frequent and most are evicted over and over.
+ * @param seed Seeds the generator, so that two streams can differ.
+ * @param reversed Whether to favour the last words instead of the first ones.
+ * @return The words in the order drawn.
+ */
+static std::vector<std::string> skewed_stream(unsigned seed, bool reversed = false)
+{
+    std::vector<double> weights;
+    for (int i = 0; i < N_DISTINCT_WORDS; i++) { weights.push_back(1.0 / ((reversed ? N_DISTINCT_WORDS - 1 - i : i) + 1)); }
+    std::mt19937 generator(seed);
+    std::discrete_distribution<int> distribution(weights.begin(), weights.end());
+    std::vector<std::string> stream;
+    for (long i = 0; i < STREAM_LENGTH; i++) { stream.push_back(word_name(distribution(generator))); }
+    return stream;
+}
+
+/**
+ * @brief Checks the Space-Saving guarantees of a summary against the true counts of its stream:
+ *        every estimate is an upper bound that overshoots by at most (total / capacity), and every
+ *        word occurring more often than that is kept.
+ */
+static void check_bounds(const SpaceSavingSummary & summary, const std::map<std::string, long> & true_counts, long total)
+{
+    long max_error = total / static_cast<long>(SUMMARY_CAPACITY);
+    auto estimates = summary.top(SUMMARY_CAPACITY);
+    CHECK(estimates.size() == SUMMARY_CAPACITY);
+    for (auto & [word, estimate] : estimates) {
+        long true_count = true_counts.count(word) ? true_counts.at(word) : 0;
+        CHECK(estimate >= true_count);
+        CHECK(estimate - true_count <= max_error);
+    }
+    for (auto & [word, true_count] : true_counts) {
+        if (true_count <= max_error) { continue; }
+        bool kept = std::any_of(estimates.begin(), estimates.end(), [&](const auto & estimate) { return estimate.first == word; });
+        CHECK(kept);
+    }
+}
+
+TEST_CASE(space_saving_exact_while_not_full)
+{
+    SpaceSavingSummary summary(SUMMARY_CAPACITY);
+    summary.add("b", 3);
+    summary.add("a", 3);
+    summary.add("c");
+    summary.add("c");
+    auto top = summary.top(10);
+    CHECK(top.size() == 3);
+    CHECK(top[0] == std::make_pair(std::string("a"), 3));
+    CHECK(top[1] == std::make_pair(std::string("b"), 3));
+    CHECK(top[2] == std::make_pair(std::string("c"), 2));
+}
+
+TEST_CASE(space_saving_overestimate_bound)
+{
+    std::vector<std::string> stream = skewed_stream(1);
+    SpaceSavingSummary summary(SUMMARY_CAPACITY);
+    std::map<std::string, long> true_counts;
+    for (const std::string & word : stream) {
+        summary.add(word);
+        true_counts[word]++;
+    }
+    CHECK(summary.size() == SUMMARY_CAPACITY);
+    check_bounds(summary, true_counts, STREAM_LENGTH);
+}
+
+TEST_CASE(space_saving_merge_keeps_bound)
+{
+    std::vector<std::string> stream1 = skewed_stream(2);
+    // the second stream favours other words, so the two summaries disagree on what is frequent
+    std::vector<std::string> stream2 = skewed_stream(3, true);
+
+    SpaceSavingSummary summary1(SUMMARY_CAPACITY);
+    SpaceSavingSummary summary2(SUMMARY_CAPACITY);
+    std::map<std::string, long> true_counts;
+    for (const std::string & word : stream1) {
+        summary1.add(word);
+        true_counts[word]++;
+    }
+    for (const std::string & word : stream2) {
+        summary2.add(word);
+        true_counts[word]++;
+    }
+    summary1.merge(summary2);
+    CHECK(summary1.size() == SUMMARY_CAPACITY);
+    check_bounds(summary1, true_counts, 2 * STREAM_LENGTH);
+}
+
+TEST_CASE(space_saving_merge_of_small_summaries_is_exact)
+{
+    SpaceSavingSummary summary1(SUMMARY_CAPACITY);
+    SpaceSavingSummary summary2(SUMMARY_CAPACITY);
+    summary1.add("shared", 4);
+    summary1.add("left", 2);
+    summary2.add("shared", 1);
+    summary2.add("right", 3);
+    summary1.merge(summary2);
+    auto top = summary1.top(10);
+    CHECK(top.size() == 3);
+    CHECK(top[0] == std::make_pair(std::string("shared"), 5));
+    CHECK(top[1] == std::make_pair(std::string("right"), 3));
+    CHECK(top[2] == std::make_pair(std::string("left"), 2));
+}
+
+TEST_CASE(word_counts_survive_memory_governor)
+{
+    // any budget is below the resident set size, so the governor summarizes the word table at its
+    // first check; the stream has fewer distinct words than the summary holds, so counts stay exact
+    char directory[] = "/tmp/spaceSavingTestXXXXXX";
+    CHECK(mkdtemp(directory) != nullptr);
+    std::string file_path = std::string(directory) + "/words.txt";
+    std::map<std::string, int> true_counts;
+    {
+        std::ofstream file(file_path);
+        for (const std::string & word : skewed_stream(4)) {
+            file << word << '\n';
+            if (word.size() >= MIN_WORD_SIZE) { true_counts[word]++; }
+        }
+    }
+    std::vector<std::pair<std::string, int>> exact(true_counts.begin(), true_counts.end());
+    std::stable_sort(exact.begin(), exact.end(), [](const auto & word1, const auto & word2) { return word1.second > word2.second; });
+    exact.resize(20);
+
+    run_in_child_process([&] {
+        CHECK(chdir(directory) == 0);
+        AnalyzeOptions options;
+        options.native_images = true;
+        options.use_identify = false;
+        options.max_memory_mb = 1;
+        Results governed = analyzeDir(20, options);
+        CHECK(std::find(governed.degraded_analyzers.begin(), governed.degraded_analyzers.end(), "word counts (approximate from then on)")
+            != governed.degraded_analyzers.end());
+        CHECK(governed.most_common_words == exact);
+    });
+    unlink(file_path.c_str());
+    rmdir(directory);
+}
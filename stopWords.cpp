@@ -0,0 +1,19 @@
+#include "stopWords.h"
+
+#include <algorithm>
+#include <cctype>
+
+/**
+ * @brief Builds the filter.
+ * @param builtin Whether to drop the built-in stop words.
+ * @param user_words Extra words to drop; they are matched case-insensitively.
+ */
+StopWordFilter::StopWordFilter(bool builtin, const std::vector<std::string> & user_words) : builtin(builtin)
+{
+    std::vector<std::string> lowercase_words;
+    for (auto word : user_words) {
+        std::transform(word.begin(), word.end(), word.begin(), ::tolower);
+        lowercase_words.push_back(word);
+    }
+    this->user_words = PerfectHashSet(lowercase_words);
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "perfectHash.h"
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// only words of 5+ letters are ever counted, so shorter stop words ("the", "and", ...) are left out
+constexpr std::string_view BUILTIN_STOP_WORDS[] = {
+    "about",     "above",     "across",   "after",      "again",    "against",  "along",      "already",
+    "although",  "always",    "among",    "another",    "anything", "around",   "because",    "become",
+    "becomes",   "before",    "behind",   "being",      "below",    "beside",   "besides",    "between",
+    "beyond",    "cannot",    "could",    "doing",      "during",   "either",   "enough",     "every",
+    "everything", "further",  "having",   "herself",    "himself",  "however",  "itself",     "might",
+    "myself",    "nothing",   "often",    "other",      "others",   "ought",    "ourselves",  "perhaps",
+    "quite",     "rather",    "really",   "shall",      "should",   "since",    "something",  "still",
+    "their",     "theirs",    "themselves", "there",    "these",    "thing",    "things",     "those",
+    "though",    "through",   "together", "toward",     "towards",  "under",    "unless",     "until",
+    "whatever",  "whenever",  "where",    "wherever",   "whether",  "which",    "while",      "whose",
+    "within",    "without",   "would",    "yours",      "yourself", "yourselves",
+};
+constexpr size_t N_BUILTIN_STOP_WORDS = sizeof(BUILTIN_STOP_WORDS) / sizeof(BUILTIN_STOP_WORDS[0]);
+constexpr size_t STOP_WORD_TABLE_SIZE = 1024;
+constexpr uint64_t STOP_WORD_NO_SEED = ~0ULL;
+// slots of the built-in table hold the index of their word plus one, so that 0 means empty
+constexpr uint8_t STOP_WORD_EMPTY_SLOT = 0;
+
+/**
+ * @brief Searches, at compile time, for a seed under which every built-in stop word gets its own slot.
+ * @return The first such seed, or STOP_WORD_NO_SEED if none was found.
+ */
+constexpr uint64_t find_stop_word_seed()
+{
+    for (uint64_t seed = 0; seed < STOP_WORD_TABLE_SIZE; seed++) {
+        std::array<bool, STOP_WORD_TABLE_SIZE> used = {};
+        bool collision = false;
+        for (size_t i = 0; i < N_BUILTIN_STOP_WORDS && ! collision; i++) {
+            size_t slot = seeded_hash(BUILTIN_STOP_WORDS[i], seed) & (STOP_WORD_TABLE_SIZE - 1);
+            collision = used[slot];
+            used[slot] = true;
+        }
+        if (! collision) { return seed; }
+    }
+    return STOP_WORD_NO_SEED;
+}
+
+constexpr uint64_t STOP_WORD_SEED = find_stop_word_seed();
+static_assert(STOP_WORD_SEED != STOP_WORD_NO_SEED, "no perfect hash seed for the built-in stop words");
+
+constexpr std::array<uint8_t, STOP_WORD_TABLE_SIZE> build_stop_word_table()
+{
+    std::array<uint8_t, STOP_WORD_TABLE_SIZE> table = {};
+    for (size_t i = 0; i < N_BUILTIN_STOP_WORDS; i++) {
+        table[seeded_hash(BUILTIN_STOP_WORDS[i], STOP_WORD_SEED) & (STOP_WORD_TABLE_SIZE - 1)] = i + 1;
+    }
+    return table;
+}
+
+constexpr std::array<uint8_t, STOP_WORD_TABLE_SIZE> STOP_WORD_TABLE = build_stop_word_table();
+
+/**
+ * @brief Checks a word against the built-in stop words: one hash, one table slot and at most one
+ *        string comparison.
+ * @param word The lowercase word.
+ * @return True if the word is a built-in stop word, false otherwise.
+ */
+constexpr bool is_builtin_stop_word(std::string_view word)
+{
+    uint8_t entry = STOP_WORD_TABLE[seeded_hash(word, STOP_WORD_SEED) & (STOP_WORD_TABLE_SIZE - 1)];
+    return entry != STOP_WORD_EMPTY_SLOT && BUILTIN_STOP_WORDS[entry - 1] == word;
+}
+
+static_assert(is_builtin_stop_word("which") && ! is_builtin_stop_word("whiches"));
+
+/**
+ * @brief The words the tokenizer drops before they are recorded anywhere: the built-in list and/or
+ *        a user list, which is compiled into its own perfect hash at startup.
+ */
+class StopWordFilter {
+public:
+    StopWordFilter() = default;
+    StopWordFilter(bool builtin, const std::vector<std::string> & user_words);
+
+    bool empty() const { return ! builtin && user_words.empty(); }
+    bool contains(std::string_view word) const
+    {
+        return (builtin && is_builtin_stop_word(word)) || user_words.contains(word);
+    }
+
+private:
+    bool builtin = false;
+    PerfectHashSet user_words;
+};
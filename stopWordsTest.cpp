@@ -0,0 +1,84 @@
+#include "analyzeDir.h"
+#include "stopWords.h"
+#include "testing.h"
+
+#include <chrono>
+#include <climits>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+constexpr long N_USER_STOP_WORDS = 10000;
+// a list this long took 30 seconds with the old seed search; it should take a few milliseconds
+constexpr long STOP_WORD_LOAD_LIMIT_MS = 200;
+
+/**
+ * @brief Makes a long user list of letter-only words in mixed case, like a real word list.
+ */
+static std::vector<std::string> long_word_list()
+{
+    std::vector<std::string> words;
+    for (long i = 0; i < N_USER_STOP_WORDS; i++) {
+        std::string word = "Stop";
+        for (long n = i; n > 0 || word.size() == 4; n /= 26) { word += static_cast<char>('a' + n % 26); }
+        words.push_back(word);
+    }
+    return words;
+}
+
+TEST_CASE(stop_word_filter_lists)
+{
+    StopWordFilter none;
+    CHECK(none.empty());
+    CHECK(! none.contains("which"));
+
+    StopWordFilter builtin(true, {});
+    CHECK(! builtin.empty());
+    CHECK(builtin.contains("which") && builtin.contains("themselves"));
+    CHECK(! builtin.contains("github") && ! builtin.contains("whiches"));
+
+    // user words are matched case-insensitively, so they are stored lowercase
+    StopWordFilter user(false, { "GitHub", "Readme" });
+    CHECK(user.contains("github") && user.contains("readme"));
+    CHECK(! user.contains("which"));
+}
+
+TEST_CASE(stop_word_filter_loads_long_lists_quickly)
+{
+    std::vector<std::string> words = long_word_list();
+    auto start = std::chrono::steady_clock::now();
+    StopWordFilter filter(true, words);
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    CHECK(elapsed < STOP_WORD_LOAD_LIMIT_MS);
+
+    size_t n_found = 0;
+    for (std::string word : words) {
+        word[0] = 's';
+        n_found += filter.contains(word);
+    }
+    CHECK(n_found == words.size());
+    CHECK(filter.contains("which"));
+    CHECK(! filter.contains("github"));
+}
+
+TEST_CASE(analyze_dir_with_long_stop_word_list)
+{
+    // the scan compiles the list at its start, so a slow build would show up in the whole scan
+    AnalyzeOptions options;
+    options.native_images = true;
+    options.use_identify = false;
+    options.stop_words = long_word_list();
+    options.stop_words.push_back("GITHUB");
+
+    char original_directory[PATH_MAX];
+    bool saved = getcwd(original_directory, sizeof(original_directory)) != nullptr;
+    CHECK(chdir("tests/test2") == 0);
+    auto start = std::chrono::steady_clock::now();
+    Results results = analyzeDir(5, options);
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    if (saved && chdir(original_directory) != 0) { CHECK(! "could not return to the original directory"); }
+
+    CHECK(elapsed < STOP_WORD_LOAD_LIMIT_MS);
+    CHECK(results.n_files == 2);
+    for (auto & [word, count] : results.most_common_words) { CHECK(word != "github"); }
+}
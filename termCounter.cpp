@@ -0,0 +1,164 @@
+#include "termCounter.h"
+
+#include <algorithm>
+#include <queue>
+
+constexpr uint32_t ROOT_STATE = 0;
+constexpr uint32_t NO_STATE = UINT32_MAX;
+constexpr uint16_t OTHER_BYTES_CLASS = 0;
+
+/**
+ * @brief Compiles the terms into the automaton.
+ * @param terms The terms; their index is what scan() counts matches under.
+ */
+TermMatcher::TermMatcher(const std::vector<std::string> & terms)
+{
+    for (auto & term : terms) {
+        for (unsigned char c : term) {
+            if (byte_classes[c] == OTHER_BYTES_CLASS) { byte_classes[c] = n_classes++; }
+        }
+    }
+
+    // the trie of the terms, with the terms ending at each state
+    transitions.assign(n_classes, NO_STATE);
+    std::vector<std::vector<uint32_t>> state_outputs(1);
+    for (uint32_t i = 0; i < terms.size(); i++) {
+        uint32_t state = ROOT_STATE;
+        for (unsigned char c : terms[i]) {
+            uint32_t & next = transitions[state * n_classes + byte_classes[c]];
+            if (next == NO_STATE) {
+                next = state_outputs.size();
+                state_outputs.emplace_back();
+                transitions.resize(transitions.size() + n_classes, NO_STATE);
+            }
+            state = transitions[state * n_classes + byte_classes[c]];
+        }
+        state_outputs[state].push_back(i);
+    }
+
+    // breadth first, every state's failure state is shallower and already complete, so missing
+    // transitions can be copied from it and its outputs appended
+    std::vector<uint32_t> failures(state_outputs.size(), ROOT_STATE);
+    std::queue<uint32_t> pending;
+    for (size_t c = 0; c < n_classes; c++) {
+        uint32_t & next = transitions[ROOT_STATE * n_classes + c];
+        if (next == NO_STATE) {
+            next = ROOT_STATE;
+        } else {
+            pending.push(next);
+        }
+    }
+    while (! pending.empty()) {
+        uint32_t state = pending.front();
+        pending.pop();
+        uint32_t failure = failures[state];
+        state_outputs[state].insert(state_outputs[state].end(), state_outputs[failure].begin(), state_outputs[failure].end());
+        for (size_t c = 0; c < n_classes; c++) {
+            uint32_t & next = transitions[state * n_classes + c];
+            if (next == NO_STATE) {
+                next = transitions[failure * n_classes + c];
+            } else {
+                failures[next] = transitions[failure * n_classes + c];
+                pending.push(next);
+            }
+        }
+    }
+
+    for (auto & terms_ending_here : state_outputs) {
+        output_offsets.push_back(outputs.size());
+        outputs.insert(outputs.end(), terms_ending_here.begin(), terms_ending_here.end());
+    }
+    output_offsets.push_back(outputs.size());
+}
+
+/**
+ * @brief Scans the next block of a stream.
+ * @param data The block.
+ * @param size The size of the block.
+ * @param state The automaton state, carried from one block to the next so that terms spanning two
+ *        blocks are found (start at 0).
+ * @param counts Incremented at the index of each term found.
+ */
+void TermMatcher::scan(const unsigned char * data, size_t size, uint32_t & state, std::vector<long> & counts) const
+{
+    if (transitions.empty()) { return; }
+    uint32_t current = state;
+    for (size_t i = 0; i < size; i++) {
+        current = transitions[current * n_classes + byte_classes[data[i]]];
+        for (uint32_t o = output_offsets[current]; o < output_offsets[current + 1]; o++) { counts[outputs[o]]++; }
+    }
+    state = current;
+}
+
+/**
+ * @brief Builds the counter.
+ * @param terms The terms to count; repeated and empty terms are dropped.
+ * @param n_top_files The number of files to report per term.
+ */
+TermCounter::TermCounter(const std::vector<std::string> & terms, size_t n_top_files) : n_top_files(n_top_files)
+{
+    for (auto & term : terms) {
+        if (! term.empty() && std::find(this->terms.begin(), this->terms.end(), term) == this->terms.end()) {
+            this->terms.push_back(term);
+        }
+    }
+    matcher = TermMatcher(this->terms);
+    file_counts.assign(this->terms.size(), 0);
+    totals.assign(this->terms.size(), 0);
+    top_files.resize(this->terms.size());
+}
+
+// the order files are reported in: by count (descending) and then by path
+static bool ranks_before(long count1, const std::string & path1, long count2, const std::string & path2)
+{
+    if (count1 != count2) { return count1 > count2; }
+    return path1 < path2;
+}
+
+static bool file_ranks_before(const std::pair<std::string, long> & file1, const std::pair<std::string, long> & file2)
+{
+    return ranks_before(file1.second, file1.first, file2.second, file2.first);
+}
+
+/**
+ * @brief Ends the current file, adding its counts to the totals and keeping it among the files a term
+ *        occurs in most if it ranks high enough.
+ * @param path The path reported for the file.
+ */
+void TermCounter::end_file(const std::string & path)
+{
+    for (size_t i = 0; i < terms.size(); i++) {
+        long count = file_counts[i];
+        if (count == 0) { continue; }
+        totals[i] += count;
+        file_counts[i] = 0;
+        auto & heap = top_files[i];
+        if (heap.size() < n_top_files) {
+            heap.emplace_back(path, count);
+            std::push_heap(heap.begin(), heap.end(), file_ranks_before);
+        } else if (! heap.empty() && ranks_before(count, path, heap.front().second, heap.front().first)) {
+            std::pop_heap(heap.begin(), heap.end(), file_ranks_before);
+            heap.back().first = path;
+            heap.back().second = count;
+            std::push_heap(heap.begin(), heap.end(), file_ranks_before);
+        }
+    }
+    state = 0;
+}
+
+/**
+ * @brief Returns the count of each term, in the order the terms were given.
+ * @return The counts, each with the files the term occurs in most, sorted by count (descending)
+ *         and then by path.
+ */
+std::vector<TermCount> TermCounter::results() const
+{
+    std::vector<TermCount> counts;
+    counts.reserve(terms.size());
+    for (size_t i = 0; i < terms.size(); i++) {
+        std::vector<std::pair<std::string, long>> files = top_files[i]; // at most n_top_files
+        std::sort_heap(files.begin(), files.end(), file_ranks_before);
+        counts.push_back(TermCount{ terms[i], totals[i], std::move(files) });
+    }
+    return counts;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Finds every occurrence of a fixed set of terms in a byte stream in one pass (Aho-Corasick).
+ *
+ * The terms are compiled once into a deterministic automaton, so scanning costs one table lookup
+ * per byte however many terms there are. Bytes that appear in no term share a single column of the
+ * table, which keeps it small for long term lists. Matches are exact and case-sensitive, and
+ * overlapping matches all count.
+ */
+class TermMatcher {
+public:
+    TermMatcher() = default;
+    explicit TermMatcher(const std::vector<std::string> & terms);
+
+    void scan(const unsigned char * data, size_t size, uint32_t & state, std::vector<long> & counts) const;
+
+private:
+    std::array<uint16_t, 256> byte_classes = {}; // 0 for bytes that appear in no term; up to 256 others
+    size_t n_classes = 1;
+    std::vector<uint32_t> transitions;    // state * n_classes + class -> next state
+    std::vector<uint32_t> output_offsets; // terms ending at state s are outputs[output_offsets[s]..output_offsets[s + 1]]
+    std::vector<uint32_t> outputs;
+};
+
+// the number of occurrences of one term, and the files it occurs in most
+struct TermCount {
+    std::string term;
+    long count;
+    std::vector<std::pair<std::string, long>> top_files;
+};
+
+/**
+ * @brief Counts the occurrences of a set of terms across files, fed with the same blocks as the word
+ *        tokenizer. Only the files each term occurs in most are kept, in a heap of bounded size, so
+ *        memory doesn't grow with the number of files.
+ */
+class TermCounter {
+public:
+    TermCounter() = default;
+    TermCounter(const std::vector<std::string> & terms, size_t n_top_files);
+
+    bool empty() const { return terms.empty(); }
+    void feed(const unsigned char * data, size_t size) { matcher.scan(data, size, state, file_counts); }
+    void end_file(const std::string & path);
+    std::vector<TermCount> results() const;
+
+private:
+    std::vector<std::string> terms;
+    size_t n_top_files = 0;
+    TermMatcher matcher;
+    uint32_t state = 0;
+    std::vector<long> file_counts; // occurrences of each term in the current file
+    std::vector<long> totals;
+    std::vector<std::vector<std::pair<std::string, long>>> top_files; // per term, a heap of the files it occurs in most, the last ranked on top
+};
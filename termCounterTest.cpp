@@ -0,0 +1,137 @@
+#include "termCounter.h"
+#include "testing.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+static std::vector<long> count_terms(const std::vector<std::string> & terms, const std::vector<std::string> & blocks)
+{
+    TermMatcher matcher(terms);
+    std::vector<long> counts(terms.size(), 0);
+    uint32_t state = 0;
+    for (const std::string & block : blocks) {
+        matcher.scan(reinterpret_cast<const unsigned char *>(block.data()), block.size(), state, counts);
+    }
+    return counts;
+}
+
+// every position each term starts at, overlapping or not
+static long naive_count(const std::string & term, const std::string & text)
+{
+    long count = 0;
+    for (size_t position = text.find(term); position != std::string::npos; position = text.find(term, position + 1)) { count++; }
+    return count;
+}
+
+TEST_CASE(term_matcher_overlapping_terms)
+{
+    // the textbook example: "ushers" holds "she", "he" and "hers", all overlapping
+    CHECK((count_terms({ "he", "she", "his", "hers" }, { "ushers" }) == std::vector<long>{ 1, 1, 0, 1 }));
+    // a term overlapping itself
+    CHECK((count_terms({ "aa", "aaa" }, { "aaaaa" }) == std::vector<long>{ 4, 3 }));
+    // a term inside another, found through failure links rather than the trie
+    CHECK((count_terms({ "abcd", "bc", "c" }, { "xabcdx" }) == std::vector<long>{ 1, 1, 1 }));
+}
+
+TEST_CASE(term_matcher_terms_across_blocks)
+{
+    CHECK((count_terms({ "hers", "she" }, { "us", "h", "ers" }) == std::vector<long>{ 1, 1 }));
+    CHECK((count_terms({ "aa" }, { "a", "a", "a" }) == std::vector<long>{ 2 }));
+}
+
+TEST_CASE(term_matcher_matches_naive_search)
+{
+    // a small alphabet, so that terms overlap and share prefixes and suffixes all the time
+    std::mt19937 generator(7);
+    std::uniform_int_distribution<int> letter(0, 2);
+    std::uniform_int_distribution<int> term_length(1, 5);
+    std::uniform_int_distribution<int> block_length(0, 50);
+    for (int round = 0; round < 100; round++) {
+        std::vector<std::string> terms(10);
+        for (std::string & term : terms) {
+            for (int i = term_length(generator); i > 0; i--) { term += static_cast<char>('a' + letter(generator)); }
+        }
+        std::vector<std::string> blocks(20);
+        std::string text;
+        for (std::string & block : blocks) {
+            for (int i = block_length(generator); i > 0; i--) { block += static_cast<char>('a' + letter(generator)); }
+            text += block;
+        }
+        std::vector<long> counts = count_terms(terms, blocks);
+        for (size_t i = 0; i < terms.size(); i++) { CHECK(counts[i] == naive_count(terms[i], text)); }
+    }
+}
+
+TEST_CASE(term_matcher_every_byte_value)
+{
+    // one term per byte value: 256 classes besides the one for bytes in no term, which must neither
+    // wrap around nor be handed out twice when a later term repeats a byte
+    std::vector<std::string> terms;
+    std::string text;
+    for (int c = 0; c < 256; c++) {
+        terms.push_back(std::string(1, static_cast<char>(c)) + "!");
+        text += terms.back();
+    }
+    terms.push_back("\xFF\xFF");
+    std::vector<long> counts = count_terms(terms, { text });
+    for (int c = 0; c < 256; c++) { CHECK(counts[c] == (c == '!' ? 2 : 1)); }
+    CHECK(counts[256] == 0);
+}
+
+TEST_CASE(term_counter_counts_per_file)
+{
+    TermCounter counter({ "ab", "", "b", "ab" }, 5);
+    auto feed = [&](const std::string & text) { counter.feed(reinterpret_cast<const unsigned char *>(text.data()), text.size()); };
+    feed("abab");
+    counter.end_file("one");
+    // a match must not span two files
+    feed("xa");
+    counter.end_file("two");
+    feed("bb");
+    counter.end_file("three");
+
+    std::vector<TermCount> results = counter.results();
+    CHECK(results.size() == 2);
+    CHECK(results[0].term == "ab" && results[0].count == 2);
+    CHECK((results[0].top_files == std::vector<std::pair<std::string, long>>{ { "one", 2 } }));
+    CHECK(results[1].term == "b" && results[1].count == 4);
+    CHECK((results[1].top_files == std::vector<std::pair<std::string, long>>{ { "one", 2 }, { "three", 2 } }));
+}
+
+TEST_CASE(term_counter_keeps_top_files)
+{
+    // many files, in an order unrelated to their rank, with ties broken by path
+    const size_t n_top_files = 3;
+    TermCounter counter({ "x" }, n_top_files);
+    std::vector<std::pair<std::string, long>> files;
+    std::mt19937 generator(11);
+    std::uniform_int_distribution<int> n_occurrences(0, 6);
+    long total = 0;
+    for (int file = 0; file < 200; file++) {
+        std::string path = "file" + std::to_string(file);
+        long count = n_occurrences(generator);
+        std::string text(count, 'x');
+        counter.feed(reinterpret_cast<const unsigned char *>(text.data()), text.size());
+        counter.end_file(path);
+        if (count > 0) { files.emplace_back(path, count); }
+        total += count;
+    }
+    std::sort(files.begin(), files.end(), [](const auto & file1, const auto & file2) {
+        if (file1.second != file2.second) { return file1.second > file2.second; }
+        return file1.first < file2.first;
+    });
+    files.resize(n_top_files);
+
+    std::vector<TermCount> results = counter.results();
+    CHECK(results.size() == 1 && results[0].count == total);
+    CHECK(results[0].top_files == files);
+    // results don't consume the heaps
+    CHECK(counter.results()[0].top_files == files);
+    // and without room for any file, only totals are kept
+    TermCounter totals_only({ "x" }, 0);
+    totals_only.feed(reinterpret_cast<const unsigned char *>("xx"), 2);
+    totals_only.end_file("one");
+    CHECK(totals_only.results()[0].count == 2 && totals_only.results()[0].top_files.empty());
+}
@@ -0,0 +1,85 @@
+#include "testing.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+struct TestCase {
+    const char * name;
+    TestFunction function;
+};
+
+// a function-local static, so that registrars in other files can use it during static initialization
+static std::vector<TestCase> & registered_tests()
+{
+    static std::vector<TestCase> tests;
+    return tests;
+}
+
+static long n_failed_checks = 0;
+
+TestRegistrar::TestRegistrar(const char * name, TestFunction function)
+{
+    registered_tests().push_back(TestCase{ name, function });
+}
+
+/**
+ * @brief Records the outcome of one check, printing it if it failed.
+ */
+void check(bool passed, const char * condition, const char * file, int line)
+{
+    if (passed) { return; }
+    n_failed_checks++;
+    fprintf(stderr, "%s:%d: check failed: %s\n", file, line, condition);
+}
+
+/**
+ * @brief Runs part of a test case in a child process, so that the state it leaves in globals (a scan
+ *        keeps its tables between calls of analyzeDir()) can't leak into the cases that follow. A
+ *        check failing in the child fails the case.
+ */
+void run_in_child_process(const std::function<void()> & part)
+{
+    fflush(stdout);
+    fflush(stderr);
+    pid_t child = fork();
+    if (child == 0) {
+        long failed_before = n_failed_checks;
+        part();
+        fflush(stderr);
+        _exit(n_failed_checks == failed_before ? 0 : 1);
+    }
+    int status = 0;
+    bool waited = child > 0 && waitpid(child, &status, 0) == child;
+    check(waited && WIFEXITED(status) && WEXITSTATUS(status) == 0, "every check in the child process passed", __FILE__, __LINE__);
+}
+
+/**
+ * @brief Runs every registered test case, or those whose name contains the first argument.
+ *
+ * Usage: test [name filter]
+ * Run from the repository root, since some cases scan the fixtures in tests/.
+ * @return 0 if every check passed.
+ */
+int main(int argc, char * argv[])
+{
+    const char * filter = argc > 1 ? argv[1] : "";
+    int n_failed_cases = 0;
+    int n_run = 0;
+    for (const TestCase & test : registered_tests()) {
+        if (! strstr(test.name, filter)) { continue; }
+        long failed_before = n_failed_checks;
+        auto start = std::chrono::steady_clock::now();
+        test.function();
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        bool passed = n_failed_checks == failed_before;
+        printf("%-4s %-44s %9.1f ms\n", passed ? "ok" : "FAIL", test.name, milliseconds);
+        n_failed_cases += ! passed;
+        n_run++;
+    }
+    printf("%d of %d test cases passed\n", n_run - n_failed_cases, n_run);
+    return n_failed_cases == 0 ? 0 : 1;
+}
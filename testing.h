@@ -0,0 +1,24 @@
+#pragma once
+
+#include <functional>
+#include <string>
+
+/**
+ * @brief A minimal test harness for the `test` executable: test cases register themselves with
+ *        TEST_CASE, and CHECK records a failure (with its file and line) without stopping the case.
+ */
+using TestFunction = void (*)();
+
+struct TestRegistrar {
+    TestRegistrar(const char * name, TestFunction function);
+};
+
+void check(bool passed, const char * condition, const char * file, int line);
+void run_in_child_process(const std::function<void()> & part);
+
+#define CHECK(condition) check(static_cast<bool>(condition), #condition, __FILE__, __LINE__)
+
+#define TEST_CASE(name)                                        \
+    static void name();                                        \
+    static const TestRegistrar name##_registrar(#name, name); \
+    static void name()
@@ -0,0 +1,113 @@
+#include "textClassifier.h"
+
+#include <algorithm>
+#include <cctype>
+
+#ifdef __SSE2__
+    #include <emmintrin.h>
+#endif
+
+constexpr char EXTENSION_SEPARATOR = '.';
+// a sniffed file stops being text once more than 1 in this many bytes is a control character
+constexpr size_t MAX_CONTROL_BYTE_RATIO = 20;
+
+/**
+ * @brief Returns the lowercase extension of a file name, including the leading dot.
+ * @param file_name The name (or path) of the file.
+ * @return The extension, or an empty string if the name has none.
+ */
+std::string file_extension(std::string_view file_name)
+{
+    size_t dot = file_name.rfind(EXTENSION_SEPARATOR);
+    size_t slash = file_name.rfind('/');
+    if (dot == std::string_view::npos || (slash != std::string_view::npos && dot < slash)) { return ""; }
+
+    std::string extension(file_name.substr(dot));
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension;
+}
+
+/**
+ * @brief Builds the classifier.
+ * @param extensions The allow-listed extensions, with or without the leading dot, in any case.
+ * @param sniff Whether files with other extensions should be sniffed.
+ */
+TextClassifier::TextClassifier(const std::vector<std::string> & extensions, bool sniff) : sniff(sniff)
+{
+    std::vector<std::string> normalized;
+    for (auto & extension : extensions) {
+        if (extension.empty()) { continue; }
+        std::string with_dot = extension[0] == EXTENSION_SEPARATOR ? extension : EXTENSION_SEPARATOR + extension;
+        normalized.push_back(file_extension(with_dot));
+    }
+    this->extensions = PerfectHashSet(normalized);
+}
+
+/**
+ * @brief Checks whether a file's extension is on the allow-list.
+ * @param file_name The name (or path) of the file.
+ * @return True if the file is text by its extension, false otherwise.
+ */
+bool TextClassifier::has_text_extension(std::string_view file_name) const
+{
+    return extensions.contains(file_extension(file_name));
+}
+
+/**
+ * @brief Counts the bytes that never show up in text: everything below a space except tab, newline,
+ *        form feed and carriage return, plus DEL. NULs count as well.
+ * @param data The bytes to scan.
+ * @param size The number of bytes.
+ * @param n_nuls Set to the number of NUL bytes.
+ * @return The number of control bytes, NULs included.
+ */
+static size_t count_control_bytes(const unsigned char * data, size_t size, size_t & n_nuls)
+{
+    size_t n_control = 0;
+    size_t i = 0;
+    n_nuls = 0;
+
+#ifdef __SSE2__
+    // 16 bytes at a time: a byte is a control byte if min(byte, 0x1F) == byte, minus the whitespace
+    const __m128i max_control = _mm_set1_epi8(0x1F);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i del = _mm_set1_epi8(0x7F);
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i form_feed = _mm_set1_epi8('\f');
+    const __m128i carriage_return = _mm_set1_epi8('\r');
+    for (; i + sizeof(__m128i) <= size; i += sizeof(__m128i)) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(block, max_control), block);
+        __m128i whitespace = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(block, tab), _mm_cmpeq_epi8(block, newline)),
+            _mm_or_si128(_mm_cmpeq_epi8(block, form_feed), _mm_cmpeq_epi8(block, carriage_return)));
+        control = _mm_or_si128(_mm_andnot_si128(whitespace, control), _mm_cmpeq_epi8(block, del));
+        n_control += __builtin_popcount(_mm_movemask_epi8(control));
+        n_nuls += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(block, zero)));
+    }
+#endif
+
+    for (; i < size; i++) {
+        unsigned char c = data[i];
+        bool whitespace = c == '\t' || c == '\n' || c == '\f' || c == '\r';
+        n_control += (c < 0x20 && ! whitespace) || c == 0x7F;
+        n_nuls += c == 0;
+    }
+    return n_control;
+}
+
+/**
+ * @brief Sniffs the start of a file to decide whether it is text. Bytes above 0x7F are accepted,
+ *        so UTF-8 and Latin-1 text both pass.
+ * @param data The first bytes of the file (only the first TEXT_SNIFF_SIZE are looked at).
+ * @param size The number of bytes available.
+ * @return True if the bytes look like text, false otherwise.
+ */
+bool TextClassifier::looks_like_text(const unsigned char * data, size_t size)
+{
+    size = std::min(size, TEXT_SNIFF_SIZE);
+    size_t n_nuls;
+    size_t n_control = count_control_bytes(data, size, n_nuls);
+    return n_nuls == 0 && n_control * MAX_CONTROL_BYTE_RATIO <= size;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "perfectHash.h"
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// how much of a file is looked at when sniffing whether it is text
+constexpr size_t TEXT_SNIFF_SIZE = 4096;
+
+/**
+ * @brief Decides which files are text, and therefore go through the word tokenizer.
+ *
+ * A file is text if its extension is on the allow-list. Files with any other extension (or none)
+ * can optionally be sniffed: their first TEXT_SNIFF_SIZE bytes must contain no NULs and almost no
+ * control characters.
+ */
+class TextClassifier {
+public:
+    TextClassifier() = default;
+    TextClassifier(const std::vector<std::string> & extensions, bool sniff);
+
+    bool has_text_extension(std::string_view file_name) const;
+    bool should_sniff() const { return sniff; }
+    static bool looks_like_text(const unsigned char * data, size_t size);
+
+private:
+    PerfectHashSet extensions;
+    bool sniff = false;
+};
+
+std::string file_extension(std::string_view file_name);
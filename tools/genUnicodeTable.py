@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+"""Generates unicodeTable.cpp, the letter classification and case folding tables used by the
+Unicode word tokenizer, from the Unicode database bundled with Python.
+
+Usage (from the repository root):
+    python3 tools/genUnicodeTable.py > unicodeTable.cpp
+"""
+
+import sys
+import unicodedata
+
+MAX_CODE_POINT = 0x110000
+BLOCK_BITS = 8
+BLOCK_SIZE = 1 << BLOCK_BITS
+WORD_CATEGORIES = ("Lu", "Ll", "Lt", "Lm", "Lo", "Mn", "Mc")
+
+FOLD_CASE_FUNCTION = """
+/**
+ * @brief Applies simple (one-to-one) case folding to a code point.
+ * @param code_point The code point.
+ * @return The lowercase code point, or the code point itself if it has no simple lowercase form.
+ */
+uint32_t fold_case(uint32_t code_point)
+{
+    if (code_point < 0x80) { return code_point >= 'A' && code_point <= 'Z' ? code_point + ('a' - 'A') : code_point; }
+    size_t low = 0;
+    size_t high = N_CASE_FOLD_RANGES;
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        const CaseFoldRange & range = CASE_FOLD_RANGES[middle];
+        if (code_point < range.first) {
+            high = middle;
+        } else if (code_point > range.last) {
+            low = middle + 1;
+        } else {
+            return (code_point - range.first) % range.stride == 0 ? code_point + range.delta : code_point;
+        }
+    }
+    return code_point;
+}
+"""
+
+
+def is_word_code_point(cp):
+    return unicodedata.category(chr(cp)) in WORD_CATEGORIES
+
+
+def simple_fold(cp):
+    """The one-to-one lowercase mapping, or None if the code point has none (or only a
+    one-to-many one, which simple case folding leaves alone)."""
+    lower = chr(cp).lower()
+    if len(lower) == 1 and ord(lower) != cp:
+        return ord(lower)
+    return None
+
+
+def letter_blocks():
+    """Splits the code space into 256-code-point blocks of bits, sharing identical blocks."""
+    unique_blocks = []
+    block_index = {}
+    stage1 = []
+    for block_start in range(0, MAX_CODE_POINT, BLOCK_SIZE):
+        bits = bytearray(BLOCK_SIZE // 8)
+        for cp in range(block_start, block_start + BLOCK_SIZE):
+            if is_word_code_point(cp):
+                bits[(cp - block_start) // 8] |= 1 << (cp % 8)
+        bits = bytes(bits)
+        if bits not in block_index:
+            block_index[bits] = len(unique_blocks)
+            unique_blocks.append(bits)
+        stage1.append(block_index[bits])
+    return stage1, unique_blocks
+
+
+def fold_ranges():
+    """Groups the case mappings into runs of (first, last, delta, stride): every stride-th code
+    point from first to last maps to itself plus delta. Stride 1 covers blocks like A-Z, stride 2
+    covers the alternating upper/lower pairs of Latin Extended and Cyrillic."""
+    mappings = [(cp, simple_fold(cp)) for cp in range(MAX_CODE_POINT) if cp >= 0x80]
+    mappings = [(cp, folded) for cp, folded in mappings if folded is not None]
+    ranges = []
+    for cp, folded in mappings:
+        delta = folded - cp
+        if ranges:
+            first, last, last_delta, stride = ranges[-1]
+            if last_delta == delta and (stride is None or cp - last == stride) and cp - last <= 2:
+                ranges[-1] = (first, cp, delta, cp - last)
+                continue
+        ranges.append((cp, cp, delta, None))
+    return [(first, last, delta, stride or 1) for first, last, delta, stride in ranges]
+
+
+def main():
+    stage1, blocks = letter_blocks()
+    folds = fold_ranges()
+    out = sys.stdout
+    out.write("// GENERATED by tools/genUnicodeTable.py from the Unicode %s database; do not edit.\n"
+              % unicodedata.unidata_version)
+    out.write('#include "unicodeTable.h"\n\n')
+
+    out.write("// index of the bit block holding each run of %d code points\n" % BLOCK_SIZE)
+    out.write("const uint8_t WORD_BLOCK_INDEX[%d] = {\n" % len(stage1))
+    for i in range(0, len(stage1), 24):
+        out.write("    " + ", ".join(str(b) for b in stage1[i:i + 24]) + ",\n")
+    out.write("};\n\n")
+
+    out.write("// one bit per code point: set for letters and combining marks\n")
+    out.write("const uint8_t WORD_BLOCKS[%d][%d] = {\n" % (len(blocks), BLOCK_SIZE // 8))
+    for bits in blocks:
+        out.write("    { " + ", ".join("0x%02X" % b for b in bits) + " },\n")
+    out.write("};\n\n")
+
+    out.write("const CaseFoldRange CASE_FOLD_RANGES[%d] = {\n" % len(folds))
+    for first, last, delta, stride in folds:
+        out.write("    { 0x%04X, 0x%04X, %d, %d },\n" % (first, last, delta, stride))
+    out.write("};\n\n")
+    out.write("const size_t N_CASE_FOLD_RANGES = %d;\n" % len(folds))
+    out.write(FOLD_CASE_FUNCTION)
+    assert len(blocks) < 256
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// every stride-th code point from first to last folds to itself plus delta
+struct CaseFoldRange {
+    uint32_t first, last;
+    int32_t delta;
+    uint32_t stride;
+};
+
+constexpr uint32_t MAX_CODE_POINT = 0x10FFFF;
+constexpr int WORD_BLOCK_BITS = 8;
+
+// generated tables, see tools/genUnicodeTable.py
+extern const uint8_t WORD_BLOCK_INDEX[];
+extern const uint8_t WORD_BLOCKS[][(1 << WORD_BLOCK_BITS) / 8];
+extern const CaseFoldRange CASE_FOLD_RANGES[];
+extern const size_t N_CASE_FOLD_RANGES;
+
+/**
+ * @brief Checks whether a code point can be part of a word: a letter of any script, or a combining
+ *        mark (which scripts like Devanagari need inside words).
+ * @param code_point The code point.
+ * @return True if the code point is a word character, false otherwise.
+ */
+inline bool is_word_code_point(uint32_t code_point)
+{
+    if (code_point > MAX_CODE_POINT) { return false; }
+    const uint8_t * block = WORD_BLOCKS[WORD_BLOCK_INDEX[code_point >> WORD_BLOCK_BITS]];
+    uint32_t offset = code_point & ((1 << WORD_BLOCK_BITS) - 1);
+    return (block[offset >> 3] >> (offset & 7)) & 1;
+}
+
+uint32_t fold_case(uint32_t code_point);
@@ -0,0 +1,249 @@
+#include "wordTokenizer.h"
+#include "unicodeTable.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef __SSE2__
+    #include <emmintrin.h>
+#endif
+
+// pure ASCII text is tokenized this many bytes at a time
+constexpr size_t ASCII_CHUNK_SIZE = 32;
+constexpr unsigned char ASCII_CASE_BIT = 0x20;
+constexpr unsigned char UTF8_CONTINUATION_MASK = 0xC0;
+constexpr unsigned char UTF8_CONTINUATION = 0x80;
+constexpr uint32_t FIRST_SURROGATE = 0xD800;
+constexpr uint32_t LAST_SURROGATE = 0xDFFF;
+
+/**
+ * @brief Checks whether a byte is an ASCII letter (what isalpha() accepts in the C locale).
+ */
+static bool is_ascii_letter(unsigned char c)
+{
+    return static_cast<unsigned char>((c | ASCII_CASE_BIT) - 'a') < 26;
+}
+
+/**
+ * @brief Checks whether a chunk of ASCII_CHUNK_SIZE bytes is pure ASCII.
+ */
+static bool is_ascii_chunk(const unsigned char * chunk)
+{
+#ifdef __SSE2__
+    __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i *>(chunk));
+    __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i *>(chunk + 16));
+    return _mm_movemask_epi8(_mm_or_si128(low, high)) == 0;
+#else
+    uint64_t words[ASCII_CHUNK_SIZE / sizeof(uint64_t)];
+    memcpy(words, chunk, sizeof(words));
+    return ((words[0] | words[1] | words[2] | words[3]) & 0x8080808080808080ULL) == 0;
+#endif
+}
+
+/**
+ * @brief Returns the length of a UTF-8 character from its first byte.
+ * @return 2 to 4 for a valid lead byte, 0 for anything else (including a continuation byte).
+ */
+static size_t utf8_length(unsigned char lead)
+{
+    if (lead >= 0xC2 && lead <= 0xDF) { return 2; }
+    if (lead >= 0xE0 && lead <= 0xEF) { return 3; }
+    if (lead >= 0xF0 && lead <= 0xF4) { return 4; }
+    return 0;
+}
+
+static bool is_continuation(unsigned char c)
+{
+    return (c & UTF8_CONTINUATION_MASK) == UTF8_CONTINUATION;
+}
+
+/**
+ * @brief Tokenizes a block of text.
+ * @param data The block of text.
+ * @param size The size of the block in bytes.
+ */
+void WordTokenizer::feed(const unsigned char * data, size_t size)
+{
+    // finish the character that the previous block cut off, as long as this block continues it
+    if (partial_size > 0) {
+        size_t expected = utf8_length(partial_character[0]);
+        while (partial_size < expected && size > 0 && is_continuation(*data)) {
+            partial_character[partial_size++] = *data++;
+            size--;
+        }
+        if (partial_size < expected && size == 0) { return; }
+        size_t n_consumed = partial_size == expected ? feed_character(partial_character, partial_size) : 0;
+        // a broken character breaks the word, and its stray bytes are dropped
+        if (n_consumed != partial_size) { end_word(); }
+        partial_size = 0;
+    }
+
+    size_t i = 0;
+    while (i < size) {
+        if (size - i >= ASCII_CHUNK_SIZE && (! unicode || is_ascii_chunk(data + i))) {
+            feed_ascii_chunk(data + i);
+            i += ASCII_CHUNK_SIZE;
+            continue;
+        }
+
+        // decode one chunk's worth of characters before looking for pure ASCII again
+        size_t window_end = std::min(size, i + ASCII_CHUNK_SIZE);
+        while (i < window_end) {
+            size_t n_consumed = feed_character(data + i, size - i);
+            if (n_consumed == 0) {
+                partial_size = size - i;
+                memcpy(partial_character, data + i, partial_size);
+                return;
+            }
+            i += n_consumed;
+        }
+    }
+}
+
+/**
+ * @brief Records the last word of the file (the file might not end in a non-alphabetic character).
+ */
+void WordTokenizer::finish()
+{
+    partial_size = 0;
+    end_word();
+}
+
+/**
+ * @brief Tokenizes ASCII_CHUNK_SIZE bytes: the letters are found and lowercased for the whole chunk
+ *        at once, and then appended to the current word run by run.
+ * @param chunk The bytes to tokenize. Outside Unicode mode they may contain non-ASCII bytes, which
+ *              are never letters.
+ */
+void WordTokenizer::feed_ascii_chunk(const unsigned char * chunk)
+{
+    unsigned char lowercase[ASCII_CHUNK_SIZE];
+    uint64_t letters = 0;
+
+#ifdef __SSE2__
+    const __m128i case_bit = _mm_set1_epi8(ASCII_CASE_BIT);
+    const __m128i a = _mm_set1_epi8('a');
+    const __m128i last_offset = _mm_set1_epi8('z' - 'a');
+    for (size_t half = 0; half < ASCII_CHUNK_SIZE; half += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(chunk + half));
+        __m128i lower = _mm_or_si128(bytes, case_bit);
+        // a letter is a byte whose lowercase form minus 'a' is at most 25, as an unsigned byte
+        __m128i offset = _mm_sub_epi8(lower, a);
+        __m128i is_letter = _mm_cmpeq_epi8(_mm_min_epu8(offset, last_offset), offset);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(lowercase + half), lower);
+        letters |= uint64_t(uint32_t(_mm_movemask_epi8(is_letter))) << half;
+    }
+#else
+    for (size_t i = 0; i < ASCII_CHUNK_SIZE; i++) {
+        lowercase[i] = chunk[i] | ASCII_CASE_BIT;
+        letters |= uint64_t(is_ascii_letter(chunk[i])) << i;
+    }
+#endif
+
+    // the bits above the chunk are zero, so both scans below stop at the end of the chunk
+    size_t position = 0;
+    while (position < ASCII_CHUNK_SIZE) {
+        uint64_t remaining = letters >> position;
+        if (remaining & 1) {
+            size_t run = __builtin_ctzll(~remaining);
+            append_letters(lowercase + position, run);
+            position += run;
+        } else {
+            if (! next_word.empty()) { end_word(); }
+            if (remaining == 0) { break; }
+            position += __builtin_ctzll(remaining);
+        }
+    }
+}
+
+/**
+ * @brief Tokenizes the single character at the start of `data`.
+ * @param data The bytes left in the block.
+ * @param size The number of bytes left (at least 1).
+ * @return The number of bytes consumed, or 0 if the bytes are the valid start of a UTF-8
+ *         character that continues past the end of the block.
+ */
+size_t WordTokenizer::feed_character(const unsigned char * data, size_t size)
+{
+    unsigned char lead = data[0];
+    if (lead < UTF8_CONTINUATION || ! unicode) {
+        if (is_ascii_letter(lead)) {
+            unsigned char lower = lead | ASCII_CASE_BIT;
+            append_letters(&lower, 1);
+        } else if (! next_word.empty()) {
+            end_word();
+        }
+        return 1;
+    }
+
+    size_t length = utf8_length(lead);
+    if (length == 0) {
+        end_word();
+        return 1;
+    }
+    uint32_t code_point = lead & (0x7F >> length);
+    for (size_t k = 1; k < length; k++) {
+        if (k == size) { return 0; }
+        if (! is_continuation(data[k])) {
+            end_word();
+            return k;
+        }
+        code_point = (code_point << 6) | (data[k] & ~UTF8_CONTINUATION_MASK);
+    }
+
+    bool overlong = (length == 3 && code_point < 0x800) || (length == 4 && code_point < 0x10000);
+    bool surrogate = code_point >= FIRST_SURROGATE && code_point <= LAST_SURROGATE;
+    if (overlong || surrogate || code_point > MAX_CODE_POINT) {
+        end_word();
+    } else {
+        feed_code_point(code_point);
+    }
+    return length;
+}
+
+/**
+ * @brief Adds a decoded non-ASCII character to the current word if it is a letter, or ends the word.
+ */
+void WordTokenizer::feed_code_point(uint32_t code_point)
+{
+    if (! is_word_code_point(code_point)) {
+        end_word();
+        return;
+    }
+
+    uint32_t folded = fold_case(code_point);
+    if (folded < 0x80) {
+        next_word.push_back(folded);
+    } else if (folded < 0x800) {
+        next_word.push_back(0xC0 | (folded >> 6));
+        next_word.push_back(0x80 | (folded & 0x3F));
+    } else if (folded < 0x10000) {
+        next_word.push_back(0xE0 | (folded >> 12));
+        next_word.push_back(0x80 | ((folded >> 6) & 0x3F));
+        next_word.push_back(0x80 | (folded & 0x3F));
+    } else {
+        next_word.push_back(0xF0 | (folded >> 18));
+        next_word.push_back(0x80 | ((folded >> 12) & 0x3F));
+        next_word.push_back(0x80 | ((folded >> 6) & 0x3F));
+        next_word.push_back(0x80 | (folded & 0x3F));
+    }
+    next_word_length++;
+}
+
+void WordTokenizer::append_letters(const unsigned char * letters, size_t n)
+{
+    next_word.append(reinterpret_cast<const char *>(letters), n);
+    next_word_length += n;
+}
+
+/**
+ * @brief Ends the current word, handing it to the sink if it is long enough and not a stop word.
+ */
+void WordTokenizer::end_word()
+{
+    // there's a space, or some sort of non-character. At this point the word stops and we'll "reset" it,
+    // but we still need to do an additional check to ensure it's the appropriate length
+    if (next_word_length >= MIN_WORD_SIZE && ! (stop_words && stop_words->contains(next_word))) { sink(next_word); }
+    next_word.clear();
+    next_word_length = 0;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "stopWords.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// word = sequence of at least this many letters
+constexpr size_t MIN_WORD_SIZE = 5;
+
+// receives each word (lowercase, at least MIN_WORD_SIZE letters long) in the order it was read
+using WordSink = std::function<void(const std::string & word)>;
+
+/**
+ * @brief Splits blocks of text into words. A word (or, in Unicode mode, a UTF-8 character) that
+ *        straddles two blocks is carried over to the next one.
+ *
+ * In the default ASCII mode a letter is A-Z or a-z, and every other byte breaks words. In Unicode
+ * mode the text is decoded as UTF-8, letters of every script (and combining marks) are word
+ * characters and words are case folded; invalid UTF-8 breaks words. In both modes 32-byte runs of
+ * pure ASCII are tokenized 32 bytes at a time with SIMD compares. Stop words are dropped before they
+ * reach the sink.
+ */
+class WordTokenizer {
+public:
+    WordTokenizer() = default;
+    WordTokenizer(bool unicode, WordSink sink, const StopWordFilter * stop_words = nullptr)
+        : unicode(unicode), sink(std::move(sink)), stop_words(stop_words)
+    {
+    }
+
+    void feed(const unsigned char * data, size_t size);
+    void finish();
+
+private:
+    void feed_ascii_chunk(const unsigned char * chunk);
+    size_t feed_character(const unsigned char * data, size_t size);
+    void feed_code_point(uint32_t code_point);
+    void append_letters(const unsigned char * letters, size_t n);
+    void end_word();
+
+    bool unicode = false;
+    WordSink sink;
+    const StopWordFilter * stop_words = nullptr; // words dropped before they reach the sink, if any
+    std::string next_word;
+    size_t next_word_length = 0; // in characters, which differs from bytes in Unicode mode
+    // the start of a UTF-8 character cut off by the end of the previous block
+    unsigned char partial_character[4];
+    size_t partial_size = 0;
+};
@@ -0,0 +1,113 @@
+#include "testing.h"
+#include "wordTokenizer.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+// the chunk size of the SIMD path: splits are tried at and around multiples of it
+constexpr size_t CHUNK_SIZE = 32;
+
+/**
+ * @brief Tokenizes text fed in pieces of `piece_size` bytes (1 keeps every byte off the SIMD path).
+ */
+static std::vector<std::string> tokenize(const std::string & text, bool unicode, size_t piece_size)
+{
+    std::vector<std::string> words;
+    WordTokenizer tokenizer(unicode, [&](const std::string & word) { words.push_back(word); });
+    const unsigned char * data = reinterpret_cast<const unsigned char *>(text.data());
+    for (size_t i = 0; i < text.size(); i += piece_size) { tokenizer.feed(data + i, std::min(piece_size, text.size() - i)); }
+    tokenizer.finish();
+    return words;
+}
+
+static std::vector<std::string> tokenize(const std::string & text, bool unicode)
+{
+    return tokenize(text, unicode, text.size() + 1);
+}
+
+/**
+ * @brief Makes text of words of every length, so that words start and end at every offset of a chunk.
+ *        With `non_ascii`, some words hold accented letters and some are broken by stray bytes.
+ */
+static std::string mixed_text(unsigned seed, bool non_ascii)
+{
+    const char * letters[] = { "a", "B", "c", "D", "e", "z", "Q", "m" };
+    const char * non_ascii_letters[] = { "\xC3\xA9", "\xC3\x89", "\xCE\xB1", "\xE4\xB8\xAD", "\xF0\x9D\x90\x80" };
+    const char * breaks[] = { " ", "\n", "  ", ", ", "0", "_", "\x7F", "\xFF" };
+    std::mt19937 generator(seed);
+    std::string text;
+    while (text.size() < 8 * 1024) {
+        size_t length = generator() % (CHUNK_SIZE + 9);
+        for (size_t k = 0; k < length; k++) {
+            bool use_non_ascii = non_ascii && generator() % 10 == 0;
+            text += use_non_ascii ? non_ascii_letters[generator() % 5] : letters[generator() % 8];
+        }
+        text += breaks[generator() % (non_ascii ? 8 : 7)];
+    }
+    return text;
+}
+
+TEST_CASE(word_tokenizer_simd_matches_scalar)
+{
+    for (bool unicode : { false, true }) {
+        for (unsigned seed = 1; seed <= 4; seed++) {
+            std::string text = mixed_text(seed, unicode || seed % 2 == 0);
+            std::vector<std::string> scalar = tokenize(text, unicode, 1);
+            CHECK(scalar.size() > 100);
+            CHECK(tokenize(text, unicode) == scalar);
+            for (size_t piece_size : { CHUNK_SIZE - 1, CHUNK_SIZE, CHUNK_SIZE + 1, 2 * CHUNK_SIZE + 3, size_t(1000) }) {
+                CHECK(tokenize(text, unicode, piece_size) == scalar);
+            }
+        }
+    }
+}
+
+TEST_CASE(word_tokenizer_words_across_chunks)
+{
+    // one word straddling the first chunk boundary and one filling a whole chunk and more
+    std::string long_word(CHUNK_SIZE + 8, 'w');
+    std::string text = std::string(CHUNK_SIZE - 3, ' ') + "Crossing " + long_word + " tiny " + std::string(CHUNK_SIZE, 'X');
+    std::vector<std::string> expected = { "crossing", long_word, std::string(CHUNK_SIZE, 'x') };
+    for (bool unicode : { false, true }) {
+        CHECK(tokenize(text, unicode) == expected);
+        CHECK(tokenize(text, unicode, 1) == expected);
+    }
+    // a word made of letters only up to the last byte of a chunk is ended by finish()
+    CHECK(tokenize(std::string(CHUNK_SIZE, 'y'), false) == std::vector<std::string>{ std::string(CHUNK_SIZE, 'y') });
+}
+
+TEST_CASE(word_tokenizer_ascii_mode)
+{
+    // non-ASCII bytes are never letters, and words shorter than MIN_WORD_SIZE are dropped
+    CHECK((tokenize("Hello, WORLD! caf\xC3\xA9s four five1 sixth", false) == std::vector<std::string>{ "hello", "world", "sixth" }));
+}
+
+TEST_CASE(word_tokenizer_unicode_letters)
+{
+    // accented, Greek and CJK letters and combining marks are word characters, and case is folded
+    std::string text = "\xC3\x89" "COLE caf\xC3\xA9s \xCE\x91\xCE\x9B\xCE\xA6\xCE\x91\xCE\x92 "
+                       "\xE4\xB8\xAD\xE6\x96\x87\xE5\xAD\x97\xE7\xAC\xA6\xE4\xB8\xB2 cafe\xCC\x81s";
+    std::vector<std::string> expected = { "\xC3\xA9" "cole", "caf\xC3\xA9s", "\xCE\xB1\xCE\xBB\xCF\x86\xCE\xB1\xCE\xB2",
+                                          "\xE4\xB8\xAD\xE6\x96\x87\xE5\xAD\x97\xE7\xAC\xA6\xE4\xB8\xB2", "cafe\xCC\x81s" };
+    CHECK(tokenize(text, true) == expected);
+    CHECK(tokenize(text, true, 1) == expected);
+}
+
+TEST_CASE(word_tokenizer_invalid_utf8)
+{
+    using Words = std::vector<std::string>;
+    // a stray continuation byte, an invalid lead byte, an overlong form and an encoded surrogate
+    CHECK((tokenize("first\x80second", true) == Words{ "first", "second" }));
+    CHECK((tokenize("third\xFFmore\xC0\xAF" "fourth", true) == Words{ "third", "fourth" }));
+    CHECK((tokenize("fifth\xE0\x80\xAFsixth", true) == Words{ "fifth", "sixth" }));
+    CHECK((tokenize("seven\xED\xA0\x80" "eight", true) == Words{ "seven", "eight" }));
+    // a lead byte missing its continuation bytes breaks the word, and the bytes after it are read again
+    CHECK((tokenize("ninth\xE4\xB8tenth", true) == Words{ "ninth", "tenth" }));
+    // a character cut off by the end of the file is dropped
+    CHECK((tokenize("eleventh\xE4\xB8", true) == Words{ "eleventh" }));
+    // the same character split between two blocks is carried over
+    for (size_t piece_size : { size_t(1), size_t(4), size_t(5) }) {
+        CHECK((tokenize("caf\xC3\xA9s na\xC3\xAFve", true, piece_size) == Words{ "caf\xC3\xA9s", "na\xC3\xAFve" }));
+    }
+}
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+// keeps the indices producers and consumers update on separate cache lines
+constexpr size_t CACHE_LINE_SIZE = 64;
+constexpr size_t DEFAULT_DEQUE_CAPACITY = 256;
+
+/**
+ * @brief A Chase-Lev work-stealing deque: its owner thread pushes and pops tasks at the bottom
+ *        (last in, first out, so it keeps working on what is hot in its cache), while other threads
+ *        steal from the top (oldest first).
+ *
+ * Only the owner may call push() and pop(); anyone may call steal(). The buffer grows when full, and
+ * the old buffers are kept until the deque is destroyed, since a thief may still be reading from
+ * one. Follows the C11 formulation of Lê, Pop, Cohen and Zappa Nardelli (PPoPP 2013).
+ *
+ * @tparam T A trivially copyable task handle, e.g. a pointer or an index.
+ */
+template <typename T>
+class ChaseLevDeque {
+    static_assert(std::is_trivially_copyable_v<T>, "deque slots are read and written as atomics");
+
+public:
+    /**
+     * @param capacity The initial number of slots, rounded up to a power of two (slots are found by
+     *        masking the index).
+     */
+    explicit ChaseLevDeque(size_t capacity = DEFAULT_DEQUE_CAPACITY)
+    {
+        size_t rounded = 1;
+        while (rounded < capacity) { rounded *= 2; }
+        buffers.push_back(std::make_unique<Buffer>(rounded));
+        buffer.store(buffers.back().get(), std::memory_order_relaxed);
+    }
+    ChaseLevDeque(const ChaseLevDeque &) = delete;
+    ChaseLevDeque & operator=(const ChaseLevDeque &) = delete;
+
+    /**
+     * @brief Adds a task at the bottom. Owner only.
+     */
+    void push(T value)
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        Buffer * current = buffer.load(std::memory_order_relaxed);
+        if (b - t >= static_cast<int64_t>(current->capacity)) { current = grow(current, t, b); }
+        current->put(b, value);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Takes the task at the bottom. Owner only.
+     * @return The task, or null if the deque was empty (or a thief took the last task).
+     */
+    std::optional<T> pop()
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        Buffer * current = buffer.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+
+        if (t > b) {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return std::nullopt;
+        }
+        T value = current->get(b);
+        if (t == b) {
+            // the last task: whoever moves top past it first gets it
+            bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            bottom.store(b + 1, std::memory_order_relaxed);
+            if (! won) { return std::nullopt; }
+        }
+        return value;
+    }
+
+    /**
+     * @brief Takes the task at the top. Any thread.
+     * @return The task, or null if the deque was empty or another thread got there first.
+     */
+    std::optional<T> steal()
+    {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b) { return std::nullopt; }
+
+        T value = buffer.load(std::memory_order_acquire)->get(t);
+        if (! top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return std::nullopt;
+        }
+        return value;
+    }
+
+    // a snapshot, which may be stale by the time it is used
+    bool empty() const { return top.load(std::memory_order_acquire) >= bottom.load(std::memory_order_acquire); }
+
+private:
+    struct Buffer {
+        explicit Buffer(size_t capacity) : capacity(capacity), slots(new std::atomic<T>[capacity]) {}
+        T get(int64_t index) const { return slots[index & (capacity - 1)].load(std::memory_order_relaxed); }
+        void put(int64_t index, T value) { slots[index & (capacity - 1)].store(value, std::memory_order_relaxed); }
+
+        size_t capacity; // a power of two
+        std::unique_ptr<std::atomic<T>[]> slots;
+    };
+
+    Buffer * grow(Buffer * old, int64_t t, int64_t b)
+    {
+        buffers.push_back(std::make_unique<Buffer>(old->capacity * 2));
+        Buffer * grown = buffers.back().get();
+        for (int64_t i = t; i < b; i++) { grown->put(i, old->get(i)); }
+        buffer.store(grown, std::memory_order_release);
+        return grown;
+    }
+
+    alignas(CACHE_LINE_SIZE) std::atomic<int64_t> top { 0 };
+    alignas(CACHE_LINE_SIZE) std::atomic<int64_t> bottom { 0 };
+    std::atomic<Buffer *> buffer;
+    std::vector<std::unique_ptr<Buffer>> buffers; // the current one last; the others may still be read by thieves
+};
+
+/**
+ * @brief A bounded multi-producer, multi-consumer queue in a ring of slots (Dmitry Vyukov's design).
+ *
+ * Each slot carries a sequence number saying whose turn it is: a producer may fill slot i on lap k
+ * when the sequence is k * capacity + i, and a consumer may empty it when it is one more. Claiming a
+ * position is a single compare-and-swap on the shared head or tail, so producers and consumers only
+ * contend with their own kind, and never block: a full or empty queue is reported at once.
+ *
+ * @tparam T The element type.
+ */
+template <typename T>
+class MpmcRing {
+public:
+    /**
+     * @param capacity The number of slots, rounded up to a power of two.
+     */
+    explicit MpmcRing(size_t capacity)
+    {
+        size_t rounded = 1;
+        while (rounded < capacity) { rounded *= 2; }
+        mask = rounded - 1;
+        cells = std::make_unique<Cell[]>(rounded);
+        for (size_t i = 0; i < rounded; i++) { cells[i].sequence.store(i, std::memory_order_relaxed); }
+    }
+    MpmcRing(const MpmcRing &) = delete;
+    MpmcRing & operator=(const MpmcRing &) = delete;
+
+    /**
+     * @brief Adds an element, unless the queue is full.
+     * @return False if it was full (the element is left untouched).
+     */
+    bool try_push(T & value)
+    {
+        size_t position = tail.load(std::memory_order_relaxed);
+        while (true) {
+            Cell & cell = cells[position & mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            intptr_t lap_difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+            if (lap_difference == 0) {
+                if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    cell.value = std::move(value);
+                    cell.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (lap_difference < 0) {
+                return false;
+            } else {
+                position = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * @brief Takes the oldest element, unless the queue is empty.
+     */
+    std::optional<T> try_pop()
+    {
+        size_t position = head.load(std::memory_order_relaxed);
+        while (true) {
+            Cell & cell = cells[position & mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            intptr_t lap_difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+            if (lap_difference == 0) {
+                if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    std::optional<T> value(std::move(cell.value));
+                    // the slot is free again for the producer one lap later
+                    cell.sequence.store(position + mask + 1, std::memory_order_release);
+                    return value;
+                }
+            } else if (lap_difference < 0) {
+                return std::nullopt;
+            } else {
+                position = head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // a snapshot, which may be stale by the time it is used
+    bool empty() const { return head.load(std::memory_order_acquire) >= tail.load(std::memory_order_acquire); }
+    size_t capacity() const { return mask + 1; }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask;
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail { 0 }; // next position to fill
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> head { 0 }; // next position to empty
+};
@@ -0,0 +1,241 @@
+#include "parking.h"
+#include "testing.h"
+#include "workQueue.h"
+#include "workerPool.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+constexpr long STRESS_ITEMS = 200000;
+constexpr int STRESS_THREADS = 4;
+// small, so that the deque grows many times and the ring wraps around thousands of times
+constexpr size_t SMALL_DEQUE_CAPACITY = 3;
+constexpr size_t SMALL_RING_CAPACITY = 5;
+constexpr long PARKING_ROUNDS = 20000;
+// a lost wakeup shows up as a hang, so a scenario that takes longer than this is a failure
+constexpr auto HANG_TIMEOUT = std::chrono::seconds(30);
+
+/**
+ * @brief Counts how many times each item was taken, to check that every item was taken exactly once.
+ */
+class ItemTally {
+public:
+    explicit ItemTally(long n_items) : counts(new std::atomic<int>[n_items]), n_items(n_items)
+    {
+        for (long i = 0; i < n_items; i++) { counts[i].store(0, std::memory_order_relaxed); }
+    }
+    void take(long item) { counts[item].fetch_add(1, std::memory_order_relaxed); }
+    bool each_once() const
+    {
+        for (long i = 0; i < n_items; i++) {
+            if (counts[i].load() != 1) { return false; }
+        }
+        return true;
+    }
+
+private:
+    std::unique_ptr<std::atomic<int>[]> counts;
+    long n_items;
+};
+
+/**
+ * @brief Runs a scenario that might hang on a thread, and fails the check (and the whole run, since
+ *        a hung thread can't be joined) if it doesn't finish within HANG_TIMEOUT.
+ */
+template <typename Scenario>
+static void run_without_hanging(const char * name, Scenario scenario)
+{
+    std::atomic<bool> done { false };
+    std::thread runner([&] {
+        scenario();
+        done.store(true, std::memory_order_release);
+    });
+    auto deadline = std::chrono::steady_clock::now() + HANG_TIMEOUT;
+    while (! done.load(std::memory_order_acquire) && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (! done.load(std::memory_order_acquire)) {
+        fprintf(stderr, "%s: still running after the timeout, a wakeup was lost\n", name);
+        _exit(1);
+    }
+    runner.join();
+}
+
+TEST_CASE(deque_rounds_capacity_to_a_power_of_two)
+{
+    // with a capacity of 3 used as a mask, slots would collide as soon as the deque held 3 items
+    ChaseLevDeque<long> deque(SMALL_DEQUE_CAPACITY);
+    for (long i = 0; i < 100; i++) { deque.push(i); }
+    for (long i = 99; i >= 0; i--) {
+        auto value = deque.pop();
+        CHECK(value && *value == i);
+    }
+    CHECK(! deque.pop());
+    CHECK(! deque.steal());
+}
+
+TEST_CASE(deque_items_taken_once_with_growth_and_thieves)
+{
+    ChaseLevDeque<long> deque(SMALL_DEQUE_CAPACITY);
+    ItemTally tally(STRESS_ITEMS);
+    std::atomic<bool> done { false };
+    std::vector<std::thread> thieves;
+    for (int t = 0; t < STRESS_THREADS; t++) {
+        thieves.emplace_back([&] {
+            while (! done.load(std::memory_order_acquire) || ! deque.empty()) {
+                if (auto value = deque.steal()) { tally.take(*value); }
+            }
+        });
+    }
+    for (long i = 0; i < STRESS_ITEMS; i++) {
+        deque.push(i);
+        // pops in bursts, so the deque both grows and runs empty while the thieves race for the last item
+        if (i % 3 == 2) {
+            for (int p = 0; p < 2; p++) {
+                if (auto value = deque.pop()) { tally.take(*value); }
+            }
+        }
+    }
+    while (auto value = deque.pop()) { tally.take(*value); }
+    done.store(true, std::memory_order_release);
+    for (auto & thief : thieves) { thief.join(); }
+    CHECK(tally.each_once());
+}
+
+TEST_CASE(ring_reports_full_and_empty)
+{
+    MpmcRing<long> ring(SMALL_RING_CAPACITY);
+    CHECK(ring.capacity() == 8);
+    CHECK(! ring.try_pop());
+    for (long i = 0; i < 8; i++) { CHECK(ring.try_push(i)); }
+    long extra = 8;
+    CHECK(! ring.try_push(extra));
+    for (long i = 0; i < 8; i++) {
+        auto value = ring.try_pop();
+        CHECK(value && *value == i);
+    }
+    CHECK(! ring.try_pop());
+}
+
+TEST_CASE(ring_items_taken_once_with_wraparound)
+{
+    MpmcRing<long> ring(SMALL_RING_CAPACITY);
+    ItemTally tally(STRESS_ITEMS);
+    std::atomic<long> n_taken { 0 };
+    long per_producer = STRESS_ITEMS / STRESS_THREADS;
+    std::vector<std::thread> threads;
+    for (int p = 0; p < STRESS_THREADS; p++) {
+        threads.emplace_back([&, p] {
+            for (long i = p * per_producer; i < (p + 1) * per_producer; i++) {
+                long item = i;
+                while (! ring.try_push(item)) { std::this_thread::yield(); }
+            }
+        });
+        threads.emplace_back([&] {
+            while (n_taken.load(std::memory_order_relaxed) < STRESS_ITEMS) {
+                if (auto value = ring.try_pop()) {
+                    tally.take(*value);
+                    n_taken.fetch_add(1, std::memory_order_relaxed);
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (auto & thread : threads) { thread.join(); }
+    CHECK(ring.empty());
+    CHECK(tally.each_once());
+}
+
+TEST_CASE(parking_ping_pong_loses_no_wakeup)
+{
+    // every hand-over of the token needs the other thread to be woken, so one lost wakeup hangs both
+    run_without_hanging("parking_ping_pong", [] {
+        IdleWorkers idle;
+        std::atomic<long> turn { 0 };
+        auto play = [&](long parity) {
+            for (long i = parity; i < 2 * PARKING_ROUNDS; i += 2) {
+                while (turn.load(std::memory_order_acquire) != i) {
+                    uint32_t key = idle.prepare_wait();
+                    if (turn.load(std::memory_order_acquire) == i) {
+                        idle.cancel_wait();
+                        break;
+                    }
+                    idle.wait(key);
+                }
+                turn.store(i + 1, std::memory_order_release);
+                idle.notify_one();
+            }
+        };
+        std::thread other(play, 1);
+        play(0);
+        other.join();
+    });
+}
+
+TEST_CASE(parking_consumers_take_every_item)
+{
+    // consumers park whenever nothing is available; if a wakeup were lost, items would be left over
+    // with every consumer asleep, and the producer would never see them all taken
+    run_without_hanging("parking_consumers", [] {
+        IdleWorkers idle;
+        std::atomic<long> n_available { 0 };
+        std::atomic<long> n_taken { 0 };
+        std::atomic<bool> stopping { false };
+        auto try_take = [&] {
+            long available = n_available.load(std::memory_order_acquire);
+            while (available > 0) {
+                if (n_available.compare_exchange_weak(available, available - 1, std::memory_order_acq_rel)) { return true; }
+            }
+            return false;
+        };
+        std::vector<std::thread> consumers;
+        for (int c = 0; c < STRESS_THREADS; c++) {
+            consumers.emplace_back([&] {
+                while (! stopping.load(std::memory_order_acquire)) {
+                    if (try_take()) {
+                        n_taken.fetch_add(1, std::memory_order_acq_rel);
+                        continue;
+                    }
+                    uint32_t key = idle.prepare_wait();
+                    if (n_available.load(std::memory_order_acquire) > 0 || stopping.load(std::memory_order_acquire)) {
+                        idle.cancel_wait();
+                        continue;
+                    }
+                    idle.wait(key);
+                }
+            });
+        }
+        for (long i = 0; i < PARKING_ROUNDS; i++) {
+            n_available.fetch_add(1, std::memory_order_acq_rel);
+            idle.notify_one();
+            if (i % 64 == 0) { std::this_thread::yield(); }
+        }
+        while (n_taken.load(std::memory_order_acquire) < PARKING_ROUNDS) { std::this_thread::yield(); }
+        stopping.store(true, std::memory_order_seq_cst);
+        idle.notify_all();
+        for (auto & consumer : consumers) { consumer.join(); }
+    });
+}
+
+TEST_CASE(pool_runs_every_task_once)
+{
+    ItemTally tally(STRESS_ITEMS);
+    {
+        WorkerPool pool(STRESS_THREADS);
+        // half the tasks come from outside the pool, half are submitted by tasks onto a worker's deque
+        for (long i = 0; i < STRESS_ITEMS / 2; i++) {
+            pool.submit([&pool, &tally, i] {
+                tally.take(2 * i);
+                pool.submit([&tally, i] { tally.take(2 * i + 1); });
+            });
+        }
+        pool.wait();
+        CHECK(tally.each_once());
+    }
+}
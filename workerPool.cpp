@@ -0,0 +1,151 @@
+#include "workerPool.h"
+
+#include <climits>
+
+// the pool and worker the current thread belongs to, if it is a pool worker
+thread_local WorkerPool * current_pool = nullptr;
+thread_local int current_worker = -1;
+
+/**
+ * @brief Starts the worker threads.
+ * @param n_threads How many to start (at least one).
+ * @param setup Prepares each worker thread (e.g. pins it to a CPU), or null.
+ */
+WorkerPool::WorkerPool(int n_threads, Setup setup)
+{
+    if (n_threads < 1) { n_threads = 1; }
+    for (int i = 0; i < n_threads; i++) { workers.push_back(std::make_unique<Worker>()); }
+    // the deques must all exist before any worker tries to steal from them
+    for (int i = 0; i < n_threads; i++) {
+        workers[i]->thread = std::thread([this, i, setup] { run(i, setup); });
+    }
+}
+
+/**
+ * @brief Finishes the submitted tasks and stops the worker threads.
+ */
+WorkerPool::~WorkerPool()
+{
+    wait();
+    stopping.store(true, std::memory_order_seq_cst);
+    idle.notify_all();
+    for (auto & worker : workers) { worker->thread.join(); }
+}
+
+/**
+ * @brief Queues a task to run on one of the workers.
+ * @param task The task.
+ *
+ * If the injector is full, the task runs at once on the calling thread instead, which also slows the
+ * producer down to the pool's pace.
+ */
+void WorkerPool::submit(Task task)
+{
+    n_pending.fetch_add(1, std::memory_order_relaxed);
+    Task * queued = new Task(std::move(task));
+    if (current_pool == this) {
+        workers[current_worker]->deque.push(queued);
+    } else if (! injector.try_push(queued)) {
+        execute(queued);
+        return;
+    }
+    idle.notify_one();
+}
+
+/**
+ * @brief Waits until every task submitted so far has finished, running queued tasks meanwhile.
+ *
+ * Must not be called from a task.
+ */
+void WorkerPool::wait()
+{
+    while (true) {
+        uint32_t n_left = n_pending.load(std::memory_order_acquire);
+        if (n_left == 0) { return; }
+        if (auto task = injector.try_pop()) {
+            execute(*task);
+        } else {
+            futex_wait(n_pending, n_left);
+        }
+    }
+}
+
+/**
+ * @brief Runs one task, and wakes wait() if it was the last one.
+ */
+void WorkerPool::execute(Task * task)
+{
+    (*task)();
+    delete task;
+    if (n_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) { futex_wake(n_pending, INT_MAX); }
+}
+
+/**
+ * @brief Finds a task for a worker: its own newest task, else a batch from the injector, else the
+ *        oldest task of another worker.
+ * @param index The worker.
+ * @return The task, or null if there was none to be found.
+ */
+WorkerPool::Task * WorkerPool::find_task(int index)
+{
+    Worker & self = *workers[index];
+    if (auto task = self.deque.pop()) { return *task; }
+
+    if (auto task = injector.try_pop()) {
+        for (int i = 1; i < INJECTOR_BATCH; i++) {
+            auto next = injector.try_pop();
+            if (! next) { break; }
+            self.deque.push(*next);
+        }
+        return *task;
+    }
+
+    int n_workers = size();
+    for (int offset = 1; offset < n_workers; offset++) {
+        if (auto task = workers[(index + offset) % n_workers]->deque.steal()) { return *task; }
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Returns the index of the worker running the calling thread.
+ * @return The index, or -1 if the thread is not a pool worker.
+ */
+int WorkerPool::this_worker()
+{
+    return current_worker;
+}
+
+/**
+ * @brief The loop each worker thread runs until the pool stops.
+ * @param index The worker.
+ * @param setup Prepares the thread, or null.
+ */
+void WorkerPool::run(int index, const Setup & setup)
+{
+    current_pool = this;
+    current_worker = index;
+    // before any task, so that what the worker allocates for itself is placed by the setup
+    if (setup) { setup(index); }
+    while (true) {
+        if (Task * task = find_task(index)) {
+            // others may be parked while this worker holds a batch they could be stealing from
+            if (! workers[index]->deque.empty()) { idle.notify_one(); }
+            execute(task);
+            continue;
+        }
+
+        uint32_t key = idle.prepare_wait();
+        // work published after the key was taken is seen here, or else its notification ends the wait
+        Task * task = find_task(index);
+        if (task || stopping.load(std::memory_order_seq_cst)) {
+            idle.cancel_wait();
+            if (task) {
+                execute(task);
+                continue;
+            }
+            return;
+        }
+        idle.wait(key);
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "parking.h"
+#include "workQueue.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// tasks submitted from outside the pool wait here until a worker takes them
+constexpr size_t INJECTOR_CAPACITY = 1024;
+// how many tasks a worker moves from the injector to its own deque at once
+constexpr int INJECTOR_BATCH = 8;
+
+/**
+ * @brief Runs tasks on a fixed set of threads, each with its own work-stealing deque.
+ *
+ * Tasks submitted from outside the pool go through a shared bounded ring; a worker takes them a
+ * batch at a time into its own deque, so that the ring is touched once per batch. Tasks submitted by
+ * a task go straight onto the running worker's deque. A worker with nothing left steals from the
+ * others, and parks on a futex once there is nothing to steal either, so an idle pool uses no CPU.
+ *
+ * Tasks must not throw.
+ */
+class WorkerPool {
+public:
+    using Task = std::function<void()>;
+    // runs on each worker thread before its first task, given the worker's index
+    using Setup = std::function<void(int)>;
+
+    explicit WorkerPool(int n_threads, Setup setup = nullptr);
+    ~WorkerPool();
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool & operator=(const WorkerPool &) = delete;
+
+    void submit(Task task);
+    void wait();
+    int size() const { return static_cast<int>(workers.size()); }
+    static int this_worker();
+
+private:
+    struct Worker {
+        ChaseLevDeque<Task *> deque;
+        std::thread thread;
+    };
+
+    void run(int index, const Setup & setup);
+    Task * find_task(int index);
+    void execute(Task * task);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    MpmcRing<Task *> injector { INJECTOR_CAPACITY };
+    IdleWorkers idle;
+    std::atomic<uint32_t> n_pending { 0 }; // submitted but not finished; a futex for wait()
+    std::atomic<bool> stopping { false };
+};